@@ -0,0 +1,89 @@
+/* arena.c
+ *
+ * In this file an arena (bump allocator) is defined. It is used for objects that
+ * all die at the same moment, such as the tokens of one input line:
+ * allocation is a pointer increment, and freeing is done for all objects at once.
+ */
+
+#include <stdlib.h> /* malloc, free */
+#include <assert.h> /* assert */
+#include "arena.h"
+
+/* The function initArena makes an empty arena.
+ */
+
+void initArena(Arena *a) {
+  a->first = NULL;
+  a->current = NULL;
+}
+
+/* The function newArenaBlock allocates a block with room for at least size bytes.
+ */
+
+ArenaBlockPtr newArenaBlock(size_t size) {
+  ArenaBlockPtr b;
+  if (size < ARENA_BLOCKSIZE) {
+    size = ARENA_BLOCKSIZE;
+  }
+  b = malloc(sizeof(ArenaBlock) + size);
+  assert(b != NULL);
+  b->next = NULL;
+  b->size = size;
+  b->used = 0;
+  return b;
+}
+
+/* The function arenaAlloc yields a pointer to size bytes of uninitialized memory.
+ * When the current block is full, the next block of the chain is reused;
+ * only when that one is too small (or absent) a new block is inserted.
+ */
+
+void *arenaAlloc(Arena *a, size_t size) {
+  ArenaBlockPtr b = a->current;
+  void *p;
+  size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+  if (b == NULL) { /* there are no blocks yet */
+    b = newArenaBlock(size);
+    a->first = b;
+    a->current = b;
+  } else if (b->size - b->used < size) {
+    if (b->next != NULL && b->next->size >= size) { /* reuse the next block */
+      b = b->next;
+      b->used = 0;
+    } else { /* insert a new block after the current one */
+      ArenaBlockPtr nb = newArenaBlock(size);
+      nb->next = b->next;
+      b->next = nb;
+      b = nb;
+    }
+    a->current = b;
+  }
+  p = b->data + b->used;
+  b->used += size;
+  return p;
+}
+
+/* The function resetArena gives back all memory of the arena in one step.
+ * The blocks themselves are kept for reuse: the used counters of the blocks
+ * after the first one are reset when arenaAlloc reaches them.
+ */
+
+void resetArena(Arena *a) {
+  a->current = a->first;
+  if (a->first != NULL) {
+    a->first->used = 0;
+  }
+}
+
+/* The function releaseArena frees all blocks of the arena.
+ */
+
+void releaseArena(Arena *a) {
+  ArenaBlockPtr b = a->first;
+  while (b != NULL) {
+    ArenaBlockPtr next = b->next;
+    free(b);
+    b = next;
+  }
+  initArena(a);
+}
@@ -0,0 +1,36 @@
+/* arena.h */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h> /* size_t */
+
+#define ARENA_BLOCKSIZE 16384 /* default size of the data part of a block */
+#define ARENA_ALIGN 16        /* alignment of every allocation (malloc gives at least this) */
+
+/* An arena is a bump allocator: memory is taken from a chain of large blocks,
+ * and all of it is given back at once by resetArena. The blocks are kept,
+ * so after the first few lines no more calls to malloc are needed.
+ * An arena that is filled with zeros (e.g. a static one) is empty and ready for use.
+ */
+
+typedef struct ArenaBlock *ArenaBlockPtr;
+
+typedef struct ArenaBlock {
+  ArenaBlockPtr next;
+  size_t size;   /* size of data */
+  size_t used;   /* number of bytes of data in use */
+  _Alignas(ARENA_ALIGN) char data[]; /* after the header, padded to ARENA_ALIGN */
+} ArenaBlock;
+
+typedef struct Arena {
+  ArenaBlockPtr first;
+  ArenaBlockPtr current;
+} Arena;
+
+void initArena(Arena *a);
+void *arenaAlloc(Arena *a, size_t size);
+void resetArena(Arena *a);
+void releaseArena(Arena *a);
+
+#endif
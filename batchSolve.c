@@ -0,0 +1,323 @@
+/* batchSolve.c
+ *
+ * In this file the batch mode for equations is defined: every line of the input is an
+ * equation, and for every line one line of output is written, in the same order:
+ *
+ *   solution: <value>      for a solvable equation in 1 variable of degree 1
+ *   solutions: <roots>     for an equation in 1 variable of a higher degree
+ *   not solvable           for an equation in 1 variable without solution
+ *   degree <n>             for an equation in 1 variable of degree 0, or above MAXDEGREE
+ *   not in 1 variable      for an equation without variables or with more than one
+ *   not an equation        otherwise
+ *
+ * The input is cut into chunks of whole lines by a line reader (see lineReader.h), which
+ * maps the input in memory when it is a regular file. A fixed pool of threads scans, analyzes
+ * and solves the chunks, each into an output buffer of its own. The main thread reads
+ * the chunks and writes the output buffers in input order: a chunk that is finished
+ * early waits in the reorder window until all chunks before it have been written.
+ */
+
+#include <stdio.h>    /* FILE, fileno, fwrite, fprintf */
+#include <stdlib.h>   /* malloc, free */
+#include <string.h>   /* memchr, memcpy, strerror */
+#include <assert.h>   /* assert */
+#include <pthread.h>
+#include "charClass.h"
+#include "intern.h"
+#include "sink.h"
+#include "scanner.h"
+#include "recognizeExp.h"
+#include "batchSolve.h"
+#include "stats.h"
+
+/* A chunk: its input (whole lines) and its output. copy is the memory of the input
+ * when it has been copied from the buffer of the line reader, and NULL otherwise.
+ */
+
+typedef struct BatchChunk {
+  char *input;
+  size_t inputLength;
+  char *copy;
+  Sink output;
+  int done;
+} BatchChunk;
+
+/* The shared state of a batch. Chunk number n is in slots[n % WINDOW].
+ * Chunks nextWrite..nextRead-1 are in the window; chunks nextWork..nextRead-1
+ * have not been taken by a worker yet.
+ */
+
+typedef struct Batch {
+  pthread_mutex_t lock;
+  pthread_cond_t workReady;
+  pthread_cond_t chunkDone;
+  BatchChunk slots[WINDOW];
+  long nextRead;
+  long nextWork;
+  long nextWrite;
+  int finished;    /* all input has been read */
+} Batch;
+
+/* The function appendSolutions solves an equation in 1 variable and appends the result.
+ */
+
+void appendSolutions(Sink *out, Equation *eq) {
+  int n = (eq->degree >= 1 ? solveEquation(eq) : -1);
+  int k;
+  if (n < 0) {
+    sinkText(out,"degree ");
+    sinkInt(out,eq->degree);
+    sinkChar(out,'\n');
+  } else if (n == 0) {
+    sinkText(out,"not solvable\n");
+  } else if (n == 1) {
+    sinkText(out,"solution: ");
+    sinkFixed(out,almostZero(eq->re[0]),3,0);
+    sinkChar(out,'\n');
+  } else {
+    sinkText(out,"solutions:");
+    for (k = 0; k < n; k++) {
+      sinkChar(out,' ');
+      sinkFixed(out,almostZero(eq->re[k]),3,0);
+      if (eq->im[k] != 0) {
+        sinkFixed(out,eq->im[k],3,1);
+        sinkChar(out,'i');
+      }
+    }
+    sinkChar(out,'\n');
+  }
+}
+
+/* The function solveChunk handles all lines of a chunk, with the token array, the
+ * intern table and the equation of the worker. The tokens of a line are scanned into
+ * the token array, which is reused for every line (see bench/tokens.c for the
+ * comparison with token lists).
+ */
+
+void solveChunk(BatchChunk *c, TokenArray *ta, InternTable *it, Equation *eq) {
+  char *line = c->input;
+  char *end = c->input + c->inputLength;
+  char *nl;
+  int length;
+  c->output.length = 0;
+  while (line < end) {
+    nl = memchr(line,'\n',end-line);
+    if (nl == NULL) {
+      nl = end;
+    }
+    length = nl - line;
+    if (length > 0 && line[length-1] == '\r') {
+      length--;
+    }
+    tokenArrayTable(line,length,ta,it);
+    STATS_COUNT(CountLines,1);
+    if (!analyzeEquationFlat(tokenCursor(ta),eq)) {
+      sinkText(&c->output,"not an equation\n");
+      STATS_COUNT(CountRejected,1);
+    } else if (eq->variableCount != 1) {
+      sinkText(&c->output,"not in 1 variable\n");
+      STATS_COUNT(CountRejected,1);
+    } else {
+      appendSolutions(&c->output,eq);
+    }
+    line = nl + 1;
+  }
+}
+
+/* The function batchWorker is the main function of a thread of the pool:
+ * it takes the next chunk that has not been taken, solves it and marks it as done.
+ */
+
+void *batchWorker(void *arg) {
+  Batch *b = arg;
+  TokenArray ta;
+  InternTable it;
+  Equation eq;
+  long n;
+  initTokenArray(&ta);
+  initInternTable(&it);
+  initEquation(&eq);
+  for (;;) {
+    pthread_mutex_lock(&b->lock);
+    while (b->nextWork == b->nextRead && !b->finished) {
+      pthread_cond_wait(&b->workReady,&b->lock);
+    }
+    if (b->nextWork == b->nextRead) { /* finished, and no work left */
+      pthread_mutex_unlock(&b->lock);
+      break;
+    }
+    n = b->nextWork++;
+    pthread_mutex_unlock(&b->lock);
+    solveChunk(&b->slots[n % WINDOW],&ta,&it,&eq);
+    pthread_mutex_lock(&b->lock);
+    b->slots[n % WINDOW].done = 1;
+    pthread_cond_broadcast(&b->chunkDone);
+    pthread_mutex_unlock(&b->lock);
+  }
+  freeTokenArray(&ta);
+  freeInternTable(&it);
+  freeEquation(&eq);
+  STATS_MERGE();
+  return NULL;
+}
+
+/* The function readChunk reads the next chunk from the line reader: whole lines, at
+ * least CHUNKSIZE bytes of them (unless the input ends). A chunk of a mapped file is a
+ * view of the mapping; otherwise the lines are copied, because the buffer of the reader
+ * is reused. The result is 0 when there is no input left.
+ */
+
+int readChunk(LineReader *lr, BatchChunk *c) {
+  LineView block;
+  STATS_START(start);
+  if (!readLines(lr,CHUNKSIZE,&block)) {
+    STATS_STOP(PhaseRead,start);
+    return 0;
+  }
+  if (lr->map != NULL) {
+    c->copy = NULL;
+    c->input = block.start;
+  } else {
+    c->copy = malloc(block.length);
+    assert( c->copy != NULL );
+    memcpy(c->copy,block.start,block.length);
+    c->input = c->copy;
+  }
+  c->inputLength = block.length;
+  c->done = 0;
+  STATS_STOP(PhaseRead,start);
+  return 1;
+}
+
+/* The function writeChunks writes the chunks that are done, in order, and frees their
+ * input. The lock is held by the caller, but released while writing.
+ */
+
+void writeChunks(Batch *b, FILE *out) {
+  BatchChunk *c;
+  while (b->nextWrite < b->nextWork && b->slots[b->nextWrite % WINDOW].done) {
+    c = &b->slots[b->nextWrite % WINDOW];
+    pthread_mutex_unlock(&b->lock);
+    STATS_START(start);
+    fwrite(c->output.buffer,1,c->output.length,out);
+    STATS_STOP(PhaseWrite,start);
+    free(c->copy);
+    c->copy = NULL;
+    c->input = NULL;
+    pthread_mutex_lock(&b->lock);
+    b->nextWrite++;
+  }
+}
+
+/* The function solveSerial solves the chunks one by one in the calling thread; it is
+ * used when no thread of the pool could be started.
+ */
+
+void solveSerial(LineReader *lr, FILE *out) {
+  BatchChunk c;
+  TokenArray ta;
+  InternTable it;
+  Equation eq;
+  initTokenArray(&ta);
+  initInternTable(&it);
+  initEquation(&eq);
+  initSink(&c.output,-1);
+  while (readChunk(lr,&c)) {
+    solveChunk(&c,&ta,&it,&eq);
+    STATS_START(start);
+    fwrite(c.output.buffer,1,c.output.length,out);
+    STATS_STOP(PhaseWrite,start);
+    free(c.copy);
+  }
+  freeSink(&c.output);
+  freeTokenArray(&ta);
+  freeInternTable(&it);
+  freeEquation(&eq);
+}
+
+/* The function solveBatch solves the equations on the lines of in with a pool of
+ * threads, and writes the results to out in input order. When fewer threads can be
+ * started than requested, the ones that have been started do the work; when none can
+ * be started, the equations are solved in the calling thread (see solveSerial).
+ * The result is 0, or 1 when the input could not be read to its end; that is reported
+ * on stderr, after the output of the lines before it.
+ */
+
+int solveBatch(FILE *in, FILE *out, int threads) {
+  Batch b;
+  pthread_t *pool;
+  BatchChunk c;
+  LineReader lr;
+  int k, started, error;
+  if (threads < 1) {
+    threads = 1;
+  }
+  initCharClass();
+  pthread_mutex_init(&b.lock,NULL);
+  pthread_cond_init(&b.workReady,NULL);
+  pthread_cond_init(&b.chunkDone,NULL);
+  for (k = 0; k < WINDOW; k++) {
+    b.slots[k].input = NULL;
+    b.slots[k].copy = NULL;
+    initSink(&b.slots[k].output,-1);
+  }
+  b.nextRead = b.nextWork = b.nextWrite = 0;
+  b.finished = 0;
+  pool = malloc(threads*sizeof(pthread_t));
+  assert( pool != NULL );
+  for (started = 0; started < threads; started++) {
+    if (pthread_create(&pool[started],NULL,batchWorker,&b) != 0) {
+      fprintf(stderr,"--batch: only %d of %d threads could be started\n",started,threads);
+      break;
+    }
+  }
+  mapLineReader(&lr,fileno(in));
+  if (started == 0) {
+    solveSerial(&lr,out);
+  }
+  while (started > 0 && readChunk(&lr,&c)) {
+    pthread_mutex_lock(&b.lock);
+    while (b.nextRead - b.nextWrite >= WINDOW) { /* the window is full */
+      writeChunks(&b,out);
+      if (b.nextRead - b.nextWrite >= WINDOW) {
+        pthread_cond_wait(&b.chunkDone,&b.lock);
+      }
+    }
+    b.slots[b.nextRead % WINDOW].input = c.input;
+    b.slots[b.nextRead % WINDOW].inputLength = c.inputLength;
+    b.slots[b.nextRead % WINDOW].copy = c.copy;
+    b.slots[b.nextRead % WINDOW].done = 0;
+    b.nextRead++;
+    pthread_cond_signal(&b.workReady);
+    writeChunks(&b,out);
+    pthread_mutex_unlock(&b.lock);
+  }
+  pthread_mutex_lock(&b.lock);
+  b.finished = 1;
+  pthread_cond_broadcast(&b.workReady);
+  while (b.nextWrite < b.nextRead) {
+    writeChunks(&b,out);
+    if (b.nextWrite < b.nextRead) {
+      pthread_cond_wait(&b.chunkDone,&b.lock);
+    }
+  }
+  pthread_mutex_unlock(&b.lock);
+  for (k = 0; k < started; k++) {
+    pthread_join(pool[k],NULL);
+  }
+  free(pool);
+  error = lr.error;
+  closeLineReader(&lr);
+  for (k = 0; k < WINDOW; k++) {
+    freeSink(&b.slots[k].output);
+  }
+  pthread_cond_destroy(&b.workReady);
+  pthread_cond_destroy(&b.chunkDone);
+  pthread_mutex_destroy(&b.lock);
+  fflush(out);
+  if (error != 0) {
+    fprintf(stderr,"--batch: the input could not be read: %s\n",strerror(error));
+    return 1;
+  }
+  return 0;
+}
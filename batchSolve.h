@@ -0,0 +1,13 @@
+/* batchSolve.h */
+
+#ifndef BATCHSOLVE_H
+#define BATCHSOLVE_H
+
+#include <stdio.h> /* FILE */
+
+#define CHUNKSIZE (1 << 20) /* number of bytes of input in a chunk (at least) */
+#define WINDOW 64           /* maximal number of chunks between reading and writing */
+
+int solveBatch(FILE *in, FILE *out, int threads);
+
+#endif
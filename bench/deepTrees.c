@@ -0,0 +1,131 @@
+/* bench/deepTrees.c
+ *
+ * Measures the traversals of expression trees on chains of 10^3, 10^5 and 10^7 nodes,
+ * which are as deep as they are large, and checks that none of them runs out of stack:
+ *
+ *   value          the right-deep chain 1 + (2 + (3 + ... )) of numbers
+ *   print          the same chain, written to /dev/null
+ *   differentiate  the left-deep chain ((x + 2) * x - 3) / x ... of x and numbers,
+ *                  which is no polynomial, so the rules for trees are used
+ *   simplify       the same chain
+ *   sum            differentiate and simplify on the left-deep chain x + x1 + x2 + ...
+ *                  of distinct identifiers, which has one operator throughout, so that
+ *                  the whole tree is a single chain of terms to be collected
+ *
+ * The times are in seconds; at 10^7 nodes the program needs about 4 GB. The derivatives
+ * and the simplified chains are only checked for being made; the value is compared with
+ * the sum of the numbers.
+ */
+
+#include <stdio.h>  /* printf, sprintf */
+#include <fcntl.h>  /* open */
+#include <unistd.h> /* close */
+#include <time.h>   /* clock_gettime */
+#include "scanner.h"
+#include "infixExp.h"
+#include "rewrite.h"
+
+double seconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+/* The function numberChain makes the right-deep chain of n numbers 1..9 joined by +,
+ * and yields their sum in *sum.
+ */
+
+ExpTree numberChain(int n, double *sum) {
+  ExpTree tr = numberNode(1 + (n-1) % 9);
+  int k;
+  *sum = 1 + (n-1) % 9;
+  for (k = n-2; k >= 0; k--) {
+    tr = symbolNode('+',numberNode(1 + k % 9),tr);
+    *sum += 1 + k % 9;
+  }
+  return tr;
+}
+
+/* The function xChain makes the left-deep chain of n operators, in turn +, *, - and /,
+ * with x after * and / and the numbers 2..9 after + and -.
+ */
+
+ExpTree xChain(int n, ExpTree x) {
+  static const char ops[] = "+*-/";
+  ExpTree tr = x;
+  int k;
+  for (k = 0; k < n; k++) {
+    tr = symbolNode(ops[k % 4],tr,(k % 2 ? x : numberNode(2 + k % 8)));
+  }
+  return tr;
+}
+
+/* The function sumChain makes the left-deep chain of the sum of n distinct identifiers:
+ * x, then x1, x2 and so on.
+ */
+
+ExpTree sumChain(int n, ExpTree x) {
+  char name[16];
+  ExpTree tr = x;
+  Token t;
+  int k;
+  for (k = 1; k < n; k++) {
+    sprintf(name,"x%d",k);
+    t.identifier = identifierSlice(identifierId(name));
+    tr = symbolNode('+',tr,newExpTreeNode(Identifier,t,NULL,NULL));
+  }
+  return tr;
+}
+
+int main() {
+  char name[] = "x";
+  LineView line = { name, 1 };
+  Sink out;
+  ExpTree x, tr, result;
+  double t0, tValue, tPrint, tDerivative, tSimplify, tSumDerivative, tSumSimplify, sum, value;
+  int n, failed = 0;
+  initSink(&out,open("/dev/null",O_WRONLY));
+  printf("%9s %10s %10s %14s %10s %14s %10s\n","","","","","","sum","sum");
+  printf("%9s %10s %10s %14s %10s %14s %10s\n","nodes","value","print","differentiate","simplify",
+         "differentiate","simplify");
+  for (n = 1000; n <= 10000000; n *= 100) {
+    resetExpTrees();
+    tr = numberChain(n,&sum);
+    t0 = seconds();
+    value = valueExpTree(tr);
+    tValue = seconds() - t0;
+    t0 = seconds();
+    printExpTreeInfix(&out,tr);
+    flushSink(&out);
+    tPrint = seconds() - t0;
+    resetExpTrees();
+    x = newExpTreeNode(Identifier,tokenList(line)->t,NULL,NULL);
+    tr = xChain(n,x);
+    t0 = seconds();
+    result = differentiate(tr);
+    tDerivative = seconds() - t0;
+    failed |= (result == NULL);
+    t0 = seconds();
+    result = simplify(tr);
+    tSimplify = seconds() - t0;
+    failed |= (result == NULL || value != sum);
+    resetExpTrees();
+    x = newExpTreeNode(Identifier,tokenList(line)->t,NULL,NULL);
+    tr = sumChain(n,x);
+    t0 = seconds();
+    result = differentiate(tr);
+    tSumDerivative = seconds() - t0;
+    failed |= (result == NULL);
+    t0 = seconds();
+    result = simplify(tr);
+    tSumSimplify = seconds() - t0;
+    failed |= (result == NULL);
+    printf("%9d %10.3f %10.3f %14.3f %10.3f %14.3f %10.3f\n",n,tValue,tPrint,tDerivative,tSimplify,
+           tSumDerivative,tSumSimplify);
+  }
+  resetExpTrees();
+  resetTokens();
+  close(out.fd);
+  freeSink(&out);
+  return failed;
+}
@@ -0,0 +1,106 @@
+/* bench/jit.c
+ *
+ * Compares the evaluation of an expression by valueExpTree (on the tree with numbers for
+ * the identifiers), by evalExpCode (bytecode) and by evalJit (native code on x86-64), on
+ * random trees of about 10 to 10^4 distinct nodes. Compiling is not included in the
+ * times of evaluation but measured apart. The times are in nanoseconds per evaluation.
+ */
+
+#include <stdio.h>  /* printf */
+#include <stdlib.h> /* malloc, free, rand */
+#include <time.h>   /* clock_gettime */
+#include "scanner.h"
+#include "infixExp.h"
+#include "expCode.h"
+#include "expJit.h"
+
+#define TOTAL 20000000 /* nodes evaluated per measurement */
+#define VARIABLES 4
+
+static char names[VARIABLES][2] = { "a", "b", "c", "d" };
+static double bindings[VARIABLES] = { 1.25, -0.75, 0.5, 2.0 };
+
+double seconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+/* The function randomTree makes a random tree of the given depth and the same tree with
+ * numbers for the identifiers in *numeric. There are no divisions, so that valueExpTree
+ * never meets a division by 0.
+ */
+
+ExpTree randomTree(int depth, ExpTree *numeric) {
+  static const char ops[] = "+-*";
+  ExpTree l, r, nl, nr, tr;
+  Token t;
+  int k;
+  if (depth == 0 || rand() % 8 == 0) {
+    if (rand() % 2) {
+      k = rand() % VARIABLES;
+      t.identifier.start = names[k];
+      t.identifier.length = 1;
+      t.identifier.id = k;
+      tr = newExpTreeNode(Identifier,t,NULL,NULL);
+      t.real = bindings[k];
+      *numeric = newExpTreeNode(Real,t,NULL,NULL);
+    } else {
+      t.real = 0.5 + (double)rand()/RAND_MAX;
+      tr = *numeric = newExpTreeNode(Real,t,NULL,NULL);
+    }
+    return tr;
+  }
+  l = randomTree(depth-1,&nl);
+  r = randomTree(depth-1,&nr);
+  t.symbol = ops[rand() % 3];
+  *numeric = newExpTreeNode(Symbol,t,nl,nr);
+  return newExpTreeNode(Symbol,t,l,r);
+}
+
+int main() {
+  JitCode j;
+  ExpTree tr, numeric;
+  double *work, t0, tTree, tCode, tJit, tCompile, sum = 0;
+  int depth, nodes, rounds, r;
+  initJit(&j);
+  srand(1);
+  printf("%7s %12s %12s %12s %12s   (ns per evaluation)\n",
+         "nodes","tree","bytecode","jit","compile");
+  for (depth = 3; depth <= 15; depth += 4) {
+    resetExpTrees();
+    tr = randomTree(depth,&numeric);
+    free(postOrder(tr,&nodes));
+    rounds = TOTAL / nodes;
+    t0 = seconds();
+    for (r = 0; r < rounds; r++) {
+      sum += valueExpTree(numeric);
+    }
+    tTree = seconds() - t0;
+    t0 = seconds();
+    compileJit(tr,&j);
+    tCompile = seconds() - t0;
+    work = malloc(evalWorkSize(&(j.code))*sizeof(double));
+    t0 = seconds();
+    for (r = 0; r < rounds; r++) {
+      sum += evalExpCode(&(j.code),bindings,work);
+    }
+    tCode = seconds() - t0;
+    t0 = seconds();
+    for (r = 0; r < rounds; r++) {
+      sum += evalJit(&j,bindings,work);
+    }
+    tJit = seconds() - t0;
+    if (evalJit(&j,bindings,work) != valueExpTree(numeric)) {
+      printf("the values differ\n");
+      return 1;
+    }
+    printf("%7d %12.1f %12.1f %12.1f %12.1f\n",nodes,
+           1e9*tTree/rounds,1e9*tCode/rounds,1e9*tJit/rounds,1e9*tCompile);
+    free(work);
+  }
+  printf("%s code; checksum %g\n",(j.function != NULL ? "native" : "no native"),sum);
+  freeJit(&j);
+  resetExpTrees();
+  return 0;
+}
@@ -0,0 +1,126 @@
+/* bench/lineReader.c
+ *
+ * Measures the throughput of reading a file line by line, on a file of generated
+ * equations of 1 GiB (or of the number of MiB given as argument), in MB/s:
+ *
+ *   getchar   the original readInput: getchar for every character, and every line
+ *             copied into a string of its own
+ *   block     a line reader made by openLineReader, which reads blocks of READBLOCK
+ *             bytes and yields views into its buffer
+ *   mapped    a line reader made by mapLineReader, which maps the file in memory
+ *
+ * The file is written first, in a temporary file in /tmp, so it is read from the page
+ * cache: the times are those of the reading code, not of the disk. Every reader adds
+ * up the lengths of the lines, which must agree.
+ */
+
+#include <stdio.h>  /* printf, fprintf, FILE, fopen, fclose, getc */
+#include <stdlib.h> /* malloc, realloc, free, atoi, mkstemp */
+#include <string.h> /* strlen */
+#include <fcntl.h>  /* open */
+#include <unistd.h> /* close, unlink */
+#include <assert.h> /* assert */
+#include <time.h>   /* clock_gettime */
+#include "lineReader.h"
+
+#define MAXINPUT 100
+
+double seconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+/* The function getcharLine is the readInput of before the line reader, on the stream
+ * f instead of stdin, and with the end of the input as a result of NULL.
+ */
+
+char *getcharLine(FILE *f) {
+  int strLen = MAXINPUT;
+  int c = getc(f);
+  int i = 0;
+  char *s;
+  if (c == EOF) {
+    return NULL;
+  }
+  s = malloc((strLen+1)*sizeof(char));
+  assert( s != NULL );
+  while (c != '\n' && c != EOF) {
+    s[i] = c;
+    i++;
+    if (i >= strLen) { /* s is not large enough, its length is doubled */
+      strLen = 2*strLen;
+      s = realloc(s,(strLen+1)*sizeof(char));
+      assert( s != NULL );
+    }
+    c = getc(f);
+  }
+  s[i] = '\0';
+  return s;
+}
+
+/* The function writeEquations writes lines of equations of about size bytes to the
+ * file name.
+ */
+
+void writeEquations(const char *name, size_t size) {
+  FILE *f = fopen(name,"w");
+  size_t written = 0;
+  long k = 0;
+  assert( f != NULL );
+  while (written < size) {
+    written += fprintf(f,"%ldx^2 + %ldx - %ld = %ldx\n",k % 97,k % 13,k,k % 7);
+    k++;
+  }
+  fclose(f);
+}
+
+int main(int argc, char *argv[]) {
+  char name[] = "/tmp/lineReaderXXXXXX";
+  size_t size = (size_t)(argc >= 2 ? atoi(argv[1]) : 1024) << 20;
+  size_t total[3] = { 0, 0, 0 };
+  double t[3], t0;
+  LineReader lr;
+  LineView line;
+  FILE *f;
+  char *s;
+  int fd;
+  fd = mkstemp(name);
+  assert( fd >= 0 );
+  close(fd);
+  writeEquations(name,size);
+  f = fopen(name,"r");
+  assert( f != NULL );
+  t0 = seconds();
+  while ((s = getcharLine(f)) != NULL) {
+    total[0] += strlen(s);
+    free(s);
+  }
+  t[0] = seconds() - t0;
+  fclose(f);
+  fd = open(name,O_RDONLY);
+  t0 = seconds();
+  openLineReader(&lr,fd);
+  while (readLine(&lr,&line)) {
+    total[1] += line.length;
+  }
+  closeLineReader(&lr);
+  t[1] = seconds() - t0;
+  close(fd);
+  fd = open(name,O_RDONLY);
+  t0 = seconds();
+  if (!mapLineReader(&lr,fd)) {
+    printf("the file could not be mapped\n");
+  }
+  while (readLine(&lr,&line)) {
+    total[2] += line.length;
+  }
+  closeLineReader(&lr);
+  t[2] = seconds() - t0;
+  close(fd);
+  unlink(name);
+  printf("%zu MiB of equations, in MB/s:\n",size >> 20);
+  printf("%10s %10s %10s\n","getchar","block","mapped");
+  printf("%10.0f %10.0f %10.0f\n",1e-6*size/t[0],1e-6*size/t[1],1e-6*size/t[2]);
+  return (total[0] != total[1] || total[1] != total[2]);
+}
@@ -0,0 +1,69 @@
+/* bench/linearSystem.c
+ *
+ * Measures the LU factorization and solve of linearSystem.c (luFactor and luSolve) on
+ * random dense n x n systems, n = 500 to 3000, and checks the residual of the solution.
+ * The rate is in GFLOP/s, counting 2n^3/3 operations for the factorization.
+ */
+
+#include <stdio.h>  /* printf */
+#include <stdlib.h> /* malloc, free, rand */
+#include <string.h> /* memcpy */
+#include <math.h>   /* fabs */
+#include <time.h>   /* clock_gettime */
+#include "scanner.h"
+#include "recognizeExp.h"
+#include "linearSystem.h"
+
+double seconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+int main() {
+  static const int sizes[] = { 500, 1000, 2000, 3000 };
+  double *a, *copy, *b, *x, t0, t, residual, sum;
+  int *perm, s, n, i, j, failed = 0;
+  printf("%6s %10s %10s %12s\n","n","seconds","GFLOP/s","residual");
+  for (s = 0; s < 4; s++) {
+    n = sizes[s];
+    a = malloc((size_t)n*n*sizeof(double));
+    copy = malloc((size_t)n*n*sizeof(double));
+    b = malloc(n*sizeof(double));
+    x = malloc(n*sizeof(double));
+    perm = malloc(n*sizeof(int));
+    srand(n);
+    for (i = 0; i < n*n; i++) {
+      a[i] = (double)rand()/RAND_MAX - 0.5;
+    }
+    for (i = 0; i < n; i++) {
+      b[i] = (double)rand()/RAND_MAX - 0.5;
+    }
+    memcpy(copy,a,(size_t)n*n*sizeof(double));
+    memcpy(x,b,n*sizeof(double));
+    t0 = seconds();
+    if (!luFactor(a,n,perm)) {
+      printf("%6d singular\n",n);
+      failed = 1;
+      continue;
+    }
+    luSolve(a,n,perm,x);
+    t = seconds() - t0;
+    residual = 0;
+    for (i = 0; i < n; i++) {
+      sum = -b[i];
+      for (j = 0; j < n; j++) {
+        sum += copy[(size_t)i*n+j] * x[j];
+      }
+      residual = (fabs(sum) > residual ? fabs(sum) : residual);
+    }
+    printf("%6d %10.3f %10.2f %12.2e\n",n,t,2.0*n*n*n/3/t*1e-9,residual);
+    failed |= !(residual < 1e-8);
+    free(a);
+    free(copy);
+    free(b);
+    free(x);
+    free(perm);
+  }
+  return failed;
+}
@@ -0,0 +1,78 @@
+/* bench/scanPaths.c
+ *
+ * Measures the scanner (tokenArrayTable) with each implementation of the run functions
+ * (see charClass.h) on lines of equations with short and with long names and numbers.
+ * The throughput is in MB of input per second. AVX2 has not been faster than SSE2 in
+ * these measurements, so ScanAuto chooses SSE2 (see selectScanPath).
+ */
+
+#include <stdio.h>  /* printf, sprintf */
+#include <stdlib.h> /* malloc, free */
+#include <time.h>   /* clock_gettime */
+#include "scanner.h"
+#include "charClass.h"
+
+#define BYTES (1 << 20) /* length of a line */
+#define ROUNDS 100
+
+static const char *pathNames[] = { "auto", "scalar", "SSE2", "AVX2" };
+
+double seconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+/* The function makeLine makes a line of about BYTES characters from the given terms
+ * and yields its length.
+ */
+
+int makeLine(char **line, const char **terms, int n) {
+  char *s = malloc(BYTES + 256);
+  int length = 0, k = 0;
+  while (length < BYTES) {
+    length += sprintf(s+length,"%s %s ",terms[k % n],(k % 2 ? "+" : "-"));
+    k++;
+  }
+  *line = s;
+  return length;
+}
+
+int main() {
+  static const char *shortTerms[] = { "3*x^2", "17", "2.5*y", "x^3", "40", "z" };
+  static const char *longTerms[] = {
+    "314159265358*temperature^2", "1234567890123456", "2.718281828459045*pressureDrop",
+    "velocityOfTheFluid^3", "602214076000000", "    boundaryLayerThickness" };
+  const char **sets[] = { shortTerms, longTerms };
+  const char *setNames[] = { "short", "long" };
+  InternTable it;
+  TokenArray ta;
+  char *line;
+  int set, path, length, r;
+  double t0;
+  initInternTable(&it);
+  initTokenArray(&ta);
+  printf("%-8s %10s %10s %10s   (MB/s)\n","tokens","scalar","SSE2","AVX2");
+  for (set = 0; set < 2; set++) {
+    length = makeLine(&line,sets[set],6);
+    printf("%-8s",setNames[set]);
+    for (path = ScanScalar; path <= ScanAVX2; path++) {
+      if ((int)selectScanPath(path) != path) {
+        printf(" %10s","-");
+        continue;
+      }
+      tokenArrayTable(line,length,&ta,&it);
+      t0 = seconds();
+      for (r = 0; r < ROUNDS; r++) {
+        tokenArrayTable(line,length,&ta,&it);
+      }
+      printf(" %10.0f",1e-6*length*ROUNDS/(seconds() - t0));
+    }
+    printf("\n");
+    free(line);
+  }
+  printf("ScanAuto chooses %s\n",pathNames[selectScanPath(ScanAuto)]);
+  freeInternTable(&it);
+  freeTokenArray(&ta);
+  return 0;
+}
@@ -0,0 +1,157 @@
+/* bench/tokens.c
+ *
+ * Compares the token list with the token array (see scanner.h) on equations of 10^3 to
+ * 10^6 tokens: scanning plus analysis (tokenListArena and analyzeEquation against
+ * tokenArrayTable and analyzeEquationFlat), and the analysis alone, which is the walk
+ * over the tokens. Then the same for the parser, on expressions of 10^3 to 10^6 tokens
+ * with parentheses: expressionNode against expressionNodeFlat, on tokens scanned once.
+ * Every measurement handles about 10^7 tokens; the times are in nanoseconds per token.
+ */
+
+#include <stdio.h>  /* printf */
+#include <stdlib.h> /* malloc, free */
+#include <string.h> /* memcpy */
+#include <time.h>   /* clock_gettime */
+#include "scanner.h"
+#include "infixExp.h"
+#include "recognizeExp.h"
+
+#define TOTAL 10000000 /* tokens per measurement */
+
+double seconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+/* The function makeEquation makes an equation with at least n tokens, and yields its
+ * length; *tokens becomes the number of tokens.
+ */
+
+int makeEquation(char **line, int n, int *tokens) {
+  static const char *terms[] = { "3x^2", "17", "2.5x", "x^3", "40", "x" };
+  static const int termTokens[] = { 4, 1, 2, 3, 1, 1 };
+  int capacity = 8*n + 64, length = 0, count = 0, k = 0;
+  char *s = malloc(capacity);
+  while (count < n) {
+    length += sprintf(s+length,"%s%s ",(count == 0 ? "" : (k % 2 ? "+ " : "- ")),terms[k % 6]);
+    count += termTokens[k % 6] + (count > 0);
+    k++;
+  }
+  length += sprintf(s+length,"= 1");
+  *tokens = count + 2;
+  *line = s;
+  return length;
+}
+
+/* The function makeExpression makes an expression with at least n tokens, in pieces
+ * like "a * (b + 2.5) - c / 7", and yields its length; *tokens becomes the number of
+ * tokens.
+ */
+
+int makeExpression(char **line, int n, int *tokens) {
+  static const char *pieces[] = { "a * (b + 2.5)", "c / 7", "(x - 3) * (y + z) / 2", "17" };
+  static const int pieceTokens[] = { 7, 3, 13, 1 };
+  int capacity = 24*n + 64, length = 0, count = 0, k = 0;
+  char *s = malloc(capacity);
+  while (count < n) {
+    length += sprintf(s+length,"%s%s ",(count == 0 ? "" : (k % 2 ? "+ " : "- ")),pieces[k % 4]);
+    count += pieceTokens[k % 4] + (count > 0);
+    k++;
+  }
+  *tokens = count;
+  *line = s;
+  return length;
+}
+
+int main() {
+  Arena a;
+  InternTable it;
+  TokenArray ta;
+  Equation eq;
+  List tl = NULL, l;
+  TokenCursor c;
+  ExpTree tree;
+  char *line;
+  int n, tokens, length, rounds, r;
+  double t0, scanList, scanArray, walkList, walkArray, parseList, parseArray;
+  initArena(&a);
+  initInternTable(&it);
+  initTokenArray(&ta);
+  initEquation(&eq);
+  printf("%9s %12s %12s %12s %12s   (ns per token)\n",
+         "tokens","list","array","list walk","array walk");
+  for (n = 1000; n <= 1000000; n *= 10) {
+    length = makeEquation(&line,n,&tokens);
+    rounds = TOTAL / tokens;
+    t0 = seconds();
+    for (r = 0; r < rounds; r++) {
+      resetArena(&a);
+      tl = tokenListArena(line,length,&a,&it);
+      if (!analyzeEquation(tl,&eq)) {
+        printf("the list analysis failed\n");
+        return 1;
+      }
+    }
+    scanList = seconds() - t0;
+    t0 = seconds();
+    for (r = 0; r < rounds; r++) {
+      analyzeEquation(tl,&eq);
+    }
+    walkList = seconds() - t0;
+    t0 = seconds();
+    for (r = 0; r < rounds; r++) {
+      tokenArrayTable(line,length,&ta,&it);
+      if (!analyzeEquationFlat(tokenCursor(&ta),&eq)) {
+        printf("the array analysis failed\n");
+        return 1;
+      }
+    }
+    scanArray = seconds() - t0;
+    t0 = seconds();
+    for (r = 0; r < rounds; r++) {
+      analyzeEquationFlat(tokenCursor(&ta),&eq);
+    }
+    walkArray = seconds() - t0;
+    printf("%9d %12.2f %12.2f %12.2f %12.2f\n",tokens,
+           1e9*scanList/rounds/tokens,1e9*scanArray/rounds/tokens,
+           1e9*walkList/rounds/tokens,1e9*walkArray/rounds/tokens);
+    free(line);
+  }
+  printf("\n%9s %12s %12s   (ns per token, parsing)\n","tokens","list","array");
+  for (n = 1000; n <= 1000000; n *= 10) {
+    length = makeExpression(&line,n,&tokens);
+    rounds = TOTAL / tokens;
+    resetArena(&a);
+    tl = tokenListArena(line,length,&a,&it);
+    tokenArrayTable(line,length,&ta,&it);
+    t0 = seconds();
+    for (r = 0; r < rounds; r++) {
+      resetExpTrees();
+      l = tl;
+      if (!expressionNode(&l,&tree) || l != NULL) {
+        printf("the list parser failed\n");
+        return 1;
+      }
+    }
+    parseList = seconds() - t0;
+    t0 = seconds();
+    for (r = 0; r < rounds; r++) {
+      resetExpTrees();
+      c = tokenCursor(&ta);
+      if (!expressionNodeFlat(&c,&tree) || c.pos != c.end) {
+        printf("the array parser failed\n");
+        return 1;
+      }
+    }
+    parseArray = seconds() - t0;
+    printf("%9d %12.2f %12.2f\n",tokens,1e9*parseList/rounds/tokens,1e9*parseArray/rounds/tokens);
+    free(line);
+  }
+  resetExpTrees();
+  releaseArena(&a);
+  freeInternTable(&it);
+  freeTokenArray(&ta);
+  freeEquation(&eq);
+  return 0;
+}
@@ -0,0 +1,266 @@
+/* charClass.c
+ *
+ * In this file the character classification of the scanner is defined.
+ * The functions skipSpaces, skipDigits and skipAlnum find the end of a run of
+ * characters of one class. On x86 processors they look at 16 (SSE2) or 32 (AVX2)
+ * characters at a time; which implementation is used is decided at runtime.
+ * The function digitsValue converts 8 digits at a time (SWAR: SIMD within a register).
+ */
+
+#include <string.h> /* memcpy */
+#include "charClass.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+const unsigned char charClass[256] = {
+  0,0,0,0,0,0,0,0,0,1,1,1,1,1,0,0,
+  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+  1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+  2,2,2,2,2,2,2,2,2,2,0,0,0,0,0,0,
+  0,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+  4,4,4,4,4,4,4,4,4,4,4,0,0,0,0,0,
+  0,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+  4,4,4,4,4,4,4,4,4,4,4,0,0,0,0,0,
+  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0
+};
+
+/* The scalar implementations: one character at a time, with the table charClass.
+ */
+
+static inline int skipClassScalar(const char *ar, int i, int length, int cls) {
+  while (i < length && (charClass[(unsigned char)ar[i]] & cls)) {
+    i++;
+  }
+  return i;
+}
+
+static int skipSpacesScalar(const char *ar, int i, int length) {
+  return skipClassScalar(ar,i,length,CLASS_SPACE);
+}
+
+static int skipDigitsScalar(const char *ar, int i, int length) {
+  return skipClassScalar(ar,i,length,CLASS_DIGIT);
+}
+
+static int skipAlnumScalar(const char *ar, int i, int length) {
+  return skipClassScalar(ar,i,length,CLASS_DIGIT|CLASS_LETTER);
+}
+
+#ifdef HAVE_X86_SIMD
+
+/* The SSE2 and AVX2 implementations. A byte x is in the range lo..lo+n precisely when
+ * the unsigned byte x-lo is at most n, i.e. when min(x-lo,n) == x-lo. Letters are
+ * mapped to lower case first by setting bit 5. The movemask of the comparison has a
+ * bit for every character in the class; the first zero bit ends the run.
+ * The tail of the array (less than a vector) is done by the scalar implementation,
+ * so that nothing is read after ar[length-1].
+ */
+
+static inline __m128i inRangeSSE2(__m128i c, char lo, char n) {
+  __m128i x = _mm_sub_epi8(c,_mm_set1_epi8(lo));
+  return _mm_cmpeq_epi8(_mm_min_epu8(x,_mm_set1_epi8(n)),x);
+}
+
+static inline __m128i classMaskSSE2(__m128i c, int cls) {
+  __m128i m = _mm_setzero_si128();
+  if (cls & CLASS_SPACE) {
+    m = _mm_or_si128(m,_mm_or_si128(inRangeSSE2(c,'\t',4),_mm_cmpeq_epi8(c,_mm_set1_epi8(' '))));
+  }
+  if (cls & CLASS_DIGIT) {
+    m = _mm_or_si128(m,inRangeSSE2(c,'0',9));
+  }
+  if (cls & CLASS_LETTER) {
+    m = _mm_or_si128(m,inRangeSSE2(_mm_or_si128(c,_mm_set1_epi8(0x20)),'a',25));
+  }
+  return m;
+}
+
+static inline int skipClassSSE2(const char *ar, int i, int length, int cls) {
+  while (i + 16 <= length) {
+    __m128i c = _mm_loadu_si128((const __m128i *)(ar+i));
+    unsigned rest = ~(unsigned)_mm_movemask_epi8(classMaskSSE2(c,cls)) & 0xFFFF;
+    if (rest != 0) {
+      return i + __builtin_ctz(rest);
+    }
+    i += 16;
+  }
+  return skipClassScalar(ar,i,length,cls);
+}
+
+static int skipSpacesSSE2(const char *ar, int i, int length) {
+  return skipClassSSE2(ar,i,length,CLASS_SPACE);
+}
+
+static int skipDigitsSSE2(const char *ar, int i, int length) {
+  return skipClassSSE2(ar,i,length,CLASS_DIGIT);
+}
+
+static int skipAlnumSSE2(const char *ar, int i, int length) {
+  return skipClassSSE2(ar,i,length,CLASS_DIGIT|CLASS_LETTER);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i inRangeAVX2(__m256i c, char lo, char n) {
+  __m256i x = _mm256_sub_epi8(c,_mm256_set1_epi8(lo));
+  return _mm256_cmpeq_epi8(_mm256_min_epu8(x,_mm256_set1_epi8(n)),x);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i classMaskAVX2(__m256i c, int cls) {
+  __m256i m = _mm256_setzero_si256();
+  if (cls & CLASS_SPACE) {
+    m = _mm256_or_si256(m,_mm256_or_si256(inRangeAVX2(c,'\t',4),_mm256_cmpeq_epi8(c,_mm256_set1_epi8(' '))));
+  }
+  if (cls & CLASS_DIGIT) {
+    m = _mm256_or_si256(m,inRangeAVX2(c,'0',9));
+  }
+  if (cls & CLASS_LETTER) {
+    m = _mm256_or_si256(m,inRangeAVX2(_mm256_or_si256(c,_mm256_set1_epi8(0x20)),'a',25));
+  }
+  return m;
+}
+
+__attribute__((target("avx2")))
+static inline int skipClassAVX2(const char *ar, int i, int length, int cls) {
+  while (i + 32 <= length) {
+    __m256i c = _mm256_loadu_si256((const __m256i *)(ar+i));
+    unsigned rest = ~(unsigned)_mm256_movemask_epi8(classMaskAVX2(c,cls));
+    if (rest != 0) {
+      return i + __builtin_ctz(rest);
+    }
+    i += 32;
+  }
+  return skipClassSSE2(ar,i,length,cls);
+}
+
+__attribute__((target("avx2")))
+static int skipSpacesAVX2(const char *ar, int i, int length) {
+  return skipClassAVX2(ar,i,length,CLASS_SPACE);
+}
+
+__attribute__((target("avx2")))
+static int skipDigitsAVX2(const char *ar, int i, int length) {
+  return skipClassAVX2(ar,i,length,CLASS_DIGIT);
+}
+
+__attribute__((target("avx2")))
+static int skipAlnumAVX2(const char *ar, int i, int length) {
+  return skipClassAVX2(ar,i,length,CLASS_DIGIT|CLASS_LETTER);
+}
+
+#endif
+
+/* The implementation in use. It is chosen by selectScanPath, which is called with
+ * ScanAuto on the first use of one of the run functions.
+ */
+
+typedef int (*RunFunction)(const char *ar, int i, int length);
+
+static RunFunction spacesRun = NULL;
+static RunFunction digitsRun = NULL;
+static RunFunction alnumRun = NULL;
+
+/* The function selectScanPath chooses the implementation of the run functions and yields
+ * the one that has been chosen: the requested one, or the best one that is available
+ * when the requested one is not. ScanAuto chooses SSE2 and not AVX2: the runs of the
+ * input are short, and AVX2 has been slower than SSE2 in bench/scanPaths.c.
+ */
+
+ScanPath selectScanPath(ScanPath path) {
+#ifdef HAVE_X86_SIMD
+  __builtin_cpu_init();
+  if (path == ScanAuto || (path == ScanAVX2 && !__builtin_cpu_supports("avx2"))) {
+    path = ScanSSE2;
+  }
+  if (path == ScanAVX2) {
+    spacesRun = skipSpacesAVX2;
+    digitsRun = skipDigitsAVX2;
+    alnumRun = skipAlnumAVX2;
+    return ScanAVX2;
+  }
+  if (path == ScanSSE2) {
+    spacesRun = skipSpacesSSE2;
+    digitsRun = skipDigitsSSE2;
+    alnumRun = skipAlnumSSE2;
+    return ScanSSE2;
+  }
+#endif
+  spacesRun = skipSpacesScalar;
+  digitsRun = skipDigitsScalar;
+  alnumRun = skipAlnumScalar;
+  return ScanScalar;
+}
+
+/* The function initCharClass chooses the default implementation, unless one has been chosen
+ * already. It has to be called before the run functions are used by several threads.
+ */
+
+void initCharClass() {
+  if (spacesRun == NULL) {
+    selectScanPath(ScanAuto);
+  }
+}
+
+/* The functions skipSpaces, skipDigits and skipAlnum yield the index of the first
+ * character at or after ar[i] that is not a space, a digit or a letter/digit,
+ * respectively; the result is at most length.
+ */
+
+int skipSpaces(const char *ar, int i, int length) {
+  if (spacesRun == NULL) {
+    selectScanPath(ScanAuto);
+  }
+  return spacesRun(ar,i,length);
+}
+
+int skipDigits(const char *ar, int i, int length) {
+  if (digitsRun == NULL) {
+    selectScanPath(ScanAuto);
+  }
+  return digitsRun(ar,i,length);
+}
+
+int skipAlnum(const char *ar, int i, int length) {
+  if (alnumRun == NULL) {
+    selectScanPath(ScanAuto);
+  }
+  return alnumRun(ar,i,length);
+}
+
+/* The function digitsValue computes the value of the digits ar[i..j), modulo 2^64,
+ * just like the loop n = 10*n + digit does with unsigned arithmetic.
+ * On little endian machines 8 digits are converted at once: after subtracting '0'
+ * from every byte, neighbouring digits are combined into 2-digit, 4-digit and
+ * 8-digit numbers with three multiplications.
+ */
+
+uint64_t digitsValue(const char *ar, int i, int j) {
+  uint64_t n = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  while (j - i >= 8) {
+    uint64_t v;
+    memcpy(&v,ar+i,8);
+    v -= 0x3030303030303030ULL;
+    v = (v * 10) + (v >> 8);
+    v = (((v & 0x000000FF000000FFULL) * 0x000F424000000064ULL)
+         + (((v >> 16) & 0x000000FF000000FFULL) * 0x0000271000000001ULL)) >> 32;
+    n = n*100000000u + v;
+    i += 8;
+  }
+#endif
+  while (i < j) {
+    n = 10*n + (uint64_t)(ar[i] - '0');
+    i++;
+  }
+  return n;
+}
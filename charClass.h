@@ -0,0 +1,42 @@
+/* charClass.h */
+
+#ifndef CHARCLASS_H
+#define CHARCLASS_H
+
+#include <stdint.h> /* uint64_t */
+
+/* The classes of characters that the scanner distinguishes. Unlike the functions of
+ * ctype.h they do not depend on the locale: only ' ', '\t', '\n', '\v', '\f' and '\r'
+ * are spaces, only '0'..'9' are digits and only 'a'..'z' and 'A'..'Z' are letters.
+ */
+
+#define CLASS_SPACE  1
+#define CLASS_DIGIT  2
+#define CLASS_LETTER 4
+
+extern const unsigned char charClass[256];
+
+#define isSpaceChar(c)  (charClass[(unsigned char)(c)] & CLASS_SPACE)
+#define isDigitChar(c)  (charClass[(unsigned char)(c)] & CLASS_DIGIT)
+#define isLetterChar(c) (charClass[(unsigned char)(c)] & CLASS_LETTER)
+#define isAlnumChar(c)  (charClass[(unsigned char)(c)] & (CLASS_DIGIT|CLASS_LETTER))
+
+/* The implementations of the run functions below. ScanAuto chooses SSE2 when the
+ * processor has it; AVX2 is used only when it is requested (see selectScanPath).
+ */
+
+typedef enum ScanPath {
+  ScanAuto,
+  ScanScalar,
+  ScanSSE2,
+  ScanAVX2
+} ScanPath;
+
+ScanPath selectScanPath(ScanPath path);
+void initCharClass();
+int skipSpaces(const char *ar, int i, int length);
+int skipDigits(const char *ar, int i, int length);
+int skipAlnum(const char *ar, int i, int length);
+uint64_t digitsValue(const char *ar, int i, int j);
+
+#endif
@@ -0,0 +1,234 @@
+/* expBatch.c
+ *
+ * In this file an expression is evaluated in n points at once: columns[id][i] is the
+ * value of the identifier with that id in point i, and the value of the expression in
+ * point i is written to out[i].
+ * The bytecode of the expression (see expCode.h) is run on blocks of points: every
+ * stack entry and temporary is a column with a value per point of the block, and every
+ * instruction is a loop over a column, which the compiler vectorizes. The number of
+ * points of a block is chosen per expression (see batchWidth), so that all columns
+ * together fit in the L1 cache, unless there are very many temporaries. On x86-64 an AVX2 version of these loops is chosen at runtime, next to the
+ * SSE2 version; elsewhere they are plain loops.
+ * Large batches are divided over a number of threads, each with columns of its own.
+ */
+
+#include <stdlib.h> /* malloc, free */
+#include <string.h> /* memcpy, memset */
+#include <unistd.h> /* sysconf */
+#include <assert.h> /* assert */
+#include <pthread.h>
+#include "scanner.h"
+#include "infixExp.h"
+#include "expCode.h"
+#include "expBatch.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define KERNEL __attribute__((target_clones("avx2","default")))
+#else
+#define KERNEL
+#endif
+
+/* The kernels on columns. They always handle all width values of a column, also in the
+ * last block, which may have fewer points; width is a multiple of BATCHMINBLOCK, so that
+ * the vectorized loops have no scalar remainder.
+ */
+
+KERNEL
+static void fillColumn(double *restrict y, double value, int width) {
+  int j, k;
+  for (j = 0; j < width; j += BATCHMINBLOCK) {
+    for (k = j; k < j+BATCHMINBLOCK; k++) {
+      y[k] = value;
+    }
+  }
+}
+
+KERNEL
+static void addColumns(double *restrict y, const double *restrict x, int width) {
+  int j, k;
+  for (j = 0; j < width; j += BATCHMINBLOCK) {
+    for (k = j; k < j+BATCHMINBLOCK; k++) {
+      y[k] += x[k];
+    }
+  }
+}
+
+KERNEL
+static void subColumns(double *restrict y, const double *restrict x, int width) {
+  int j, k;
+  for (j = 0; j < width; j += BATCHMINBLOCK) {
+    for (k = j; k < j+BATCHMINBLOCK; k++) {
+      y[k] -= x[k];
+    }
+  }
+}
+
+KERNEL
+static void mulColumns(double *restrict y, const double *restrict x, int width) {
+  int j, k;
+  for (j = 0; j < width; j += BATCHMINBLOCK) {
+    for (k = j; k < j+BATCHMINBLOCK; k++) {
+      y[k] *= x[k];
+    }
+  }
+}
+
+KERNEL
+static void divColumns(double *restrict y, const double *restrict x, int width) {
+  int j, k;
+  for (j = 0; j < width; j += BATCHMINBLOCK) {
+    for (k = j; k < j+BATCHMINBLOCK; k++) {
+      y[k] /= x[k];
+    }
+  }
+}
+
+/* The function batchWidth yields the number of points of a block for the code: the
+ * largest multiple of BATCHMINBLOCK, at most BATCHBLOCK, for which the columns of the
+ * temporaries and the stack take at most BATCHCACHE bytes. Code with more than
+ * BATCHCACHE / (BATCHMINBLOCK*8) columns gets blocks of BATCHMINBLOCK points, and then
+ * its columns no longer fit in the L1 cache: smaller blocks were slower, because every
+ * instruction is dispatched once per block.
+ */
+
+int batchWidth(const ExpCode *c) {
+  int columns = c->temps + c->depth;
+  int width = BATCHCACHE / (columns > 0 ? columns : 1) / (int)sizeof(double);
+  width -= width % BATCHMINBLOCK;
+  if (width < BATCHMINBLOCK) {
+    return BATCHMINBLOCK;
+  }
+  return (width > BATCHBLOCK ? BATCHBLOCK : width);
+}
+
+/* The function evalBlock evaluates the code in the points start..start+n-1 (n is at most
+ * width). values has room for the temporaries and the stack, each a column of width
+ * values.
+ */
+
+void evalBlock(const ExpCode *c, const double *columns[], double *out, size_t start, int n,
+               int width, double *values) {
+  const Instruction *ip;
+  double *temps = values;
+  double *sp = values + (size_t)c->temps*width; /* sp - width is the top */
+  for (ip = c->code; ip->op != OpEnd; ip++) {
+    switch (ip->op) {
+    case OpConst:
+      fillColumn(sp,c->constants[ip->operand],width);
+      sp += width;
+      break;
+    case OpVar:
+      memcpy(sp,columns[ip->operand]+start,n*sizeof(double));
+      if (n < width) {
+        memset(sp+n,0,(width-n)*sizeof(double));
+      }
+      sp += width;
+      break;
+    case OpAdd:
+      sp -= width;
+      addColumns(sp-width,sp,width);
+      break;
+    case OpSub:
+      sp -= width;
+      subColumns(sp-width,sp,width);
+      break;
+    case OpMul:
+      sp -= width;
+      mulColumns(sp-width,sp,width);
+      break;
+    case OpDiv:
+      sp -= width;
+      divColumns(sp-width,sp,width);
+      break;
+    case OpSave:
+      memcpy(temps+(size_t)ip->operand*width,sp-width,width*sizeof(double));
+      break;
+    case OpTemp:
+      memcpy(sp,temps+(size_t)ip->operand*width,width*sizeof(double));
+      sp += width;
+      break;
+    }
+  }
+  memcpy(out+start,sp-width,n*sizeof(double));
+}
+
+/* The work of one thread: the points from..to-1, in blocks of width points.
+ * threaded tells whether the part runs in a thread of its own.
+ */
+
+typedef struct BatchPart {
+  const ExpCode *c;
+  const double **columns;
+  double *out;
+  size_t from;
+  size_t to;
+  int width;
+  int threaded;
+} BatchPart;
+
+void *evalPart(void *arg) {
+  BatchPart *p = arg;
+  int width = p->width;
+  double *values = malloc(((size_t)p->c->temps + p->c->depth)*width*sizeof(double));
+  size_t start;
+  assert( values != NULL );
+  for (start = p->from; start < p->to; start += width) {
+    evalBlock(p->c,p->columns,p->out,start,
+              (p->to - start < (size_t)width ? (int)(p->to - start) : width),width,values);
+  }
+  free(values);
+  return NULL;
+}
+
+/* The function evalExpCodeBatch evaluates compiled code in n points, with the given
+ * number of threads when n is at least BATCHTHREADED. The part of a thread that cannot
+ * be started is evaluated by the calling thread.
+ */
+
+void evalExpCodeBatch(const ExpCode *c, const double *columns[], double *out, size_t n, int threads) {
+  pthread_t *pool;
+  BatchPart *parts;
+  int width = batchWidth(c);
+  size_t blocks = (n + width - 1) / width;
+  int k;
+  if (n < BATCHTHREADED || threads < 2) {
+    threads = 1;
+  }
+  parts = malloc(threads*sizeof(BatchPart));
+  pool = malloc(threads*sizeof(pthread_t));
+  assert( parts != NULL && pool != NULL );
+  for (k = 0; k < threads; k++) { /* whole blocks for every thread, except the last */
+    parts[k].c = c;
+    parts[k].columns = columns;
+    parts[k].out = out;
+    parts[k].from = blocks*k/threads*width;
+    parts[k].to = (k == threads-1 ? n : blocks*(k+1)/threads*width);
+    parts[k].width = width;
+    parts[k].threaded = 0;
+  }
+  for (k = 1; k < threads; k++) {
+    parts[k].threaded = (pthread_create(&pool[k],NULL,evalPart,&parts[k]) == 0);
+  }
+  evalPart(&parts[0]);
+  for (k = 1; k < threads; k++) {
+    if (parts[k].threaded) {
+      pthread_join(pool[k],NULL);
+    } else {
+      evalPart(&parts[k]);
+    }
+  }
+  free(parts);
+  free(pool);
+}
+
+/* The function evalBatch evaluates an expression tree in n points, with a thread per
+ * processor for large n. columns[id] must be given for every identifier in tr.
+ */
+
+void evalBatch(ExpTree tr, const double *columns[], double *out, size_t n) {
+  ExpCode c;
+  initExpCode(&c);
+  compileExpTree(tr,&c);
+  evalExpCodeBatch(&c,columns,out,n,(int)sysconf(_SC_NPROCESSORS_ONLN));
+  freeExpCode(&c);
+}
@@ -0,0 +1,17 @@
+/* expBatch.h */
+
+#ifndef EXPBATCH_H
+#define EXPBATCH_H
+
+#include <stddef.h> /* size_t */
+
+#define BATCHBLOCK 256         /* largest number of points that are evaluated together */
+#define BATCHMINBLOCK 64       /* smallest number, and the step, of batchWidth */
+#define BATCHCACHE (32*1024)   /* bytes of columns that should fit in the L1 cache */
+#define BATCHTHREADED (1 << 16) /* from this number of points on, threads are used */
+
+int batchWidth(const ExpCode *c);
+void evalExpCodeBatch(const ExpCode *c, const double *columns[], double *out, size_t n, int threads);
+void evalBatch(ExpTree tr, const double *columns[], double *out, size_t n);
+
+#endif
@@ -0,0 +1,253 @@
+/* expCode.c
+ *
+ * In this file expression trees are compiled to bytecode (see expCode.h), and the
+ * bytecode is evaluated by a stack machine. Compiling takes one pass over the DAG;
+ * after that an expression can be evaluated many times, for different values of its
+ * identifiers, without recursion and without allocation.
+ * With GCC and Clang the interpreter jumps from instruction to instruction with
+ * computed gotos (a jump through a table of label addresses after every instruction);
+ * otherwise it uses a switch in a loop.
+ */
+
+#include <stdlib.h> /* malloc, realloc, free */
+#include <string.h> /* memset */
+#include <assert.h> /* assert */
+#include "scanner.h"
+#include "infixExp.h"
+#include "expCode.h"
+
+/* The function initExpCode makes empty bytecode, and freeExpCode frees its memory.
+ */
+
+void initExpCode(ExpCode *c) {
+  c->code = NULL;
+  c->length = 0;
+  c->capacity = 0;
+  c->constants = NULL;
+  c->constantCount = 0;
+  c->constantCapacity = 0;
+  c->depth = 0;
+  c->temps = 0;
+  c->slots = 0;
+}
+
+void freeExpCode(ExpCode *c) {
+  free(c->code);
+  free(c->constants);
+  initExpCode(c);
+}
+
+/* The function emit appends an instruction; height is the size of the stack after it.
+ */
+
+void emit(ExpCode *c, int op, int operand, int *height) {
+  if (c->length >= c->capacity) {
+    c->capacity = 2*c->capacity + 16;
+    c->code = realloc(c->code,c->capacity*sizeof(Instruction));
+    assert( c->code != NULL );
+  }
+  c->code[c->length].op = op;
+  c->code[c->length].operand = operand;
+  c->length++;
+  switch (op) {
+  case OpConst:
+  case OpVar:
+  case OpTemp:
+    (*height)++;
+    break;
+  case OpAdd:
+  case OpSub:
+  case OpMul:
+  case OpDiv:
+    (*height)--;
+    break;
+  }
+  if (*height > c->depth) {
+    c->depth = *height;
+  }
+}
+
+int addConstant(ExpCode *c, double value) {
+  if (c->constantCount >= c->constantCapacity) {
+    c->constantCapacity = 2*c->constantCapacity + 16;
+    c->constants = realloc(c->constants,c->constantCapacity*sizeof(double));
+    assert( c->constants != NULL );
+  }
+  c->constants[c->constantCount] = value;
+  return c->constantCount++;
+}
+
+/* The function countUses counts for every node of the DAG how many parents it has, with
+ * one loop over its nodes in post-order (see postOrder).
+ */
+
+void countUses(ExpTree tr, int *uses) {
+  ExpTree *nodes;
+  int count, k;
+  nodes = postOrder(tr,&count);
+  for (k = 0; k < count; k++) {
+    if (nodes[k]->tt == Symbol) {
+      uses[nodes[k]->left->id]++;
+      uses[nodes[k]->right->id]++;
+    }
+  }
+  free(nodes);
+}
+
+/* The function compileNode appends the code that pushes the value of tr. The value of
+ * an operator node with more than one parent is saved in temporary temp[id] (initially
+ * -1) the first time, and pushed from there the next times.
+ * The tree is walked with a TreeStack: an operator node has state 0 before its
+ * children and 1 after them.
+ */
+
+void compileNode(ExpCode *c, ExpTree tr, int *uses, int *temp, int *height) {
+  TreeStack s;
+  TreeFrame *f;
+  initTreeStack(&s);
+  pushTree(&s,tr,0);
+  while (s.size > 0) {
+    f = &s.frames[s.size-1];
+    tr = f->tree;
+    if (f->state == 1) {
+      s.size--;
+      switch ((tr->t).symbol) {
+      case '+':
+        emit(c,OpAdd,0,height);
+        break;
+      case '-':
+        emit(c,OpSub,0,height);
+        break;
+      case '*':
+        emit(c,OpMul,0,height);
+        break;
+      case '/':
+        emit(c,OpDiv,0,height);
+        break;
+      default:
+        abort();
+      }
+      if (uses[tr->id] > 1) {
+        temp[tr->id] = c->temps++;
+        emit(c,OpSave,temp[tr->id],height);
+      }
+      continue;
+    }
+    if (temp[tr->id] >= 0) {
+      s.size--;
+      emit(c,OpTemp,temp[tr->id],height);
+      continue;
+    }
+    switch (tr->tt) {
+    case Number:
+    case Real:
+      s.size--;
+      emit(c,OpConst,addConstant(c,numberValue(tr->tt,tr->t)),height);
+      break;
+    case Identifier:
+      s.size--;
+      emit(c,OpVar,(tr->t).identifier.id,height);
+      if ((tr->t).identifier.id >= c->slots) {
+        c->slots = (tr->t).identifier.id + 1;
+      }
+      break;
+    case Symbol:
+      f->state = 1;
+      pushTree(&s,tr->right,0);
+      pushTree(&s,tr->left,0);
+      break;
+    }
+  }
+  freeTreeStack(&s);
+}
+
+/* The function compileExpTree compiles the expression tr to bytecode in c, which must
+ * have been initialized; its previous contents are overwritten.
+ */
+
+void compileExpTree(ExpTree tr, ExpCode *c) {
+  int n = expTreeNodeCount();
+  int *uses = calloc(n+1,sizeof(int));
+  int *temp = malloc((n+1)*sizeof(int));
+  int height = 0;
+  assert( uses != NULL && temp != NULL );
+  memset(temp,-1,(n+1)*sizeof(int));
+  c->length = 0;
+  c->constantCount = 0;
+  c->depth = 0;
+  c->temps = 0;
+  c->slots = 0;
+  countUses(tr,uses);
+  compileNode(c,tr,uses,temp,&height);
+  emit(c,OpEnd,0,&height);
+  free(uses);
+  free(temp);
+}
+
+/* The function evalWorkSize yields the number of doubles of work memory that
+ * evalExpCode needs for the code.
+ */
+
+int evalWorkSize(const ExpCode *c) {
+  return c->temps + c->depth + 1;
+}
+
+/* The function evalExpCode computes the value of compiled code, where bindings[id] is
+ * the value of the identifier with that id; work has evalWorkSize(c) doubles.
+ * Division by 0 gives an infinity or NaN.
+ */
+
+double evalExpCode(const ExpCode *c, const double *bindings, double *work) {
+  const Instruction *ip = c->code;
+  const double *constants = c->constants;
+  double *temps = work;
+  double *sp = work + c->temps; /* sp[-1] is the top of the stack */
+#if defined(__GNUC__)
+  static void *labels[] = { &&doConst, &&doVar, &&doAdd, &&doSub, &&doMul, &&doDiv,
+                            &&doSave, &&doTemp, &&doEnd };
+#define DISPATCH goto *labels[(ip++)->op]
+#define CASE(label,op) label
+  DISPATCH;
+#else
+#define DISPATCH continue
+#define CASE(label,op) case op
+  for (;;) {
+    switch ((ip++)->op) {
+#endif
+  CASE(doConst,OpConst):
+    *sp++ = constants[ip[-1].operand];
+    DISPATCH;
+  CASE(doVar,OpVar):
+    *sp++ = bindings[ip[-1].operand];
+    DISPATCH;
+  CASE(doAdd,OpAdd):
+    sp--;
+    sp[-1] += sp[0];
+    DISPATCH;
+  CASE(doSub,OpSub):
+    sp--;
+    sp[-1] -= sp[0];
+    DISPATCH;
+  CASE(doMul,OpMul):
+    sp--;
+    sp[-1] *= sp[0];
+    DISPATCH;
+  CASE(doDiv,OpDiv):
+    sp--;
+    sp[-1] /= sp[0];
+    DISPATCH;
+  CASE(doSave,OpSave):
+    temps[ip[-1].operand] = sp[-1];
+    DISPATCH;
+  CASE(doTemp,OpTemp):
+    *sp++ = temps[ip[-1].operand];
+    DISPATCH;
+  CASE(doEnd,OpEnd):
+    return sp[-1];
+#if !defined(__GNUC__)
+    }
+  }
+#endif
+#undef DISPATCH
+#undef CASE
+}
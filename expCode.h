@@ -0,0 +1,58 @@
+/* expCode.h */
+
+#ifndef EXPCODE_H
+#define EXPCODE_H
+
+/* The bytecode of an expression: a sequence of instructions for a stack machine.
+ *
+ *   OpConst k   push constants[k]
+ *   OpVar id    push bindings[id], the value of the identifier with that id
+ *   OpAdd, OpSub, OpMul, OpDiv
+ *               pop the right and the left operand, push the result
+ *   OpSave k    store the top of the stack in temporary k (without popping it)
+ *   OpTemp k    push temporary k
+ *   OpEnd       the result is the top of the stack
+ *
+ * A node that is shared in the expression DAG is computed once, saved in a temporary,
+ * and later pushed from there. The stack and the temporaries are in work memory of
+ * the caller (first the temporaries, then the stack) of evalWorkSize doubles:
+ * evalExpCode allocates nothing and does not change the code, so that several threads
+ * can evaluate the same code, each with work memory of its own.
+ */
+
+typedef enum OpCode {
+  OpConst,
+  OpVar,
+  OpAdd,
+  OpSub,
+  OpMul,
+  OpDiv,
+  OpSave,
+  OpTemp,
+  OpEnd
+} OpCode;
+
+typedef struct Instruction {
+  int op;
+  int operand;
+} Instruction;
+
+typedef struct ExpCode {
+  Instruction *code;
+  int length;
+  int capacity;
+  double *constants;
+  int constantCount;
+  int constantCapacity;
+  int depth;      /* the largest size of the stack */
+  int temps;      /* the number of temporaries */
+  int slots;      /* bindings must have at least this many entries */
+} ExpCode;
+
+void initExpCode(ExpCode *c);
+void compileExpTree(ExpTree tr, ExpCode *c);
+int evalWorkSize(const ExpCode *c);
+double evalExpCode(const ExpCode *c, const double *bindings, double *work);
+void freeExpCode(ExpCode *c);
+
+#endif
@@ -0,0 +1,191 @@
+/* expGradient.c
+ *
+ * In this file the gradient of an expression is computed: the derivatives to all its
+ * identifiers at once (reverse-mode automatic differentiation). The bytecode of the
+ * expression (see expCode.h) is run once, recording on a tape the value of every
+ * instruction and the instructions of its operands. Then the tape is swept backwards,
+ * from the result to the identifiers, with the adjoint of every instruction: the
+ * derivative of the result to the value of that instruction. An instruction passes its
+ * adjoint on to its operands by the chain rule,
+ *
+ *   l + r:  adjoint(l) += a,     adjoint(r) += a
+ *   l - r:  adjoint(l) += a,     adjoint(r) -= a
+ *   l * r:  adjoint(l) += a*r,   adjoint(r) += a*l
+ *   l / r:  adjoint(l) += a/r,   adjoint(r) -= a*(l/r)/r
+ *
+ * and an identifier adds its adjoint to its entry of the gradient. Both passes take a
+ * number of steps proportional to the length of the code, whatever the number of
+ * identifiers.
+ */
+
+#include <stdlib.h> /* malloc, realloc, free */
+#include <string.h> /* memset */
+#include <assert.h> /* assert */
+#include "scanner.h"
+#include "infixExp.h"
+#include "expCode.h"
+#include "expGradient.h"
+
+/* The function initTape makes an empty tape, and freeTape frees its memory.
+ */
+
+void initTape(Tape *t) {
+  t->values = NULL;
+  t->adjoints = NULL;
+  t->left = NULL;
+  t->right = NULL;
+  t->stack = NULL;
+  t->temps = NULL;
+  t->capacity = 0;
+}
+
+void freeTape(Tape *t) {
+  free(t->values);
+  free(t->adjoints);
+  free(t->left);
+  free(t->right);
+  free(t->stack);
+  free(t->temps);
+  initTape(t);
+}
+
+/* The function growTape makes room on the tape for code of length n (the stack and
+ * the temporaries are never larger than the code).
+ */
+
+void growTape(Tape *t, int n) {
+  if (n <= t->capacity) {
+    return;
+  }
+  t->capacity = 2*t->capacity + 16;
+  if (t->capacity < n) {
+    t->capacity = n;
+  }
+  t->values = realloc(t->values,t->capacity*sizeof(double));
+  t->adjoints = realloc(t->adjoints,t->capacity*sizeof(double));
+  t->left = realloc(t->left,t->capacity*sizeof(int));
+  t->right = realloc(t->right,t->capacity*sizeof(int));
+  t->stack = realloc(t->stack,t->capacity*sizeof(int));
+  t->temps = realloc(t->temps,t->capacity*sizeof(int));
+  assert( t->values != NULL && t->adjoints != NULL && t->left != NULL
+          && t->right != NULL && t->stack != NULL && t->temps != NULL );
+}
+
+/* The function recordExpCode runs the code, recording it on the tape, and yields the
+ * instruction of the result.
+ */
+
+int recordExpCode(const ExpCode *c, const double *bindings, Tape *t) {
+  int i, sp = 0, l, r;
+  double *v = t->values;
+  for (i = 0; c->code[i].op != OpEnd; i++) {
+    switch (c->code[i].op) {
+    case OpConst:
+      v[i] = c->constants[c->code[i].operand];
+      t->stack[sp++] = i;
+      break;
+    case OpVar:
+      v[i] = bindings[c->code[i].operand];
+      t->stack[sp++] = i;
+      break;
+    case OpSave:
+      t->temps[c->code[i].operand] = t->stack[sp-1];
+      break;
+    case OpTemp:
+      l = t->temps[c->code[i].operand];
+      t->left[i] = l;
+      v[i] = v[l];
+      t->stack[sp++] = i;
+      break;
+    default: /* the operators */
+      r = t->stack[--sp];
+      l = t->stack[sp-1];
+      t->left[i] = l;
+      t->right[i] = r;
+      switch (c->code[i].op) {
+      case OpAdd:
+        v[i] = v[l] + v[r];
+        break;
+      case OpSub:
+        v[i] = v[l] - v[r];
+        break;
+      case OpMul:
+        v[i] = v[l] * v[r];
+        break;
+      case OpDiv:
+        v[i] = v[l] / v[r];
+        break;
+      }
+      t->stack[sp-1] = i;
+      break;
+    }
+  }
+  return t->stack[sp-1];
+}
+
+/* The function gradientExpCode yields the value of compiled code, where bindings[id] is
+ * the value of the identifier with that id, and makes gradient[id] the derivative to
+ * that identifier, for all ids below c->slots (so gradient must have that many entries).
+ */
+
+double gradientExpCode(const ExpCode *c, const double *bindings, double *gradient, Tape *t) {
+  int i, result;
+  double a, *v, *adjoints;
+  growTape(t,c->length);
+  result = recordExpCode(c,bindings,t);
+  v = t->values;
+  adjoints = t->adjoints;
+  memset(adjoints,0,(result+1)*sizeof(double));
+  memset(gradient,0,c->slots*sizeof(double));
+  adjoints[result] = 1;
+  for (i = result; i >= 0; i--) {
+    a = adjoints[i];
+    if (a == 0) {
+      continue;
+    }
+    switch (c->code[i].op) {
+    case OpVar:
+      gradient[c->code[i].operand] += a;
+      break;
+    case OpTemp:
+      adjoints[t->left[i]] += a;
+      break;
+    case OpAdd:
+      adjoints[t->left[i]] += a;
+      adjoints[t->right[i]] += a;
+      break;
+    case OpSub:
+      adjoints[t->left[i]] += a;
+      adjoints[t->right[i]] -= a;
+      break;
+    case OpMul:
+      adjoints[t->left[i]] += a * v[t->right[i]];
+      adjoints[t->right[i]] += a * v[t->left[i]];
+      break;
+    case OpDiv:
+      adjoints[t->left[i]] += a / v[t->right[i]];
+      adjoints[t->right[i]] -= a * v[i] / v[t->right[i]];
+      break;
+    }
+  }
+  return v[result];
+}
+
+/* The function gradientExpTree yields the value of an expression tree and makes
+ * gradient[id] the derivative to the identifier with that id, for all ids below
+ * identifierCount().
+ */
+
+double gradientExpTree(ExpTree tr, const double *bindings, double *gradient) {
+  ExpCode c;
+  Tape t;
+  double value;
+  initExpCode(&c);
+  initTape(&t);
+  compileExpTree(tr,&c);
+  memset(gradient,0,identifierCount()*sizeof(double));
+  value = gradientExpCode(&c,bindings,gradient,&t);
+  freeTape(&t);
+  freeExpCode(&c);
+  return value;
+}
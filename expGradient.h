@@ -0,0 +1,26 @@
+/* expGradient.h */
+
+#ifndef EXPGRADIENT_H
+#define EXPGRADIENT_H
+
+/* The tape of a run of bytecode: for instruction i its value, the instructions that
+ * computed its operands (left and right; for OpTemp left is the instruction that was
+ * saved), and its adjoint, the derivative of the result to its value.
+ */
+
+typedef struct Tape {
+  double *values;
+  double *adjoints;
+  int *left;
+  int *right;
+  int *stack;     /* the instructions whose values are on the stack */
+  int *temps;     /* the instructions whose values are in the temporaries */
+  int capacity;
+} Tape;
+
+void initTape(Tape *t);
+void freeTape(Tape *t);
+double gradientExpCode(const ExpCode *c, const double *bindings, double *gradient, Tape *t);
+double gradientExpTree(ExpTree tr, const double *bindings, double *gradient);
+
+#endif
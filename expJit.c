@@ -0,0 +1,225 @@
+/* expJit.c
+ *
+ * In this file expressions are compiled to x86-64 machine code. The translation starts
+ * from the bytecode of the expression (see expCode.h), in which the height of the stack
+ * is known at every instruction. That gives a simple register allocation: stack entry
+ * k is register xmm<k> for k < JITREGISTERS, and a place in the scratch memory otherwise;
+ * xmm15 is used to compute with entries in memory. Temporaries are in the scratch memory
+ * too. The code is written in a page that is made executable (and no longer writable)
+ * afterwards. The function follows the System V calling convention:
+ *
+ *   rdi: bindings, rsi: constants, rdx: scratch, result in xmm0
+ *
+ * On other platforms compileJit only compiles to bytecode, which evalJit then runs.
+ */
+
+#include <stdlib.h> /* NULL */
+#include "scanner.h"
+#include "infixExp.h"
+#include "expCode.h"
+#include "expJit.h"
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__))
+#define JIT_X86_64
+#include <sys/mman.h> /* mmap, mprotect, munmap */
+#include <unistd.h>   /* sysconf */
+#endif
+
+/* The function initJit makes empty code, and freeJit frees its memory.
+ */
+
+void initJit(JitCode *j) {
+  initExpCode(&(j->code));
+  j->page = NULL;
+  j->size = 0;
+  j->function = NULL;
+}
+
+void freeJit(JitCode *j) {
+#ifdef JIT_X86_64
+  if (j->page != NULL) {
+    munmap(j->page,j->size);
+  }
+#endif
+  freeExpCode(&(j->code));
+  initJit(j);
+}
+
+#ifdef JIT_X86_64
+
+#define RDI 7
+#define RSI 6
+#define RDX 2
+#define XMM15 15
+
+/* The opcodes (after F2 0F) of the SSE2 scalar double instructions.
+ */
+
+#define MOVSD_LOAD 0x10
+#define MOVSD_STORE 0x11
+#define ADDSD 0x58
+#define MULSD 0x59
+#define SUBSD 0x5C
+#define DIVSD 0x5E
+
+/* The function emitRegister appends "op xmm<x>, xmm<y>".
+ */
+
+unsigned char *emitRegister(unsigned char *p, int op, int x, int y) {
+  *p++ = 0xF2;
+  if (x >= 8 || y >= 8) {
+    *p++ = 0x40 | (x >= 8 ? 4 : 0) | (y >= 8 ? 1 : 0); /* REX.R, REX.B */
+  }
+  *p++ = 0x0F;
+  *p++ = op;
+  *p++ = 0xC0 | ((x & 7) << 3) | (y & 7);
+  return p;
+}
+
+/* The function emitMemory appends "op xmm<x>, [base + offset]" (for MOVSD_STORE the
+ * other way around).
+ */
+
+unsigned char *emitMemory(unsigned char *p, int op, int x, int base, int offset) {
+  *p++ = 0xF2;
+  if (x >= 8) {
+    *p++ = 0x44; /* REX.R */
+  }
+  *p++ = 0x0F;
+  *p++ = op;
+  *p++ = 0x80 | ((x & 7) << 3) | base; /* [base + disp32] */
+  *p++ = offset & 0xFF;
+  *p++ = (offset >> 8) & 0xFF;
+  *p++ = (offset >> 16) & 0xFF;
+  *p++ = (offset >> 24) & 0xFF;
+  return p;
+}
+
+/* The scratch memory holds the temporaries, followed by the stack entries that are not
+ * in registers: entryOffset is the offset of stack entry k >= JITREGISTERS.
+ */
+
+int entryOffset(const ExpCode *c, int k) {
+  return 8 * (c->temps + k - JITREGISTERS);
+}
+
+/* The function emitLoad appends code that loads a value from [base + offset] into stack
+ * entry k, and emitStore code that stores stack entry k at [RDX + offset].
+ */
+
+unsigned char *emitLoad(unsigned char *p, const ExpCode *c, int k, int base, int offset) {
+  if (k < JITREGISTERS) {
+    return emitMemory(p,MOVSD_LOAD,k,base,offset);
+  }
+  p = emitMemory(p,MOVSD_LOAD,XMM15,base,offset);
+  return emitMemory(p,MOVSD_STORE,XMM15,RDX,entryOffset(c,k));
+}
+
+unsigned char *emitStore(unsigned char *p, const ExpCode *c, int k, int offset) {
+  if (k < JITREGISTERS) {
+    return emitMemory(p,MOVSD_STORE,k,RDX,offset);
+  }
+  p = emitMemory(p,MOVSD_LOAD,XMM15,RDX,entryOffset(c,k));
+  return emitMemory(p,MOVSD_STORE,XMM15,RDX,offset);
+}
+
+/* The function emitOperation appends code for an arithmetic instruction, whose operands
+ * are the stack entries k-1 and k; the result goes to entry k-1.
+ */
+
+unsigned char *emitOperation(unsigned char *p, const ExpCode *c, int op, int k) {
+  if (k < JITREGISTERS) {
+    return emitRegister(p,op,k-1,k);
+  }
+  if (k-1 < JITREGISTERS) {
+    return emitMemory(p,op,k-1,RDX,entryOffset(c,k));
+  }
+  p = emitMemory(p,MOVSD_LOAD,XMM15,RDX,entryOffset(c,k-1));
+  p = emitMemory(p,op,XMM15,RDX,entryOffset(c,k));
+  return emitMemory(p,MOVSD_STORE,XMM15,RDX,entryOffset(c,k-1));
+}
+
+/* The function translate writes the machine code for the bytecode at p, and yields
+ * the end of the code. An instruction takes at most 3 machine instructions of 9 bytes.
+ */
+
+unsigned char *translate(const ExpCode *c, unsigned char *p) {
+  const Instruction *ip;
+  int height = 0;
+  for (ip = c->code; ip->op != OpEnd; ip++) {
+    switch (ip->op) {
+    case OpConst:
+      p = emitLoad(p,c,height++,RSI,8*ip->operand);
+      break;
+    case OpVar:
+      p = emitLoad(p,c,height++,RDI,8*ip->operand);
+      break;
+    case OpTemp:
+      p = emitLoad(p,c,height++,RDX,8*ip->operand);
+      break;
+    case OpSave:
+      p = emitStore(p,c,height-1,8*ip->operand);
+      break;
+    case OpAdd:
+      p = emitOperation(p,c,ADDSD,--height);
+      break;
+    case OpSub:
+      p = emitOperation(p,c,SUBSD,--height);
+      break;
+    case OpMul:
+      p = emitOperation(p,c,MULSD,--height);
+      break;
+    case OpDiv:
+      p = emitOperation(p,c,DIVSD,--height);
+      break;
+    }
+  }
+  *p++ = 0xC3; /* ret: the result is in xmm0 */
+  return p;
+}
+
+#endif
+
+/* The function compileJit compiles the expression tr; the previous contents of j, which
+ * must have been initialized, are freed. The result is 1 when native code was made, and
+ * 0 when evalJit will run bytecode.
+ */
+
+int compileJit(ExpTree tr, JitCode *j) {
+  freeJit(j);
+  compileExpTree(tr,&(j->code));
+#ifdef JIT_X86_64
+  {
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    unsigned char *page;
+    j->size = ((size_t)j->code.length*27 + 1 + pageSize - 1) / pageSize * pageSize;
+    page = mmap(NULL,j->size,PROT_READ | PROT_WRITE,MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+    if (page == MAP_FAILED) {
+      j->size = 0;
+      return 0;
+    }
+    translate(&(j->code),page);
+    if (mprotect(page,j->size,PROT_READ | PROT_EXEC) != 0) {
+      munmap(page,j->size);
+      j->size = 0;
+      return 0;
+    }
+    j->page = page;
+    j->function = (JitFunction)(void *)page;
+    return 1;
+  }
+#else
+  return 0;
+#endif
+}
+
+/* The function evalJit computes the value of compiled code, where bindings[id] is the
+ * value of the identifier with that id; work has evalWorkSize(&(j->code)) doubles.
+ */
+
+double evalJit(const JitCode *j, const double *bindings, double *work) {
+  if (j->function != NULL) {
+    return j->function(bindings,j->code.constants,work);
+  }
+  return evalExpCode(&(j->code),bindings,work);
+}
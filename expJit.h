@@ -0,0 +1,32 @@
+/* expJit.h */
+
+#ifndef EXPJIT_H
+#define EXPJIT_H
+
+#include <stddef.h> /* size_t */
+
+#define JITREGISTERS 14 /* stack entries 0..13 are in xmm0..xmm13, the rest in memory */
+
+/* Native code for an expression. On x86-64 the bytecode (see expCode.h) is translated
+ * to machine code with SSE2 scalar instructions in an executable page; function is
+ * then that code, called with the bindings, the constants and scratch memory for the
+ * temporaries and the stack entries that are not in registers; the scratch memory is
+ * work memory of the caller, of evalWorkSize(&(j->code)) doubles, as for evalExpCode.
+ * Elsewhere page and function are NULL, and evalJit runs the bytecode instead.
+ */
+
+typedef double (*JitFunction)(const double *bindings, const double *constants, double *scratch);
+
+typedef struct JitCode {
+  ExpCode code;
+  unsigned char *page;
+  size_t size;
+  JitFunction function;
+} JitCode;
+
+void initJit(JitCode *j);
+int compileJit(ExpTree tr, JitCode *j);
+double evalJit(const JitCode *j, const double *bindings, double *work);
+void freeJit(JitCode *j);
+
+#endif
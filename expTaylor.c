@@ -0,0 +1,305 @@
+/* expTaylor.c
+ *
+ * In this file derivatives of an expression are computed numerically, without making
+ * the tree of the derivative (forward-mode automatic differentiation). Every value
+ * of the computation is replaced by its truncated Taylor series in the variable with
+ * the given id: the coefficients a[0..order] of a[0] + a[1]*h + ... + a[order]*h^order.
+ * The variable itself is x + h, i.e. a = (x, 1, 0, ...), and every other identifier and
+ * number is a constant (v, 0, 0, ...). The operations on series are
+ *
+ *   (a + b)[n] = a[n] + b[n]
+ *   (a * b)[n] = sum_{i=0..n} a[i]*b[n-i]
+ *   (a / b)[n] = (a[n] - sum_{i=1..n} b[i]*(a/b)[n-i]) / b[0]
+ *
+ * and the n-th derivative is n! times coefficient n. For order 1 these are dual
+ * numbers: the value and the first derivative.
+ * The bytecode of the expression (see expCode.h) is run once, with a series of
+ * order+1 coefficients for every stack entry and temporary. In the batch version every
+ * coefficient is a column of BATCHBLOCK points, as in expBatch.c.
+ */
+
+#include <stdlib.h> /* malloc, free */
+#include <string.h> /* memcpy, memset */
+#include <assert.h> /* assert */
+#include "scanner.h"
+#include "infixExp.h"
+#include "expCode.h"
+#include "expBatch.h"
+#include "expTaylor.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define KERNEL __attribute__((target_clones("avx2","default")))
+#else
+#define KERNEL
+#endif
+
+/* The function taylorWorkSize yields the number of doubles of work memory that
+ * taylorExpCode needs for series of the given order.
+ */
+
+int taylorWorkSize(const ExpCode *c, int order) {
+  return (c->temps + c->depth) * (order+1);
+}
+
+/* The function scaleToDerivatives multiplies coefficient n of a series by n!.
+ */
+
+void scaleToDerivatives(double *derivatives, int order) {
+  double factorial = 1;
+  int n;
+  for (n = 1; n <= order; n++) {
+    factorial *= n;
+    derivatives[n] *= factorial;
+  }
+}
+
+/* The function taylorExpCode computes the derivatives 0..order of compiled code to the
+ * identifier with the given id, where bindings[id] is the value of the identifier with
+ * that id; derivatives[n] becomes the n-th derivative. work must have room for
+ * taylorWorkSize(c,order) doubles.
+ */
+
+void taylorExpCode(const ExpCode *c, const double *bindings, int id, int order,
+                   double *derivatives, double *work) {
+  const Instruction *ip;
+  int size = order + 1;
+  double *temps = work;
+  double *sp = work + (size_t)c->temps*size; /* sp - size is the top */
+  double *a, *b, sum;
+  int n, i;
+  assert( order >= 0 && order <= MAXORDER );
+  for (ip = c->code; ip->op != OpEnd; ip++) {
+    switch (ip->op) {
+    case OpConst:
+      memset(sp,0,size*sizeof(double));
+      sp[0] = c->constants[ip->operand];
+      sp += size;
+      break;
+    case OpVar:
+      memset(sp,0,size*sizeof(double));
+      sp[0] = bindings[ip->operand];
+      if (ip->operand == id && order > 0) {
+        sp[1] = 1;
+      }
+      sp += size;
+      break;
+    case OpAdd:
+    case OpSub:
+      sp -= size;
+      a = sp - size;
+      for (n = 0; n < size; n++) {
+        a[n] = (ip->op == OpAdd ? a[n] + sp[n] : a[n] - sp[n]);
+      }
+      break;
+    case OpMul: /* from the highest coefficient down, so that a can be overwritten */
+      sp -= size;
+      a = sp - size;
+      b = sp;
+      for (n = order; n >= 0; n--) {
+        sum = 0;
+        for (i = 0; i <= n; i++) {
+          sum += a[i] * b[n-i];
+        }
+        a[n] = sum;
+      }
+      break;
+    case OpDiv: /* from the lowest coefficient up: a[0..n-1] already hold the quotient */
+      sp -= size;
+      a = sp - size;
+      b = sp;
+      for (n = 0; n < size; n++) {
+        sum = a[n];
+        for (i = 1; i <= n; i++) {
+          sum -= b[i] * a[n-i];
+        }
+        a[n] = sum / b[0];
+      }
+      break;
+    case OpSave:
+      memcpy(temps+(size_t)ip->operand*size,sp-size,size*sizeof(double));
+      break;
+    case OpTemp:
+      memcpy(sp,temps+(size_t)ip->operand*size,size*sizeof(double));
+      sp += size;
+      break;
+    }
+  }
+  memcpy(derivatives,sp-size,size*sizeof(double));
+  scaleToDerivatives(derivatives,order);
+}
+
+/* The function taylorExpTree computes the derivatives 0..order of an expression tree
+ * to the identifier with the given id, and dualExpTree its value and first derivative.
+ */
+
+void taylorExpTree(ExpTree tr, const double *bindings, int id, int order, double *derivatives) {
+  ExpCode c;
+  double *work;
+  initExpCode(&c);
+  compileExpTree(tr,&c);
+  work = malloc(taylorWorkSize(&c,order)*sizeof(double));
+  assert( work != NULL );
+  taylorExpCode(&c,bindings,id,order,derivatives,work);
+  free(work);
+  freeExpCode(&c);
+}
+
+void dualExpTree(ExpTree tr, const double *bindings, int id, double *value, double *derivative) {
+  double derivatives[2];
+  taylorExpTree(tr,bindings,id,1,derivatives);
+  *value = derivatives[0];
+  *derivative = derivatives[1];
+}
+
+/* The kernels on columns; like those of expBatch.c they handle all BATCHBLOCK values.
+ */
+
+KERNEL
+static void mulAddColumns(double *restrict y, const double *restrict a, const double *restrict b) {
+  int j;
+  for (j = 0; j < BATCHBLOCK; j++) {
+    y[j] += a[j] * b[j];
+  }
+}
+
+KERNEL
+static void mulSubColumns(double *restrict y, const double *restrict a, const double *restrict b) {
+  int j;
+  for (j = 0; j < BATCHBLOCK; j++) {
+    y[j] -= a[j] * b[j];
+  }
+}
+
+KERNEL
+static void addColumns(double *restrict y, const double *restrict x) {
+  int j;
+  for (j = 0; j < BATCHBLOCK; j++) {
+    y[j] += x[j];
+  }
+}
+
+KERNEL
+static void subColumns(double *restrict y, const double *restrict x) {
+  int j;
+  for (j = 0; j < BATCHBLOCK; j++) {
+    y[j] -= x[j];
+  }
+}
+
+KERNEL
+static void divColumns(double *restrict y, const double *restrict x) {
+  int j;
+  for (j = 0; j < BATCHBLOCK; j++) {
+    y[j] /= x[j];
+  }
+}
+
+/* The function taylorBlock is taylorExpCode for the points start..start+count-1, with
+ * columns instead of numbers; work has room for the series of the temporaries and the
+ * stack, and one more series (the product that is being computed).
+ */
+
+void taylorBlock(const ExpCode *c, const double *columns[], int id, int order, double *out,
+                 size_t n, size_t start, int count, double *work) {
+  const Instruction *ip;
+  size_t size = (size_t)(order+1)*BATCHBLOCK;
+  double *temps = work;
+  double *sp = work + c->temps*size;
+  double *product = work + (c->temps + c->depth)*size;
+  double *a, *b;
+  int k, i, j;
+  for (ip = c->code; ip->op != OpEnd; ip++) {
+    switch (ip->op) {
+    case OpConst:
+      memset(sp,0,size*sizeof(double));
+      for (j = 0; j < BATCHBLOCK; j++) {
+        sp[j] = c->constants[ip->operand];
+      }
+      sp += size;
+      break;
+    case OpVar:
+      memset(sp,0,size*sizeof(double));
+      memcpy(sp,columns[ip->operand]+start,count*sizeof(double));
+      if (ip->operand == id && order > 0) {
+        for (j = 0; j < BATCHBLOCK; j++) {
+          sp[BATCHBLOCK+j] = 1;
+        }
+      }
+      sp += size;
+      break;
+    case OpAdd:
+    case OpSub:
+      sp -= size;
+      for (k = 0; k <= order; k++) {
+        if (ip->op == OpAdd) {
+          addColumns(sp-size+k*BATCHBLOCK,sp+k*BATCHBLOCK);
+        } else {
+          subColumns(sp-size+k*BATCHBLOCK,sp+k*BATCHBLOCK);
+        }
+      }
+      break;
+    case OpMul:
+      sp -= size;
+      a = sp - size;
+      b = sp;
+      memset(product,0,size*sizeof(double));
+      for (k = 0; k <= order; k++) {
+        for (i = 0; i <= k; i++) {
+          mulAddColumns(product+k*BATCHBLOCK,a+i*BATCHBLOCK,b+(k-i)*BATCHBLOCK);
+        }
+      }
+      memcpy(a,product,size*sizeof(double));
+      break;
+    case OpDiv:
+      sp -= size;
+      a = sp - size;
+      b = sp;
+      for (k = 0; k <= order; k++) {
+        for (i = 1; i <= k; i++) {
+          mulSubColumns(a+k*BATCHBLOCK,b+i*BATCHBLOCK,a+(k-i)*BATCHBLOCK);
+        }
+        divColumns(a+k*BATCHBLOCK,b);
+      }
+      break;
+    case OpSave:
+      memcpy(temps+(size_t)ip->operand*size,sp-size,size*sizeof(double));
+      break;
+    case OpTemp:
+      memcpy(sp,temps+(size_t)ip->operand*size,size*sizeof(double));
+      sp += size;
+      break;
+    }
+  }
+  for (k = 0; k <= order; k++) {
+    double factorial = 1;
+    for (i = 2; i <= k; i++) {
+      factorial *= i;
+    }
+    for (j = 0; j < count; j++) {
+      out[k*n+start+j] = factorial * sp[-(long)size+k*BATCHBLOCK+j];
+    }
+  }
+}
+
+/* The function taylorBatch computes the derivatives 0..order of an expression tree to
+ * the identifier with the given id in n points: columns[id][i] is the value of the
+ * identifier with that id in point i, and out[k*n+i] becomes the k-th derivative in
+ * point i.
+ */
+
+void taylorBatch(ExpTree tr, const double *columns[], int id, int order, double *out, size_t n) {
+  ExpCode c;
+  double *work;
+  size_t start;
+  assert( order >= 0 && order <= MAXORDER );
+  initExpCode(&c);
+  compileExpTree(tr,&c);
+  work = malloc((size_t)(c.temps + c.depth + 1)*(order+1)*BATCHBLOCK*sizeof(double));
+  assert( work != NULL );
+  for (start = 0; start < n; start += BATCHBLOCK) {
+    taylorBlock(&c,columns,id,order,out,n,start,
+                (n - start < BATCHBLOCK ? (int)(n - start) : BATCHBLOCK),work);
+  }
+  free(work);
+  freeExpCode(&c);
+}
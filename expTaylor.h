@@ -0,0 +1,17 @@
+/* expTaylor.h */
+
+#ifndef EXPTAYLOR_H
+#define EXPTAYLOR_H
+
+#include <stddef.h> /* size_t */
+
+#define MAXORDER 32 /* highest derivative that can be computed */
+
+int taylorWorkSize(const ExpCode *c, int order);
+void taylorExpCode(const ExpCode *c, const double *bindings, int id, int order,
+                   double *derivatives, double *work);
+void taylorExpTree(ExpTree tr, const double *bindings, int id, int order, double *derivatives);
+void dualExpTree(ExpTree tr, const double *bindings, int id, double *value, double *derivative);
+void taylorBatch(ExpTree tr, const double *columns[], int id, int order, double *out, size_t n);
+
+#endif
@@ -0,0 +1,402 @@
+/* flatTree.c
+ *
+ * In this file expression DAGs are stored in the compact form of flatTree.h: one array
+ * of 12-byte nodes in post-order, with 32-bit indices instead of pointers. A bottom-up
+ * pass is a loop from the first node to the last, which reads the array in order; a
+ * top-down pass (such as finding the nodes that are used) is a loop in the other
+ * direction. foldFlatTree and differentiateFlatTree are such sweeps, and emit
+ * a new array.
+ * The conversions from and to ExpTree keep the sharing of the DAG: a shared node is
+ * one node of the array, and converting back gives the same (hash-consed) nodes.
+ */
+
+#include <stdlib.h> /* malloc, calloc, realloc, free, abort */
+#include <string.h> /* memcpy */
+#include <assert.h> /* assert */
+#include "scanner.h"
+#include "infixExp.h"
+#include "flatTree.h"
+
+/* The function initFlatTree makes an empty flat tree, and freeFlatTree frees its memory.
+ */
+
+void initFlatTree(FlatTree *ft) {
+  ft->nodes = NULL;
+  ft->size = 0;
+  ft->capacity = 0;
+  ft->constants = NULL;
+  ft->constantCount = 0;
+  ft->constantCapacity = 0;
+}
+
+void freeFlatTree(FlatTree *ft) {
+  free(ft->nodes);
+  free(ft->constants);
+  initFlatTree(ft);
+}
+
+/* The function appendFlatNode appends a node and yields its index; appendFlatConstant
+ * appends a number of type Number or Real.
+ */
+
+uint32_t appendFlatNode(FlatTree *ft, uint32_t tag, uint32_t left, uint32_t right) {
+  if (ft->size >= ft->capacity) {
+    ft->capacity = 2*ft->capacity + 16;
+    ft->nodes = realloc(ft->nodes,ft->capacity*sizeof(FlatNode));
+    assert( ft->nodes != NULL );
+  }
+  ft->nodes[ft->size].tag = tag;
+  ft->nodes[ft->size].left = left;
+  ft->nodes[ft->size].right = right;
+  return ft->size++;
+}
+
+uint32_t appendFlatConstant(FlatTree *ft, TokenType tt, FlatValue v) {
+  if (ft->constantCount >= ft->constantCapacity) {
+    ft->constantCapacity = 2*ft->constantCapacity + 16;
+    ft->constants = realloc(ft->constants,ft->constantCapacity*sizeof(FlatValue));
+    assert( ft->constants != NULL );
+  }
+  ft->constants[ft->constantCount] = v;
+  return appendFlatNode(ft,FLATTAG(tt,ft->constantCount++),0,0);
+}
+
+/* The functions isFlatConstant and flatConstant deal with number nodes.
+ */
+
+int isFlatConstant(const FlatTree *ft, uint32_t i) {
+  TokenType tt = FLATKIND(ft->nodes[i].tag);
+  return (tt == Number || tt == Real);
+}
+
+double flatConstant(const FlatTree *ft, uint32_t i) {
+  FlatValue v = ft->constants[FLATPAYLOAD(ft->nodes[i].tag)];
+  return (FLATKIND(ft->nodes[i].tag) == Number ? (double)v.number : v.real);
+}
+
+/* The function flatFromExpTree converts tr to the flat tree ft (which must have been
+ * initialized; its previous contents are overwritten). index[id] is the index of the
+ * node with that id.
+ */
+
+void flatFromExpTree(ExpTree tr, FlatTree *ft) {
+  ExpTree *nodes;
+  uint32_t *index = malloc((expTreeNodeCount()+1)*sizeof(uint32_t));
+  FlatValue v;
+  int count, k;
+  assert( index != NULL );
+  ft->size = 0;
+  ft->constantCount = 0;
+  nodes = postOrder(tr,&count);
+  for (k = 0; k < count; k++) {
+    tr = nodes[k];
+    switch (tr->tt) {
+    case Number:
+      v.number = (tr->t).number;
+      index[tr->id] = appendFlatConstant(ft,Number,v);
+      break;
+    case Real:
+      v.real = (tr->t).real;
+      index[tr->id] = appendFlatConstant(ft,Real,v);
+      break;
+    case Identifier:
+      index[tr->id] = appendFlatNode(ft,FLATTAG(Identifier,(tr->t).identifier.id),0,0);
+      break;
+    case Symbol:
+      index[tr->id] = appendFlatNode(ft,FLATTAG(Symbol,(unsigned char)(tr->t).symbol),
+                                     index[tr->left->id],index[tr->right->id]);
+      break;
+    }
+  }
+  free(nodes);
+  free(index);
+}
+
+/* The function flatToExpTree converts a flat tree back to an expression tree.
+ */
+
+ExpTree flatToExpTree(const FlatTree *ft) {
+  ExpTree *trees = malloc(ft->size*sizeof(ExpTree)), result;
+  const FlatNode *n;
+  Token t;
+  int k;
+  assert( ft->size > 0 && trees != NULL );
+  for (k = 0; k < ft->size; k++) {
+    n = &ft->nodes[k];
+    switch (FLATKIND(n->tag)) {
+    case Number:
+      t.number = ft->constants[FLATPAYLOAD(n->tag)].number;
+      trees[k] = newExpTreeNode(Number,t,NULL,NULL);
+      break;
+    case Real:
+      t.real = ft->constants[FLATPAYLOAD(n->tag)].real;
+      trees[k] = newExpTreeNode(Real,t,NULL,NULL);
+      break;
+    case Identifier:
+      t.identifier = identifierSlice(FLATPAYLOAD(n->tag));
+      trees[k] = newExpTreeNode(Identifier,t,NULL,NULL);
+      break;
+    case Symbol:
+      t.symbol = (char)FLATPAYLOAD(n->tag);
+      trees[k] = newExpTreeNode(Symbol,t,trees[n->left],trees[n->right]);
+      break;
+    }
+  }
+  result = trees[ft->size-1];
+  free(trees);
+  return result;
+}
+
+/* The function valueFlatTree computes the value of a flat tree, where bindings[id] is
+ * the value of the identifier with that id. values must have room for ft->size values.
+ * Division by 0 gives an infinity or NaN.
+ */
+
+double valueFlatTree(const FlatTree *ft, const double *bindings, double *values) {
+  const FlatNode *n;
+  int k;
+  for (k = 0; k < ft->size; k++) {
+    n = &ft->nodes[k];
+    switch (FLATKIND(n->tag)) {
+    case Number:
+    case Real:
+      values[k] = flatConstant(ft,k);
+      break;
+    case Identifier:
+      values[k] = bindings[FLATPAYLOAD(n->tag)];
+      break;
+    case Symbol:
+      switch (FLATPAYLOAD(n->tag)) {
+      case '+':
+        values[k] = values[n->left] + values[n->right];
+        break;
+      case '-':
+        values[k] = values[n->left] - values[n->right];
+        break;
+      case '*':
+        values[k] = values[n->left] * values[n->right];
+        break;
+      case '/':
+        values[k] = values[n->left] / values[n->right];
+        break;
+      default:
+        abort();
+      }
+      break;
+    }
+  }
+  return values[ft->size-1];
+}
+
+/* The function compactFlatTree keeps only the nodes of ft that are used by the node root,
+ * which becomes the last node, and their constants: one sweep down marks the nodes
+ * that are used, and one sweep up moves them to the front (an index only gets smaller,
+ * so this is done in place; the constants are in the order of their nodes).
+ */
+
+void compactFlatTree(FlatTree *ft, uint32_t root) {
+  char *used = calloc(ft->size,1);
+  uint32_t *index = malloc(ft->size*sizeof(uint32_t));
+  FlatNode n;
+  int k, size = 0;
+  assert( used != NULL && index != NULL );
+  used[root] = 1;
+  for (k = root; k >= 0; k--) {
+    if (used[k] && FLATKIND(ft->nodes[k].tag) == Symbol) {
+      used[ft->nodes[k].left] = 1;
+      used[ft->nodes[k].right] = 1;
+    }
+  }
+  ft->constantCount = 0;
+  for (k = 0; k <= (int)root; k++) {
+    if (used[k]) {
+      n = ft->nodes[k];
+      if (FLATKIND(n.tag) == Symbol) {
+        n.left = index[n.left];
+        n.right = index[n.right];
+      } else if (FLATKIND(n.tag) != Identifier) {
+        ft->constants[ft->constantCount] = ft->constants[FLATPAYLOAD(n.tag)];
+        n.tag = FLATTAG(FLATKIND(n.tag),ft->constantCount++);
+      }
+      index[k] = size;
+      ft->nodes[size++] = n;
+    }
+  }
+  ft->size = size;
+  free(used);
+  free(index);
+}
+
+/* The function copyFlatTree makes result a copy of ft.
+ */
+
+void copyFlatTree(const FlatTree *ft, FlatTree *result) {
+  result->size = 0;
+  result->constantCount = 0;
+  if (result->capacity < ft->size) {
+    result->capacity = ft->size;
+    result->nodes = realloc(result->nodes,result->capacity*sizeof(FlatNode));
+    assert( result->nodes != NULL );
+  }
+  if (result->constantCapacity < ft->constantCount) {
+    result->constantCapacity = ft->constantCount;
+    result->constants = realloc(result->constants,result->constantCapacity*sizeof(FlatValue));
+    assert( result->constants != NULL );
+  }
+  memcpy(result->nodes,ft->nodes,ft->size*sizeof(FlatNode));
+  memcpy(result->constants,ft->constants,ft->constantCount*sizeof(FlatValue));
+  result->size = ft->size;
+  result->constantCount = ft->constantCount;
+}
+
+/* The function foldFlatConstants appends the result of an operation on the constants
+ * l and r to result, and yields its index. Numbers give a Number when the result fits.
+ */
+
+uint32_t foldFlatConstants(FlatTree *result, char symbol, uint32_t l, uint32_t r) {
+  FlatValue v;
+  double a = flatConstant(result,l), b = flatConstant(result,r);
+  if (FLATKIND(result->nodes[l].tag) == Number && FLATKIND(result->nodes[r].tag) == Number) {
+    int64_t x = result->constants[FLATPAYLOAD(result->nodes[l].tag)].number;
+    int64_t y = result->constants[FLATPAYLOAD(result->nodes[r].tag)].number;
+    if ((symbol == '+' && !__builtin_add_overflow(x,y,&v.number))
+        || (symbol == '-' && !__builtin_sub_overflow(x,y,&v.number))
+        || (symbol == '*' && !__builtin_mul_overflow(x,y,&v.number))) {
+      return appendFlatConstant(result,Number,v);
+    }
+  }
+  switch (symbol) {
+  case '+':
+    v.real = a + b;
+    break;
+  case '-':
+    v.real = a - b;
+    break;
+  case '*':
+    v.real = a * b;
+    break;
+  default:
+    v.real = a / b;
+  }
+  return appendFlatConstant(result,Real,v);
+}
+
+/* The function foldFlatTree folds ft to result, in one sweep over the nodes that are
+ * used, by computing operations on two constants (except a division by 0) and by the
+ * rules
+ *
+ *   0*E and E*0 are simplified to 0;
+ *   0+E, E+0, E-0, 1*E, E*1 and E/1 are simplified to E.
+ *
+ * index[k] is the index in result of the folded node k. This is less than simplify:
+ * like terms and like factors are not combined and polynomials are not brought to
+ * normal form; for that, convert to an expression tree and use simplify (see rewrite.c
+ * and sparsePoly.c).
+ */
+
+void foldFlatTree(const FlatTree *ft, FlatTree *result) {
+  uint32_t *index = malloc(ft->size*sizeof(uint32_t));
+  uint32_t l, r, i;
+  FlatNode n;
+  int k, lz, rz, lo, ro;
+  assert( ft->size > 0 && index != NULL );
+  copyFlatTree(ft,result);
+  for (k = 0; k < ft->size; k++) {
+    n = ft->nodes[k];
+    if (FLATKIND(n.tag) != Symbol) {
+      index[k] = k;
+      continue;
+    }
+    l = index[n.left];
+    r = index[n.right];
+    i = UINT32_MAX;
+    if (isFlatConstant(result,l) && isFlatConstant(result,r)
+        && (FLATPAYLOAD(n.tag) != '/' || flatConstant(result,r) != 0)) {
+      i = foldFlatConstants(result,(char)FLATPAYLOAD(n.tag),l,r);
+    } else {
+      lz = isFlatConstant(result,l) && flatConstant(result,l) == 0;
+      rz = isFlatConstant(result,r) && flatConstant(result,r) == 0;
+      lo = isFlatConstant(result,l) && flatConstant(result,l) == 1;
+      ro = isFlatConstant(result,r) && flatConstant(result,r) == 1;
+      switch (FLATPAYLOAD(n.tag)) {
+      case '*':
+        i = (lz ? l : rz ? r : lo ? r : ro ? l : UINT32_MAX);
+        break;
+      case '/':
+        i = (ro ? l : UINT32_MAX);
+        break;
+      case '+':
+        i = (lz ? r : rz ? l : UINT32_MAX);
+        break;
+      case '-':
+        i = (rz ? l : UINT32_MAX);
+        break;
+      }
+    }
+    if (i == UINT32_MAX) {
+      i = (l == n.left && r == n.right ? (uint32_t)k : appendFlatNode(result,n.tag,l,r));
+    }
+    index[k] = i;
+  }
+  compactFlatTree(result,index[ft->size-1]);
+  free(index);
+}
+
+/* The function differentiateFlatTree makes result the derivative of ft to the
+ * identifier with the given id. The nodes of ft are copied to result, and then the
+ * derivatives of the nodes are appended in one sweep, by the rules of differentiate
+ * (see infixExp.c); d[k] is the index of the derivative of node k. The nodes that
+ * the derivative does not use are removed at the end.
+ */
+
+void differentiateFlatTree(const FlatTree *ft, int id, FlatTree *result) {
+  uint32_t *d = malloc(ft->size*sizeof(uint32_t));
+  uint32_t zero, one, a, b, l, r;
+  FlatValue v;
+  FlatNode n;
+  int k;
+  assert( ft->size > 0 && d != NULL );
+  copyFlatTree(ft,result);
+  v.number = 0;
+  zero = appendFlatConstant(result,Number,v);
+  v.number = 1;
+  one = appendFlatConstant(result,Number,v);
+  for (k = 0; k < ft->size; k++) {
+    n = ft->nodes[k];
+    switch (FLATKIND(n.tag)) {
+    case Number:
+    case Real:
+      d[k] = zero;
+      break;
+    case Identifier:
+      d[k] = ((int)FLATPAYLOAD(n.tag) == id ? one : zero);
+      break;
+    case Symbol:
+      l = n.left;
+      r = n.right;
+      switch (FLATPAYLOAD(n.tag)) {
+      case '+':
+      case '-':
+        d[k] = appendFlatNode(result,n.tag,d[l],d[r]);
+        break;
+      case '*':
+        a = appendFlatNode(result,FLATTAG(Symbol,'*'),d[l],r);
+        b = appendFlatNode(result,FLATTAG(Symbol,'*'),l,d[r]);
+        d[k] = appendFlatNode(result,FLATTAG(Symbol,'+'),a,b);
+        break;
+      case '/':
+        a = appendFlatNode(result,FLATTAG(Symbol,'*'),d[l],r);
+        b = appendFlatNode(result,FLATTAG(Symbol,'*'),l,d[r]);
+        a = appendFlatNode(result,FLATTAG(Symbol,'-'),a,b);
+        b = appendFlatNode(result,FLATTAG(Symbol,'*'),r,r);
+        d[k] = appendFlatNode(result,FLATTAG(Symbol,'/'),a,b);
+        break;
+      default:
+        abort();
+      }
+      break;
+    }
+  }
+  compactFlatTree(result,d[ft->size-1]);
+  free(d);
+}
@@ -0,0 +1,47 @@
+/* flatTree.h */
+
+#ifndef FLATTREE_H
+#define FLATTREE_H
+
+#include <stdint.h> /* uint32_t, int64_t */
+
+/* The compact form of an expression DAG: its nodes in post-order in one array, so that
+ * the children of a node come before it and the root is the last node. A node packs its
+ * token type in the low 2 bits of tag, and above them its payload: the symbol of an
+ * operator, the id of an identifier, or the index of a number in constants. left and
+ * right are the indices of the children of an operator.
+ */
+
+#define FLATKIND(tag) ((TokenType)((tag) & 3))
+#define FLATPAYLOAD(tag) ((uint32_t)(tag) >> 2)
+#define FLATTAG(kind, payload) ((uint32_t)(kind) | ((uint32_t)(payload) << 2))
+
+typedef struct FlatNode {
+  uint32_t tag;
+  uint32_t left;
+  uint32_t right;
+} FlatNode;
+
+typedef union FlatValue {
+  int64_t number;
+  double real;
+} FlatValue;
+
+typedef struct FlatTree {
+  FlatNode *nodes;
+  int size;
+  int capacity;
+  FlatValue *constants;
+  int constantCount;
+  int constantCapacity;
+} FlatTree;
+
+void initFlatTree(FlatTree *ft);
+void freeFlatTree(FlatTree *ft);
+void flatFromExpTree(ExpTree tr, FlatTree *ft);
+ExpTree flatToExpTree(const FlatTree *ft);
+double valueFlatTree(const FlatTree *ft, const double *bindings, double *values);
+void foldFlatTree(const FlatTree *ft, FlatTree *result);
+void differentiateFlatTree(const FlatTree *ft, int id, FlatTree *result);
+
+#endif
@@ -13,32 +13,156 @@
  * Starting point is the token list obtained from the scanner (in scanner.c).
  */
 
-#include <stdio.h>  /* printf */
-#include <stdlib.h> /* malloc, free */
+#include <inttypes.h> /* uint64_t */
+#include <stdlib.h> /* calloc, free, abort */
+#include <unistd.h> /* STDOUT_FILENO */
 #include <assert.h> /* assert */
+#include "arena.h"
 #include "scanner.h"
 #include "recognizeExp.h"
 #include "infixExp.h"
-#include <string.h>
+#include "rewrite.h"
+#include "sparsePoly.h"
+#include "stats.h"
+#include <string.h> /* memcpy, memcmp, memset */
+
+/* The nodes of expression trees are not allocated one by one, but in the arena
+ * treeArena: this includes the nodes made by simplify and differentiate.
+ * They are all freed at once by resetExpTrees.
+ * The node table is a hash table with linear probing of all nodes in the arena;
+ * nodeCount is the number of nodes, and the number of buckets is a power of 2.
+ */
+
+static Arena treeArena;
+static ExpTree *nodeBuckets = NULL;
+static int nodeBucketCount = 0;
+static int nodeCount = 0;
+
+/* The function hashNode computes the hash of a node from its token and the ids of
+ * its children: only the member of the token that belongs to tt is used.
+ */
+
+unsigned hashNode(TokenType tt, Token t, ExpTree tL, ExpTree tR) {
+  uint64_t payload;
+  unsigned h;
+  switch (tt) {
+  case Number:
+    payload = (uint64_t)t.number;
+    break;
+  case Real:
+    memcpy(&payload, &t.real, sizeof(payload));
+    break;
+  case Identifier:
+    payload = (uint64_t)t.identifier.id;
+    break;
+  default:
+    payload = (unsigned char)t.symbol;
+  }
+  payload ^= (uint64_t)tt << 56;
+  payload = payload * 0x9E3779B97F4A7C15u + (uint64_t)(tL == NULL ? 0 : tL->id + 1);
+  payload = payload * 0x9E3779B97F4A7C15u + (uint64_t)(tR == NULL ? 0 : tR->id + 1);
+  h = (unsigned)(payload >> 32) ^ (unsigned)payload;
+  return h;
+}
+
+/* The function sameNode checks whether node has the given token and children.
+ */
+
+int sameNode(ExpTree node, TokenType tt, Token t, ExpTree tL, ExpTree tR) {
+  if (node->tt != tt || node->left != tL || node->right != tR) {
+    return 0;
+  }
+  switch (tt) {
+  case Number:
+    return (node->t.number == t.number);
+  case Real:
+    return (memcmp(&(node->t.real), &t.real, sizeof(double)) == 0);
+  case Identifier:
+    return (node->t.identifier.id == t.identifier.id);
+  default:
+    return (node->t.symbol == t.symbol);
+  }
+}
 
-/* The function newExpTreeNode creates a new node for an expression tree.
+/* The function growNodeBuckets doubles the number of buckets of the node table.
+ */
+
+void growNodeBuckets() {
+  int count = (nodeBucketCount == 0 ? NODE_BUCKETS : 2*nodeBucketCount);
+  ExpTree *buckets = calloc(count, sizeof(ExpTree));
+  int k, b;
+  assert( buckets != NULL );
+  for (k = 0; k < nodeBucketCount; k++) {
+    if (nodeBuckets[k] != NULL) {
+      b = nodeBuckets[k]->hash & (count-1);
+      while (buckets[b] != NULL) {
+        b = (b+1) & (count-1);
+      }
+      buckets[b] = nodeBuckets[k];
+    }
+  }
+  free(nodeBuckets);
+  nodeBuckets = buckets;
+  nodeBucketCount = count;
+}
+
+/* The function newExpTreeNode yields the node for an expression tree with the given
+ * token and children. When such a node already exists, that node is returned
+ * (hash-consing); only otherwise a new node is made.
  */
 
 ExpTree newExpTreeNode(TokenType tt, Token t, ExpTree tL, ExpTree tR) {
-  ExpTree new = malloc(sizeof(ExpTreeNode));
-  assert (new!=NULL);
+  unsigned h = hashNode(tt, t, tL, tR);
+  ExpTree new;
+  int b;
+  if (2*(nodeCount+1) > nodeBucketCount) { /* keep the load factor at most 1/2 */
+    growNodeBuckets();
+  }
+  b = h & (nodeBucketCount-1);
+  while (nodeBuckets[b] != NULL) {
+    if (nodeBuckets[b]->hash == h && sameNode(nodeBuckets[b], tt, t, tL, tR)) {
+      STATS_COUNT(CountNodesShared, 1);
+      return nodeBuckets[b];
+    }
+    b = (b+1) & (nodeBucketCount-1);
+  }
+  new = arenaAlloc(&treeArena, sizeof(ExpTreeNode));
+  STATS_COUNT(CountNodes, 1);
+  STATS_COUNT(CountNodeBytes, sizeof(ExpTreeNode));
   new->tt = tt;
   new->t = t;
   new->left = tL;
   new->right = tR;
+  new->id = nodeCount++;
+  new->hash = h;
+  nodeBuckets[b] = new;
   return new;
 }
 
+/* The function resetExpTrees frees all expression trees in one step.
+ */
+
+void resetExpTrees() {
+  if (nodeCount > 0) {
+    memset(nodeBuckets, 0, nodeBucketCount*sizeof(ExpTree));
+  }
+  nodeCount = 0;
+  resetArena(&treeArena);
+}
+
+/* The function expTreeNodeCount yields the number of nodes made since the last
+ * resetExpTrees; the ids of these nodes are below this number.
+ */
+
+int expTreeNodeCount() {
+  return nodeCount;
+}
+
 /* The function valueIdentifier recognizes an identifier in a token list and
  * makes the second parameter point to it.
  */
 
-int valueIdentifier(List *lp, char **sp) {
+int valueIdentifier(List *lp, Slice *sp) {
   // printf("valueIdentifier check : Char = %c , List = ", *sp[0]);
   // printList(*lp);
   if (*lp != NULL && (*lp)->tt == Identifier ) {
@@ -51,8 +175,8 @@ int valueIdentifier(List *lp, char **sp) {
 
 // acceptNumber, except that this function writes the value to wp.
 int valueNumber(List *lp, double *wp) {
-    if (*lp != NULL && (*lp)->tt == Number ) {
-        *wp = ((*lp)->t).number;
+    if (*lp != NULL && ((*lp)->tt == Number || (*lp)->tt == Real)) {
+        *wp = numberValue((*lp)->tt, (*lp)->t);
         *lp = (*lp)->next;
         return 1;
     }
@@ -90,148 +214,214 @@ int acceptAdditionSubstraction(List *lp, char *cp){
   return 0;  
 }
 
-/* De function freeExpTree frees the memory of the nodes in the expression tree.
- * Observe that here, unlike in freeList, the strings in indentifier nodes
- * are not freed. The reason is that the function newExpTree does not allocate
- * memory for strings in nodes, but only a pointer to a string in a node
- * in the token list.
+/* The function expressionNode tries to build a tree from the tokens at the start of the
+ * token list (its first argument) and makes its second argument point to the tree.
+ * The return value indicates whether the action is successful; the list is advanced
+ * over the recognized expression. expressionNodeFlat does the same for a cursor in a
+ * token array; both are expressionNodeSource on a token source (see scanner.h).
+ * The grammar is
+ *
+ * <expression>  ::= <term> { '+'  <term> | '-' <term> }
+ *
+ * <term>       ::= <factor> { '*' <factor> | '/' <factor> }
+ *
+ * <factor>     ::= <number> | <identifier> | '(' <expression> ')'
+ *
+ * and the operators are left associative. It is recognized by precedence climbing in
+ * one pass, without recursion: the operands and the pending operators (with '(' for an
+ * open parenthesis) are kept on the stacks of a ParseStack. Before an operator is
+ * pushed, the pending operators with at least its precedence (see the table
+ * precedence) are applied to the operands on top of the stack; so are those above
+ * '(' at a ')', and all of them at the end. Hence the length of an expression and the
+ * depth of its parentheses are only bounded by memory.
+ * The expression is the longest initial segment that can be recognized: an operator that
+ * is not followed by a factor is not part of it, and neither are parentheses that are
+ * not closed, with the operator before them. The parser remembers the last place where
+ * the tokens so far form an expression (after an operand, outside all parentheses),
+ * with the sizes of the stacks there; when it stops anywhere else, the stacks are cut
+ * back to those sizes and the list is left at that place.
  */
 
-void freeExpTree(ExpTree tr) {
-  if (tr==NULL) {
-    return;
+static const signed char precedence[128] = { ['+'] = 1, ['-'] = 1, ['*'] = 2, ['/'] = 2 };
+
+/* The function isBinaryOperator checks whether the current token of a source is an
+ * operator of the table precedence.
+ */
+
+int isBinaryOperator(const TokenSource *s) {
+  char c;
+  if (sourceAtEnd(s) || sourceType(s) != Symbol) {
+    return 0;
   }
-  freeExpTree(tr->left);
-  freeExpTree(tr->right);
-  free(tr);
+  c = sourceToken(s)->symbol;
+  return c > 0 && precedence[(int)c] > 0;
 }
 
-/* The function treeExpression tries to build a tree from the tokens in the token list 
- * (its first argument) and makes its second argument point to the tree.
- * The return value indicates whether the action is successful.
- * Observe that we use ordinary recursion, not mutual recursion.
+/* The function pushOperand pushes a tree on the operand stack, and pushOperator an
+ * operator on the operator stack.
  */
 
-/*  
- * <expression>  ::= <term> { '+'  <term> | '-' <term> }
- * 
- * <term>       ::= <factor> { '*' <factor> | '/' <factor> }
- *
- * <factor>     ::= <number> | <identifier> | '(' <expression> ')'
-*/
-
-int factorNode(List *lp, ExpTree *tree){
-    if((*lp) == NULL ) return 0;
-    switch((*lp)->tt) {
-      case Number:
-        *tree = newExpTreeNode(Number, (*lp)->t, NULL, NULL);
-        (*lp) = (*lp)->next;
-        return 1;
-      case Identifier:
-        *tree = newExpTreeNode(Identifier, (*lp)->t, NULL, NULL);
-        *lp = (*lp)->next;
-        return 1;
-      case Symbol:
-        if ((*lp)->t.symbol == '(') {
-          if (acceptCharacter(lp, '(') && expressionNode(lp, tree, 0) && acceptCharacter(lp, ')'));
-            return 1;
-        }
-        return 0;
-    }
+void pushOperand(ParseStack *ps, ExpTree tr) {
+  if (ps->operandCount >= ps->operandCapacity) {
+    ps->operandCapacity = 2*ps->operandCapacity + 16;
+    ps->operands = realloc(ps->operands,ps->operandCapacity*sizeof(ExpTree));
+    assert( ps->operands != NULL );
+  }
+  ps->operands[ps->operandCount++] = tr;
+}
 
-  return 0;
+void pushOperator(ParseStack *ps, char c) {
+  if (ps->operatorCount >= ps->operatorCapacity) {
+    ps->operatorCapacity = 2*ps->operatorCapacity + 16;
+    ps->operators = realloc(ps->operators,ps->operatorCapacity);
+    assert( ps->operators != NULL );
+  }
+  ps->operators[ps->operatorCount++] = c;
 }
 
-// accept factor, accept *or/, accept factor
-int termNode(List *lp, ExpTree *tree, int count){
+/* The function applyOperators applies the pending operators with at least precedence
+ * level to the operands, up to the first '(' (which has precedence 0).
+ */
+
+void applyOperators(ParseStack *ps, int level) {
   ExpTree leftTree, rightTree;
-  char operator;
   Token newToken;
-
-  if(count == -1){
-    leftTree = *tree;
-    count = 1;
+  while (ps->operatorCount > 0 && ps->operators[ps->operatorCount-1] != '('
+         && precedence[(int)ps->operators[ps->operatorCount-1]] >= level) {
+    newToken.symbol = ps->operators[--ps->operatorCount];
+    rightTree = ps->operands[--ps->operandCount];
+    leftTree = ps->operands[ps->operandCount-1];
+    ps->operands[ps->operandCount-1] = newExpTreeNode(Symbol,newToken,leftTree,rightTree);
   }
+}
 
-  if(count == 0) {
-    if (!factorNode(lp, &leftTree)) return 0;
-    //  add new node to tree
-    *tree = leftTree;
+int expressionNodeSource(TokenSource *s, ExpTree *tree) {
+  ParseStack ps = { NULL, 0, 0, NULL, 0, 0 };
+  TokenSource afterOperand = *s;
+  TokenType tt;
+  char c;
+  int open = 0, valid = 0, operands = 0, operators = 0;
+  STATS_START(start);
+  for (;;) {
+    /* a factor is expected: open parentheses and then a number or identifier */
+    while (sourceSymbol(s,'(')) {
+      pushOperator(&ps,'(');
+      open++;
+      sourceNext(s);
+    }
+    if (sourceAtEnd(s)) {
+      break;
+    }
+    tt = sourceType(s);
+    if (tt != Number && tt != Real && tt != Identifier) {
+      break;
+    }
+    pushOperand(&ps,newExpTreeNode(tt,*sourceToken(s),NULL,NULL));
+    sourceNext(s);
+    /* closing parentheses and an operator may follow */
+    while (open > 0 && sourceSymbol(s,')')) {
+      applyOperators(&ps,0);
+      ps.operatorCount--; /* the '(' */
+      open--;
+      sourceNext(s);
+    }
+    if (open == 0) { /* the tokens so far form an expression */
+      valid = 1;
+      afterOperand = *s;
+    }
+    if (!isBinaryOperator(s)) {
+      break;
+    }
+    c = sourceToken(s)->symbol;
+    applyOperators(&ps,precedence[(int)c]);
+    if (open == 0) { /* the same expression, with some operators applied */
+      operands = ps.operandCount;
+      operators = ps.operatorCount;
+    }
+    pushOperator(&ps,c);
+    sourceNext(s);
   }
-
-  if(acceptDivisionMultiplication(lp, &operator)) {
-    if(factorNode(lp, &rightTree)){
-      newToken.symbol = operator;
-      *tree = newExpTreeNode(Symbol,newToken,*tree,rightTree);
-//    check if next operator is /or*, if it is; call termNode(with counter++, and tree)
-      if(*lp != NULL && isDivMultOperator((*lp)->t.symbol)){
-        // printList(*lp);
-        termNode(lp, tree, -1);
-      }
-    } else {
-      return (count>0);
+  if (valid) {
+    if (s->list != afterOperand.list || s->pos != afterOperand.pos || open > 0) {
+      ps.operandCount = operands; /* go back to the last expression */
+      ps.operatorCount = operators;
     }
+    applyOperators(&ps,0);
+    *tree = ps.operands[0];
   }
-  
-// add node to tree
-  return 1;
+  *s = afterOperand; /* the start, when there is no expression */
+  free(ps.operands);
+  free(ps.operators);
+  STATS_STOP(PhaseParse, start);
+  return valid;
 }
 
-// accept term, accept *or/, accept factor
-int expressionNode(List *lp, ExpTree *tree, int count){
-  ExpTree leftTree, rightTree;
-  char operator;
-  Token newToken;
+int expressionNode(List *lp, ExpTree *tree) {
+  TokenSource s = listSource(*lp);
+  int valid = expressionNodeSource(&s,tree);
+  *lp = s.list;
+  return valid;
+}
 
-  if(count == -1){
-    // This means that the given tree is the left portion of the new tree.
-    leftTree = *tree;
-    count = 1;
+int expressionNodeFlat(TokenCursor *cp, ExpTree *tree) {
+  TokenSource s = cursorSource(*cp);
+  int valid = expressionNodeSource(&s,tree);
+  if (s.pos != NULL) {
+    cp->pos = s.pos;
   }
-  
-  if(count == 0) {
-    if (!termNode(lp, &leftTree, 0)) return 0;
-    //  add new node to tree
-    *tree = leftTree;
-  }
-  if(acceptAdditionSubstraction(lp, &operator)) {
-    if(termNode(lp, &rightTree, 0)){
-      newToken.symbol = operator;
-      *tree = newExpTreeNode(Symbol,newToken,*tree,rightTree);
-//    check if next operator is +or-, if it is; call termNode(with counter++, and tree)
-      if(*lp != NULL && isPlusMinOperator((*lp)->t.symbol)){
-        expressionNode(lp, tree, -1);
-      }
-    } else {
-      return (count>0);
-    }
-  }
-// add node to tree
-  return 1;
+  return valid;
 }
 
-/* The function printExpTreeInfix does what its name suggests.
+/* The function printExpTreeInfix writes an expression tree in infix notation to the
+ * sink s. It walks the tree with a TreeStack: state 0 is before the node, 1 is between its children, 2 after them.
  */
 
-void printExpTreeInfix(ExpTree tr) {
+void printExpTreeInfix(Sink *out, ExpTree tr) {
+  TreeStack s;
+  TreeFrame *f;
   if (tr == NULL) {
     return;
   }
-  switch (tr->tt) {
-  case Number: 
-    printf("%d",(tr->t).number);
-   break;
-  case Identifier: 
-    printf("%s",(tr->t).identifier);
-    break;
-  case Symbol: 
-    printf("(");
-    printExpTreeInfix(tr->left);
-    printf(" %c ",(tr->t).symbol);
-    printExpTreeInfix(tr->right);
-    printf(")");
-    break;
+  STATS_START(start);
+  initTreeStack(&s);
+  pushTree(&s, tr, 0);
+  while (s.size > 0) {
+    f = &s.frames[s.size-1];
+    tr = f->tree;
+    switch (tr->tt) {
+    case Number: 
+      sinkInt(out,(tr->t).number);
+      s.size--;
+      break;
+    case Real: 
+      sinkGeneral(out,(tr->t).real);
+      s.size--;
+      break;
+    case Identifier: 
+      sinkBytes(out,(tr->t).identifier.start,(tr->t).identifier.length);
+      s.size--;
+      break;
+    case Symbol: 
+      switch (f->state++) {
+      case 0:
+        sinkChar(out,'(');
+        pushTree(&s, tr->left, 0);
+        break;
+      case 1:
+        sinkChar(out,' ');
+        sinkChar(out,(tr->t).symbol);
+        sinkChar(out,' ');
+        pushTree(&s, tr->right, 0);
+        break;
+      default:
+        sinkChar(out,')');
+        s.size--;
+      }
+      break;
+    }
   }
+  freeTreeStack(&s);
+  STATS_STOP(PhasePrint, start);
 }
 
 /* The function isNumerical checks for an expression tree whether it represents 
@@ -239,43 +429,61 @@ void printExpTreeInfix(ExpTree tr) {
  */
 
 int isNumerical(ExpTree tr) {
+  ExpTree *nodes;
+  int count, k, numerical = 1;
   if (tr == NULL){
     return 0;
   }
-  if (tr->tt==Number) {
-    return 1;
-  }
-  if (tr->tt==Identifier) {
-    return 0;
+  nodes = postOrder(tr, &count);
+  for (k = 0; k < count && numerical; k++) {
+    numerical = (nodes[k]->tt != Identifier);
   }
-  return (isNumerical(tr->left) && isNumerical(tr->right));
+  free(nodes);
+  return numerical;
 }
 
 /* The function valueExpTree computes the value of an expression tree that represents a
- * numerical expression.
+ * numerical expression: the value of every node, in post-order, is kept in values.
  */
 
 double valueExpTree(ExpTree tr) {  /* precondition: isNumerical(tr)) */
-  double lval, rval;
+  ExpTree *nodes;
+  double *values, lval, rval, result;
+  int count, k;
   assert(tr!=NULL);
-  if (tr->tt==Number) {
-    return (tr->t).number;
-  }
-  lval = valueExpTree(tr->left);
-  rval = valueExpTree(tr->right);
-  switch ((tr->t).symbol) {
-  case '+':
-    return (lval + rval);
-  case '-':
-    return (lval - rval);
-  case '*':
-    return (lval * rval);
-  case '/':
-    assert( rval!=0 );
-    return (lval / rval);
-  default:
-    abort();
+  nodes = postOrder(tr, &count);
+  values = malloc((nodeCount+1)*sizeof(double));
+  assert( values != NULL );
+  for (k = 0; k < count; k++) {
+    tr = nodes[k];
+    if (tr->tt==Number || tr->tt==Real) {
+      values[tr->id] = numberValue(tr->tt, tr->t);
+      continue;
+    }
+    lval = values[tr->left->id];
+    rval = values[tr->right->id];
+    switch ((tr->t).symbol) {
+    case '+':
+      values[tr->id] = (lval + rval);
+      break;
+    case '-':
+      values[tr->id] = (lval - rval);
+      break;
+    case '*':
+      values[tr->id] = (lval * rval);
+      break;
+    case '/':
+      assert( rval!=0 );
+      values[tr->id] = (lval / rval);
+      break;
+    default:
+      abort();
+    }
   }
+  result = values[nodes[count-1]->id];
+  free(values);
+  free(nodes);
+  return result;
 }
 
 // We assume that this function will only be called if it is certain that either A or B is equal to checkValue
@@ -283,124 +491,189 @@ int giveCorrectValue(int inputA, int inputB, int checkValue){
   return (inputA == checkValue) ? inputB : inputA;
 }
 
-// This function makes a copy of the given Expression Tree
-ExpTree copyExpTree(ExpTree tree){
-  if (tree->left == NULL && tree->right == NULL)
-    return tree;
-  return newExpTreeNode(tree->tt, tree->t, copyExpTree(tree->left), copyExpTree(tree->right));
+/* The function newMemo yields a table with an entry (initially NULL) for every node made
+ * so far. Since the children of a node are made before the node itself, it can hold
+ * a result for every node of a tree that exists, so that simplify and differentiate
+ * handle a shared node only once.
+ */
+
+ExpTree *newMemo() {
+  ExpTree *memo = arenaAlloc(&treeArena, (nodeCount+1)*sizeof(ExpTree));
+  memset(memo, 0, (nodeCount+1)*sizeof(ExpTree));
+  return memo;
 }
 
-/* The function Simplify prepares the Expression Tree according to the rules:
-   0∗E and E∗0 are simplified to 0;
-   0+E, E+0, E−0, 1∗E, E∗1 and E/1 are simplified to E.   */
-ExpTree simplify(ExpTree tree){
-  // Should go through the entire tree recursively, applying the rules if possible.
-  // Start at the bottom of the tree (again);
-  ExpTree newLeft = tree->left;
-  ExpTree newRight = tree->right;
-
-  if ((*tree).left != NULL && (*tree).right != NULL){
-    // Not at the bottom yet. Go down recursively.
-    newRight = simplify(tree->right);
-    newLeft = simplify(tree->left);
-  } else {
-    // Currently at the bottom Node in the tree.
-    return tree;
+/* The functions initTreeStack, pushTree and freeTreeStack make, grow and free a stack
+ * of nodes; popping is decrementing its size.
+ */
+
+void initTreeStack(TreeStack *s) {
+  s->frames = NULL;
+  s->size = 0;
+  s->capacity = 0;
+}
+
+void pushTree(TreeStack *s, ExpTree tr, int state) {
+  if (s->size >= s->capacity) {
+    s->capacity = 2*s->capacity + 16;
+    s->frames = realloc(s->frames, s->capacity*sizeof(TreeFrame));
+    assert( s->frames != NULL );
   }
+  s->frames[s->size].tree = tr;
+  s->frames[s->size].state = state;
+  s->size++;
+}
 
-  if ((*tree).tt == Symbol){
-    Token t;
-    switch ((*tree).t.symbol){
-      case '*':
-//        printf("Left = %d , right = %d\n", (tree->left)->t.number, (tree->right)->t.number);
-        if ((tree->right)->t.number == 0 || (tree->left)->t.number == 0){
-          t.number = 0;
-          return newExpTreeNode(Number, t, NULL, NULL);
-        } else if ((tree->left)->t.number == 1){
-          return newExpTreeNode((tree->right)->tt, (tree->right)->t, NULL, NULL);
-        } else if ((tree->right)->t.number == 1){
-          return newExpTreeNode((tree->left)->tt, (tree->left)->t, NULL, NULL);
-        }
-        break;
-      
-      case '/':
-        if ((tree->right)->t.number == 1){
-          return newExpTreeNode((tree->left)->tt, (tree->left)->t, NULL, NULL);
-        }
-        break;
-      
-      case '+':
-        if ((tree->left)->t.number == 0){
-          return newExpTreeNode((tree->right)->tt, (tree->right)->t, NULL, NULL);
-        } else if ((tree->right)->t.number == 0){
-          return newExpTreeNode((tree->left)->tt, (tree->left)->t, NULL, NULL);
-        }
-        break;
-      
-      case '-':
-        if (((*tree).right)->t.number == 0){
-          return newExpTreeNode((tree->left)->tt, (tree->left)->t, NULL, NULL);
-        }
-        break;
-      
-      default:
-        abort();
+void freeTreeStack(TreeStack *s) {
+  free(s->frames);
+  initTreeStack(s);
+}
+
+/* The function postOrder yields the nodes of the DAG tr, each once, children before
+ * parents (so tr is the last of them), and sets *count to their number. The array is
+ * allocated with malloc. A bottom-up pass over a tree is a loop over this array, with
+ * the results for the nodes in a table indexed by id; so no pass needs recursion,
+ * whatever the depth of the tree.
+ * The walk uses a TreeStack, with state 1 for a node whose children have been pushed.
+ */
+
+ExpTree *postOrder(ExpTree tr, int *count) {
+  TreeStack s;
+  TreeFrame *f;
+  char *seen = calloc(nodeCount+1, 1);
+  ExpTree *nodes = NULL;
+  int capacity = 0;
+  assert( seen != NULL );
+  *count = 0;
+  initTreeStack(&s);
+  pushTree(&s, tr, 0);
+  while (s.size > 0) {
+    f = &s.frames[s.size-1];
+    tr = f->tree;
+    if (f->state == 1) {
+      s.size--;
+      if (*count >= capacity) {
+        capacity = 2*capacity + 16;
+        nodes = realloc(nodes, capacity*sizeof(ExpTree));
+        assert( nodes != NULL );
+      }
+      nodes[(*count)++] = tr;
+    } else if (seen[tr->id]) {
+      s.size--;
+    } else {
+      seen[tr->id] = 1;
+      f->state = 1;
+      if (tr->tt == Symbol) {
+        pushTree(&s, tr->right, 0);
+        pushTree(&s, tr->left, 0);
+      }
     }
   }
-  return newExpTreeNode(tree->tt, tree->t, newLeft, newRight);
+  freeTreeStack(&s);
+  free(seen);
+  return nodes;
 }
 
-ExpTree differentiate(ExpTree tree) {
-  char x[2] = "x";
+/* The function simplify rewrites an expression tree to its normal form (see rewrite.c):
+ * constants are computed, and like terms and like factors are combined. After that,
+ * the parts that are polynomials are written in expanded normal form where that does
+ * not make them larger (see simplifyPolynomials); expand expands them always.
+ */
+ExpTree simplify(ExpTree tree){
+  ExpTree result;
+  STATS_COUNT(CountSimplified, 1);
+  STATS_COUNT(CountSizeBefore, statsTreeSize(tree));
+  STATS_START(start);
+  result = simplifyPolynomials(rewriteExpTree(tree));
+  STATS_STOP(PhaseSimplify, start);
+  STATS_COUNT(CountSizeAfter, statsTreeSize(result));
+  return result;
+}
+
+ExpTree expand(ExpTree tree) {
+  return expandPolynomials(rewriteExpTree(tree));
+}
+
+/* The function differentiate yields the derivative to x of an expression tree.
+ * A polynomial is differentiated in sparse form (see sparsePoly.c); otherwise the
+ * rules below are applied to the tree by derivative, bottom-up over the nodes in
+ * post-order: memo[id] becomes the derivative of the node with that id. E1 and E2 are
+ * not copied: the derivative shares them with the tree.
+ */
+
+ExpTree derivative(ExpTree tree, ExpTree *memo, int x) {
   ExpTree newLeft, newRight, newLeftParent, newRightParent;
-  newLeft = newRight = newLeftParent = newRightParent = NULL;
-  ExpTree E1, E2;
+  ExpTree E1, E2, *nodes;
   Token t, mulToken, divToken;
+  int count, k;
   mulToken.symbol = '*';
   divToken.symbol = '/';
 
-  switch (tree->tt) {
-    case Symbol:
-      switch ((tree->t).symbol) {
-
-        case '/':
-//       ( d(E1) * E2  -  E1 * d(E2) ) / E2*E2
-          E1 = copyExpTree(tree->left);
-          E2 = copyExpTree(tree->right);
-          t.symbol = '-';
-
-          newLeft = newExpTreeNode(Symbol, mulToken, differentiate(tree->left), E2);
-          newRight = newExpTreeNode(Symbol, mulToken, E1, differentiate(tree->right));
-          newLeftParent = newExpTreeNode(Symbol, t, newLeft, newRight);
-          newRightParent = newExpTreeNode(Symbol, mulToken, E2, E2);
-          return newExpTreeNode(Symbol, divToken, newLeftParent, newRightParent);
-        case '*':
-//        d(E1) * E2  +  E1 * d(E2)
-          E1 = copyExpTree(tree->left);
-          E2 = copyExpTree(tree->right);
-          t.symbol = '+';
-          newLeft = newExpTreeNode(Symbol, mulToken, differentiate(tree->left), E2);
-          newRight = newExpTreeNode(Symbol, mulToken, E1, differentiate(tree->right));
-          return newExpTreeNode(Symbol, t, newLeft, newRight);
-        case '-':
-//      If this does not work use differentiate(copyOf)
-          return newExpTreeNode(Symbol, tree->t, differentiate(tree->left), differentiate(tree->right));
-        case '+':
-          return newExpTreeNode(Symbol, tree->t, differentiate(tree->left), differentiate(tree->right));
-        default:
-          abort();
-      }
-    case Number:
-      t.number = 0;
-      return newExpTreeNode(Number, t, NULL, NULL);
-    case Identifier:
-      t.number = (strcmp(tree->t.identifier, x) == 0) ? 1 : 0;
-      return newExpTreeNode(Number, t, NULL, NULL);
-
+  nodes = postOrder(tree, &count);
+  for (k = 0; k < count; k++) {
+    tree = nodes[k];
+    switch (tree->tt) {
+      case Symbol:
+        E1 = tree->left;
+        E2 = tree->right;
+        switch ((tree->t).symbol) {
+
+          case '/':
+//         ( d(E1) * E2  -  E1 * d(E2) ) / E2*E2
+            t.symbol = '-';
+            newLeft = newExpTreeNode(Symbol, mulToken, memo[E1->id], E2);
+            newRight = newExpTreeNode(Symbol, mulToken, E1, memo[E2->id]);
+            newLeftParent = newExpTreeNode(Symbol, t, newLeft, newRight);
+            newRightParent = newExpTreeNode(Symbol, mulToken, E2, E2);
+            memo[tree->id] = newExpTreeNode(Symbol, divToken, newLeftParent, newRightParent);
+            break;
+          case '*':
+//          d(E1) * E2  +  E1 * d(E2)
+            t.symbol = '+';
+            newLeft = newExpTreeNode(Symbol, mulToken, memo[E1->id], E2);
+            newRight = newExpTreeNode(Symbol, mulToken, E1, memo[E2->id]);
+            memo[tree->id] = newExpTreeNode(Symbol, t, newLeft, newRight);
+            break;
+          case '-':
+          case '+':
+            memo[tree->id] = newExpTreeNode(Symbol, tree->t, memo[E1->id], memo[E2->id]);
+            break;
+          default:
+            abort();
+        }
+        break;
+      case Number:
+      case Real:
+        t.number = 0;
+        memo[tree->id] = newExpTreeNode(Number, t, NULL, NULL);
+        break;
+      case Identifier:
+        t.number = (tree->t.identifier.id == x);
+        memo[tree->id] = newExpTreeNode(Number, t, NULL, NULL);
+        break;
+    }
+  }
+  free(nodes);
+  return memo[tree->id];
+}
 
-// Probably will never reach this sadly
-      free(x);
+ExpTree differentiate(ExpTree tree) {
+  SparsePoly p, dp;
+  ExpTree result;
+  STATS_START(start);
+  initSparsePoly(&p);
+  if (!sparsePolyFromExpTree(tree, &p)) {
+    result = derivative(tree, newMemo(), identifierId("x"));
+    STATS_STOP(PhaseDifferentiate, start);
+    return result;
   }
+  initSparsePoly(&dp);
+  differentiateSparsePoly(&p, identifierId("x"), &dp);
+  result = sparsePolyToExpTree(&dp);
+  freeSparsePoly(&p);
+  freeSparsePoly(&dp);
+  STATS_STOP(PhaseDifferentiate, start);
+  return result;
 }
 
 
@@ -410,45 +683,50 @@ ExpTree differentiate(ExpTree tree) {
  */ 
 
 void prefExpTrees() {
-  char *ar;
+  LineView line;
   List tl, tl1;  
   ExpTree t = NULL;
-  printf("give an expression: ");
-  ar = readInput();
-  while (ar[0] != '!') {
-    tl = tokenList(ar); 
-    printList(tl);
+  Sink out;
+  initSink(&out, STDOUT_FILENO);
+  sinkText(&out, "give an expression: ");
+  flushPrompt(&out);
+  while (readInput(&line) && line.start[0] != '!') {
+    tl = tokenList(line); 
+    printList(&out, tl);
     tl1 = tl;
-    int valid = expressionNode(&tl1, &t, 0);
+    int valid = expressionNode(&tl1, &t);
     if ( valid > 0 && tl1 == NULL ) { 
          /* there should be no tokens left */
       if (valid == 2){
-        printf("\nNot numerical!\n");
+        sinkText(&out, "\nNot numerical!\n");
         t = NULL;
       }
-      printf("in infix notation: ");
-      printExpTreeInfix(t);
+      sinkText(&out, "in infix notation: ");
+      printExpTreeInfix(&out, t);
       if ( isNumerical(t) ) {
-        printf("the value is %g\n",valueExpTree(t));
+        sinkText(&out, "the value is ");
+        sinkGeneral(&out, valueExpTree(t));
+        sinkChar(&out, '\n');
       } else {
-        printf("this is not a numerical expression\n");
+        sinkText(&out, "this is not a numerical expression\n");
         t = simplify(t);
-        printf("simplified: ");
-        printExpTreeInfix(t);
-        printf("\nderivative to x: ");
+        sinkText(&out, "simplified: ");
+        printExpTreeInfix(&out, t);
+        sinkText(&out, "\nderivative to x: ");
 
-        printExpTreeInfix(simplify(differentiate(t)));
+        printExpTreeInfix(&out, simplify(differentiate(t)));
       }
     } else {
-      printf("this is not an expression\n"); 
+      sinkText(&out, "this is not an expression\n"); 
+      STATS_COUNT(CountRejected, 1);
     }
-    freeExpTree(t);
+    resetExpTrees();
     t = NULL; 
-    freeTokenList(tl);  
-    free(ar);
-    printf("\ngive an expression: ");
-    ar = readInput();
+    resetTokens();
+    sinkText(&out, "\ngive an expression: ");
+    flushPrompt(&out);
   }
-  free(ar);
-  printf("good bye\n");
+  sinkText(&out, "good bye\n");
+  flushSink(&out);
+  freeSink(&out);
 }
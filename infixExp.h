@@ -4,6 +4,9 @@
 #define PREFIXEXP_H
 
 /* Here the definition of the type tree of binary trees with nodes containing tokens.
+ * Nodes are hash-consed (see newExpTreeNode): equal subexpressions are one shared node,
+ * so an expression tree is in fact a directed acyclic graph. The nodes made for one
+ * input line are numbered 0, 1, 2, ... in id; hash is used by the node table.
  */
 
 typedef struct ExpTreeNode *ExpTree;
@@ -13,22 +16,67 @@ typedef struct ExpTreeNode {
   Token t;
   ExpTree left;
   ExpTree right;
+  int id;
+  unsigned hash;
 } ExpTreeNode;
 
+#define NODE_BUCKETS 256 /* initial number of buckets of the node table */
+
+/* A stack of nodes for the traversals without recursion (see postOrder): state tells
+ * how far the traversal of a node has come, or carries a value of the traversal.
+ */
+
+typedef struct TreeFrame {
+  ExpTree tree;
+  int state;
+} TreeFrame;
+
+typedef struct TreeStack {
+  TreeFrame *frames;
+  int size;
+  int capacity;
+} TreeStack;
+
+/* The stacks of the parser expressionNode: the trees of the operands, and the operators
+ * that still have to be applied to them, with '(' for an open parenthesis.
+ */
+
+typedef struct ParseStack {
+  ExpTree *operands;
+  int operandCount;
+  int operandCapacity;
+  char *operators;
+  int operatorCount;
+  int operatorCapacity;
+} ParseStack;
+
 ExpTree newExpTreeNode(TokenType tt, Token t, ExpTree tL, ExpTree tR);
-int valueIdentifier(List *lp, char **sp);
+void resetExpTrees();
+int expTreeNodeCount();
+ExpTree *newMemo();
+void initTreeStack(TreeStack *s);
+void pushTree(TreeStack *s, ExpTree tr, int state);
+void freeTreeStack(TreeStack *s);
+ExpTree *postOrder(ExpTree tr, int *count);
+ExpTree differentiate(ExpTree tree);
+int valueIdentifier(List *lp, Slice *sp);
 int valueNumber(List *lp, double *wp);
 int isDivMultOperator(char c);
 int acceptDivisionMultiplication(List *lp, char *cp);
 int isPlusMinOperator(char c);
 int acceptAdditionSubstraction(List *lp, char *cp);
-int factorNode(List *lp, ExpTree *tree);
-int termNode(List *lp, ExpTree *tree, int count);
-int expressionNode(List *lp, ExpTree *tree, int count);
+int isBinaryOperator(const TokenSource *s);
+void pushOperand(ParseStack *ps, ExpTree tr);
+void pushOperator(ParseStack *ps, char c);
+void applyOperators(ParseStack *ps, int level);
+int expressionNodeSource(TokenSource *s, ExpTree *tree);
+int expressionNode(List *lp, ExpTree *tree);
+int expressionNodeFlat(TokenCursor *cp, ExpTree *tree);
 ExpTree simplify(ExpTree tree);
+ExpTree expand(ExpTree tree);
 int isNumerical(ExpTree tr);
 double valueExpTree(ExpTree tr);
-void printExpTreeInfix(ExpTree tr);
+void printExpTreeInfix(Sink *out, ExpTree tr);
 void prefExpTrees();
 
 #endif
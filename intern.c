@@ -0,0 +1,123 @@
+/* intern.c
+ *
+ * In this file an intern table is defined: a hash table that maps names (the
+ * characters of identifiers) to dense integer ids. Two identifiers are equal
+ * precisely when their ids are equal, so after interning no string comparisons
+ * are needed anymore.
+ */
+
+#include <stdlib.h> /* malloc, calloc, realloc, free */
+#include <string.h> /* memcmp, memcpy */
+#include <assert.h> /* assert */
+#include "arena.h"
+#include "intern.h"
+
+/* The function initInternTable makes an empty intern table.
+ */
+
+void initInternTable(InternTable *it) {
+  it->buckets = NULL;
+  it->bucketCount = 0;
+  it->names = NULL;
+  it->lengths = NULL;
+  it->hashes = NULL;
+  it->size = 0;
+  it->capacity = 0;
+  initArena(&(it->arena));
+}
+
+/* The function hashName computes the FNV-1a hash of a name.
+ */
+
+unsigned hashName(const char *start, int length) {
+  unsigned h = 2166136261u;
+  int i;
+  for (i = 0; i < length; i++) {
+    h = (h ^ (unsigned char)start[i]) * 16777619u;
+  }
+  return h;
+}
+
+/* The function growBuckets doubles the number of buckets and puts the ids back,
+ * using the stored hashes so that no name is hashed twice.
+ */
+
+void growBuckets(InternTable *it) {
+  int count = (it->bucketCount == 0 ? INTERN_BUCKETS : 2*it->bucketCount);
+  int id, b;
+  free(it->buckets);
+  it->buckets = calloc(count,sizeof(int));
+  assert( it->buckets != NULL );
+  it->bucketCount = count;
+  for (id = 0; id < it->size; id++) {
+    b = it->hashes[id] & (count-1);
+    while (it->buckets[b] != 0) {
+      b = (b+1) & (count-1);
+    }
+    it->buckets[b] = id+1;
+  }
+}
+
+/* The function intern yields the id of the name with the given start and length.
+ * When the name is new, it is copied into the table and gets the next free id.
+ */
+
+int intern(InternTable *it, const char *start, int length) {
+  unsigned h = hashName(start,length);
+  int b, id;
+  if (2*(it->size+1) > it->bucketCount) { /* keep the load factor at most 1/2 */
+    growBuckets(it);
+  }
+  b = h & (it->bucketCount-1);
+  while (it->buckets[b] != 0) {
+    id = it->buckets[b]-1;
+    if (it->hashes[id] == h && it->lengths[id] == length
+        && memcmp(it->names[id],start,length) == 0) {
+      return id;
+    }
+    b = (b+1) & (it->bucketCount-1);
+  }
+  /* the name is new */
+  if (it->size >= it->capacity) {
+    it->capacity = (it->capacity == 0 ? INTERN_BUCKETS : 2*it->capacity);
+    it->names = realloc(it->names,it->capacity*sizeof(char *));
+    it->lengths = realloc(it->lengths,it->capacity*sizeof(int));
+    it->hashes = realloc(it->hashes,it->capacity*sizeof(unsigned));
+    assert( it->names != NULL && it->lengths != NULL && it->hashes != NULL );
+  }
+  id = it->size;
+  it->names[id] = arenaAlloc(&(it->arena),length+1);
+  memcpy(it->names[id],start,length);
+  it->names[id][length] = '\0';
+  it->lengths[id] = length;
+  it->hashes[id] = h;
+  it->size++;
+  it->buckets[b] = id+1;
+  return id;
+}
+
+/* The functions internedName and internedLength yield the name with the given id
+ * and its length.
+ */
+
+char *internedName(InternTable *it, int id) {
+  assert( 0 <= id && id < it->size );
+  return it->names[id];
+}
+
+int internedLength(InternTable *it, int id) {
+  assert( 0 <= id && id < it->size );
+  return it->lengths[id];
+}
+
+/* The function freeInternTable frees all memory of the table.
+ */
+
+void freeInternTable(InternTable *it) {
+  free(it->buckets);
+  free(it->names);
+  free(it->lengths);
+  free(it->hashes);
+  releaseArena(&(it->arena));
+  initInternTable(it);
+}
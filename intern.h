@@ -0,0 +1,34 @@
+/* intern.h */
+
+#ifndef INTERN_H
+#define INTERN_H
+
+#include "arena.h"
+
+#define INTERN_BUCKETS 64 /* initial number of buckets, a power of 2 */
+
+/* An intern table gives every distinct name a dense integer id: 0, 1, 2, ...
+ * The names are stored once, in the arena of the table, followed by a '\0'.
+ * The buckets form a hash table with linear probing; a bucket contains id+1,
+ * or 0 when it is empty.
+ * A table that is filled with zeros (e.g. a static one) is empty and ready for use.
+ */
+
+typedef struct InternTable {
+  int *buckets;
+  int bucketCount;
+  char **names;
+  int *lengths;
+  unsigned *hashes;
+  int size;       /* number of names */
+  int capacity;   /* length of the arrays names, lengths and hashes */
+  Arena arena;
+} InternTable;
+
+void initInternTable(InternTable *it);
+int intern(InternTable *it, const char *start, int length);
+char *internedName(InternTable *it, int id);
+int internedLength(InternTable *it, int id);
+void freeInternTable(InternTable *it);
+
+#endif
@@ -0,0 +1,232 @@
+/* lineReader.c
+ *
+ * In this file a line reader is defined that reads its input in large blocks
+ * instead of character by character, and yields the lines as views into its buffer,
+ * so that no line is copied. Lines can have any length: the buffer grows when a line
+ * does not fit. For a regular file the reader can also map the whole file in memory.
+ */
+
+#include <stdlib.h>   /* malloc, realloc, free */
+#include <string.h>   /* memchr, memmove, memcpy */
+#include <assert.h>   /* assert */
+#include <errno.h>    /* errno, EINTR */
+#include <unistd.h>   /* read */
+#include <sys/stat.h> /* fstat, S_ISREG */
+#include <sys/mman.h> /* mmap, munmap, madvise */
+#include "lineReader.h"
+
+/* The function openLineReader makes a reader that reads the file descriptor fd in blocks.
+ */
+
+void openLineReader(LineReader *lr, int fd) {
+  lr->fd = fd;
+  lr->capacity = 2*READBLOCK;
+  lr->buffer = malloc(lr->capacity);
+  assert( lr->buffer != NULL );
+  lr->pos = 0;
+  lr->end = 0;
+  lr->scanned = 0;
+  lr->eof = 0;
+  lr->error = 0;
+  lr->map = NULL;
+  lr->mapSize = 0;
+}
+
+/* The function mapLineReader makes a reader that maps the file fd in memory.
+ * This is only possible for a non-empty regular file; otherwise the result is 0 and
+ * the reader reads in blocks, as with openLineReader.
+ */
+
+int mapLineReader(LineReader *lr, int fd) {
+  struct stat st;
+  void *map;
+  openLineReader(lr,fd);
+  if (fstat(fd,&st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+    return 0;
+  }
+  map = mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+  if (map == MAP_FAILED) {
+    return 0;
+  }
+  madvise(map,st.st_size,MADV_SEQUENTIAL);
+  lr->map = map;
+  lr->mapSize = st.st_size;
+  return 1;
+}
+
+/* The function fillBuffer reads the next block after the unread part of the buffer.
+ * The unread part is first moved to the front; when the buffer is full, its capacity is
+ * doubled. One byte is always kept free, for the '\0' after the last line. A read error
+ * ends the input as well, but its errno is kept in error, for the caller to report.
+ */
+
+void fillBuffer(LineReader *lr) {
+  ssize_t n;
+  if (lr->pos > 0) {
+    memmove(lr->buffer,lr->buffer+lr->pos,lr->end-lr->pos);
+    lr->end -= lr->pos;
+    lr->scanned -= lr->pos;
+    lr->pos = 0;
+  }
+  if (lr->capacity - lr->end < READBLOCK/2) {
+    lr->capacity = 2*lr->capacity;
+    lr->buffer = realloc(lr->buffer,lr->capacity);
+    assert( lr->buffer != NULL );
+  }
+  do {
+    n = read(lr->fd,lr->buffer+lr->end,lr->capacity-lr->end-1);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0) {
+    lr->error = errno;
+  }
+  if (n <= 0) {
+    lr->eof = 1;
+  } else {
+    lr->end += n;
+  }
+}
+
+/* The function makeView fills line with the characters from start to end (exclusive)
+ * and removes a '\r' before the line end.
+ */
+
+void makeView(LineView *line, char *start, char *end) {
+  if (end > start && end[-1] == '\r') {
+    end--;
+  }
+  line->start = start;
+  line->length = end - start;
+}
+
+/* The function readMappedLine is readLine for a mapped file. The last line of a file
+ * that does not end with '\n' is copied into the buffer, because the mapping may
+ * end directly after it.
+ */
+
+int readMappedLine(LineReader *lr, LineView *line) {
+  char *start = lr->map + lr->pos;
+  char *nl;
+  size_t rest = lr->mapSize - lr->pos;
+  if (rest == 0) {
+    return 0;
+  }
+  nl = memchr(start,'\n',rest);
+  if (nl != NULL) {
+    makeView(line,start,nl);
+    lr->pos += nl - start + 1;
+    return 1;
+  }
+  if (rest >= lr->capacity) {
+    lr->capacity = rest+1;
+    lr->buffer = realloc(lr->buffer,lr->capacity);
+    assert( lr->buffer != NULL );
+  }
+  memcpy(lr->buffer,start,rest);
+  lr->buffer[rest] = '\0';
+  makeView(line,lr->buffer,lr->buffer+rest);
+  lr->pos = lr->mapSize;
+  return 1;
+}
+
+/* The function readLine makes line a view of the next line of the input.
+ * The result is 0 at the end of the input, and 1 otherwise. A last line without
+ * line end is also yielded.
+ */
+
+int readLine(LineReader *lr, LineView *line) {
+  char *nl;
+  if (lr->map != NULL) {
+    return readMappedLine(lr,line);
+  }
+  for (;;) {
+    nl = memchr(lr->buffer+lr->scanned,'\n',lr->end-lr->scanned);
+    if (nl != NULL) {
+      *nl = '\0';
+      makeView(line,lr->buffer+lr->pos,nl);
+      line->start[line->length] = '\0';
+      lr->pos = nl - lr->buffer + 1;
+      lr->scanned = lr->pos;
+      return 1;
+    }
+    lr->scanned = lr->end;
+    if (lr->eof) {
+      if (lr->pos == lr->end) {
+        return 0;
+      }
+      lr->buffer[lr->end] = '\0';
+      makeView(line,lr->buffer+lr->pos,lr->buffer+lr->end);
+      line->start[line->length] = '\0';
+      lr->pos = lr->end;
+      lr->scanned = lr->end;
+      return 1;
+    }
+    fillBuffer(lr);
+  }
+}
+
+/* The function readLines makes block a view of the next whole lines of the input, with
+ * their line ends: at least min bytes, unless the input ends before, or a line is
+ * longer. A last line without line end is part of the last block. The result is 0 at
+ * the end of the input, and 1 otherwise. For a mapped file the view points into the
+ * mapping and stays valid until closeLineReader; otherwise it points into the buffer
+ * and is valid until the next call.
+ */
+
+int readLines(LineReader *lr, size_t min, LineView *block) {
+  char *start, *nl;
+  size_t cut;
+  if (lr->map != NULL) {
+    if (lr->pos == lr->mapSize) {
+      return 0;
+    }
+    start = lr->map + lr->pos;
+    cut = (lr->mapSize - lr->pos > min ? min : lr->mapSize - lr->pos);
+    nl = memchr(start+cut-1,'\n',lr->mapSize-lr->pos-cut+1);
+    cut = (nl == NULL ? lr->mapSize - lr->pos : (size_t)(nl - start) + 1);
+    block->start = start;
+    block->length = cut;
+    lr->pos += cut;
+    return 1;
+  }
+  while (lr->end - lr->pos < min && !lr->eof) {
+    fillBuffer(lr);
+  }
+  for (;;) {
+    nl = lr->buffer + lr->end;
+    while (nl > lr->buffer + lr->scanned && nl[-1] != '\n') {
+      nl--;
+    }
+    if (nl > lr->buffer + lr->scanned) {
+      break;
+    }
+    lr->scanned = lr->end;
+    if (lr->eof) {
+      break;
+    }
+    fillBuffer(lr); /* a line that is longer than the buffer */
+  }
+  if (lr->eof && lr->pos == lr->end) {
+    return 0;
+  }
+  if (lr->eof) {
+    nl = lr->buffer + lr->end;
+  }
+  block->start = lr->buffer + lr->pos;
+  block->length = nl - block->start;
+  lr->pos = nl - lr->buffer;
+  lr->scanned = lr->pos;
+  return 1;
+}
+
+/* The function closeLineReader frees the buffer and the mapping of the reader.
+ * The file descriptor is not closed.
+ */
+
+void closeLineReader(LineReader *lr) {
+  if (lr->map != NULL) {
+    munmap(lr->map,lr->mapSize);
+    lr->map = NULL;
+  }
+  free(lr->buffer);
+  lr->buffer = NULL;
+}
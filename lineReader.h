@@ -0,0 +1,44 @@
+/* lineReader.h */
+
+#ifndef LINEREADER_H
+#define LINEREADER_H
+
+#include <stddef.h> /* size_t */
+
+#define READBLOCK 65536 /* number of bytes that is read at once */
+
+/* A line view is a line of the input without its line end ("\n" or "\r\n").
+ * It points into the buffer of the reader and is valid until the next call of readLine.
+ * The character after the line is never a letter or a digit, so the scanner
+ * stops there; for a reader made by openLineReader it is '\0'.
+ */
+
+typedef struct LineView {
+  char *start;
+  size_t length;
+} LineView;
+
+/* A line reader reads a file descriptor in blocks of READBLOCK bytes (or has the whole
+ * file mapped in memory). The unread part of the buffer is buffer[pos..end).
+ */
+
+typedef struct LineReader {
+  int fd;
+  char *buffer;
+  size_t capacity;
+  size_t pos;
+  size_t end;
+  size_t scanned;  /* buffer[pos..scanned) is known to contain no '\n' */
+  int eof;
+  int error;       /* the errno of a failed read, or 0 */
+  char *map;       /* the mapped file, or NULL */
+  size_t mapSize;
+} LineReader;
+
+void openLineReader(LineReader *lr, int fd);
+int mapLineReader(LineReader *lr, int fd);
+int readLine(LineReader *lr, LineView *line);
+int readLines(LineReader *lr, size_t min, LineView *block);
+void closeLineReader(LineReader *lr);
+
+#endif
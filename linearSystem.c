@@ -0,0 +1,452 @@
+/* linearSystem.c
+ *
+ * In this file systems of linear equations over several variables are solved.
+ * The coefficients are collected per variable (by the id of the identifier) into a
+ * dense matrix, stored row by row. A square system is solved with an LU factorization
+ * with partial pivoting. The factorization is blocked: a panel of LUBLOCK columns is
+ * factorized first, and then the rest of the matrix is updated with all rows of the
+ * panel at once, so that every row of the matrix is loaded once per panel instead of
+ * once per column. The update kernels work on contiguous rows, so that the compiler
+ * vectorizes them; on x86-64 an AVX2/FMA version is chosen at runtime.
+ * On one core of the machine it was measured on (bench/linearSystem.c) a system of 1000
+ * unknowns takes about 0.06 s and one of 2000 about 0.35 s, but one of 3000 takes about
+ * 1.2 s (15 GFLOP/s): well under a second holds up to about 2500 unknowns. Copying the
+ * panel to contiguous memory and computing the rows of U in column blocks did not help;
+ * most of the time is in the update kernel, at about 24 GFLOP/s.
+ * A singular or non-square system is reduced to row echelon form instead, which gives
+ * the rank and tells whether there are no or infinitely many solutions.
+ */
+
+#include <stdlib.h> /* malloc, realloc, calloc, free */
+#include <string.h> /* memcpy */
+#include <math.h>   /* fabs */
+#include <float.h>  /* DBL_EPSILON */
+#include <assert.h> /* assert */
+#include "scanner.h"
+#include "recognizeExp.h"
+#include "linearSystem.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define KERNEL __attribute__((target_clones("fma","default")))
+#else
+#define KERNEL
+#endif
+
+/* The function initLinearSystem makes an empty system, clearLinearSystem empties a system
+ * (keeping its memory), and freeLinearSystem frees its memory.
+ */
+
+void initLinearSystem(LinearSystem *s) {
+  s->rows = 0;
+  s->cols = 0;
+  s->entryRow = NULL;
+  s->entryCol = NULL;
+  s->entryValue = NULL;
+  s->entries = 0;
+  s->entriesCapacity = 0;
+  s->rhs = NULL;
+  s->rhsCapacity = 0;
+  s->columnOf = NULL;
+  s->columnOfCapacity = 0;
+  s->variables = NULL;
+  s->variablesCapacity = 0;
+  s->solution = NULL;
+  s->rank = 0;
+}
+
+void clearLinearSystem(LinearSystem *s) {
+  int c;
+  for (c = 0; c < s->cols; c++) {
+    s->columnOf[s->variables[c]] = -1;
+  }
+  s->rows = 0;
+  s->cols = 0;
+  s->entries = 0;
+  s->rank = 0;
+}
+
+void freeLinearSystem(LinearSystem *s) {
+  free(s->entryRow);
+  free(s->entryCol);
+  free(s->entryValue);
+  free(s->rhs);
+  free(s->columnOf);
+  free(s->variables);
+  free(s->solution);
+  initLinearSystem(s);
+}
+
+/* The function column yields the column of the variable with the given id, and gives
+ * it a new column when it does not have one yet.
+ */
+
+int column(LinearSystem *s, int id) {
+  int k;
+  if (id >= s->columnOfCapacity) {
+    k = s->columnOfCapacity;
+    s->columnOfCapacity = 2*id + 16;
+    s->columnOf = realloc(s->columnOf,s->columnOfCapacity*sizeof(int));
+    assert( s->columnOf != NULL );
+    for (; k < s->columnOfCapacity; k++) {
+      s->columnOf[k] = -1;
+    }
+  }
+  if (s->columnOf[id] < 0) {
+    if (s->cols >= s->variablesCapacity) {
+      s->variablesCapacity = 2*s->variablesCapacity + 16;
+      s->variables = realloc(s->variables,s->variablesCapacity*sizeof(int));
+      assert( s->variables != NULL );
+    }
+    s->variables[s->cols] = id;
+    s->columnOf[id] = s->cols;
+    s->cols++;
+  }
+  return s->columnOf[id];
+}
+
+/* The function addLinearEquation adds an analyzed equation as a row of the system.
+ * The result is 0 (and nothing is added) when the equation is not linear.
+ */
+
+int addLinearEquation(LinearSystem *s, Equation *eq) {
+  int k, c;
+  if (!eq->valid || eq->degree > 1) {
+    return 0;
+  }
+  if (s->rows >= s->rhsCapacity) {
+    s->rhsCapacity = 2*s->rhsCapacity + 16;
+    s->rhs = realloc(s->rhs,s->rhsCapacity*sizeof(double));
+    assert( s->rhs != NULL );
+  }
+  for (k = 0; k < eq->variableCount; k++) {
+    c = column(s,eq->variables[k]);
+    if (eq->linear[k] == 0) {
+      continue;
+    }
+    if (s->entries >= s->entriesCapacity) {
+      s->entriesCapacity = 2*s->entriesCapacity + 64;
+      s->entryRow = realloc(s->entryRow,s->entriesCapacity*sizeof(int));
+      s->entryCol = realloc(s->entryCol,s->entriesCapacity*sizeof(int));
+      s->entryValue = realloc(s->entryValue,s->entriesCapacity*sizeof(double));
+      assert( s->entryRow != NULL && s->entryCol != NULL && s->entryValue != NULL );
+    }
+    s->entryRow[s->entries] = s->rows;
+    s->entryCol[s->entries] = c;
+    s->entryValue[s->entries] = eq->linear[k];
+    s->entries++;
+  }
+  s->rhs[s->rows] = -coefficient(eq,0);
+  s->rows++;
+  return 1;
+}
+
+/* The kernel rowUpdate computes y -= a*x for rows of length n.
+ */
+
+KERNEL
+static void rowUpdate(double *restrict y, const double *restrict x, double a, int n) {
+  int j;
+  for (j = 0; j < n; j++) {
+    y[j] -= a*x[j];
+  }
+}
+
+/* The kernel blockUpdate computes C -= A*B for a block C of 4 rows and UPDATEWIDTH
+ * columns (row k of C starts at c + k*stride). Row k of A (of length nb) starts at
+ * a + k*stride, and B is packed: its nb rows of UPDATEWIDTH values follow each other.
+ * The block of C stays in registers while the panel is traversed.
+ */
+
+#if defined(__GNUC__)
+
+/* With GCC and Clang the block of C is kept in vectors of 4 doubles, so that it stays in
+ * registers; UPDATEWIDTH is 8, i.e. two vectors per row.
+ */
+
+typedef double Vec4 __attribute__((vector_size(32)));
+
+KERNEL
+static void blockUpdate(double *restrict c, const double *restrict a, const double *restrict b,
+                        int nb, int stride) {
+  Vec4 s00 = {0}, s01 = {0}, s10 = {0}, s11 = {0}, s20 = {0}, s21 = {0}, s30 = {0}, s31 = {0};
+  Vec4 b0, b1, c0, c1;
+  int p, k;
+  for (p = 0; p < nb; p++) {
+    memcpy(&b0,b+p*UPDATEWIDTH,sizeof(Vec4));
+    memcpy(&b1,b+p*UPDATEWIDTH+4,sizeof(Vec4));
+    s00 += a[p] * b0;
+    s01 += a[p] * b1;
+    s10 += a[stride+p] * b0;
+    s11 += a[stride+p] * b1;
+    s20 += a[2*stride+p] * b0;
+    s21 += a[2*stride+p] * b1;
+    s30 += a[3*stride+p] * b0;
+    s31 += a[3*stride+p] * b1;
+  }
+  {
+    Vec4 sums[8] = { s00, s01, s10, s11, s20, s21, s30, s31 };
+    for (k = 0; k < 4; k++) {
+      memcpy(&c0,c+k*stride,sizeof(Vec4));
+      memcpy(&c1,c+k*stride+4,sizeof(Vec4));
+      c0 -= sums[2*k];
+      c1 -= sums[2*k+1];
+      memcpy(c+k*stride,&c0,sizeof(Vec4));
+      memcpy(c+k*stride+4,&c1,sizeof(Vec4));
+    }
+  }
+}
+
+#else
+
+static void blockUpdate(double *restrict c, const double *restrict a, const double *restrict b,
+                        int nb, int stride) {
+  double sum[4][UPDATEWIDTH] = {{0}};
+  int p, k, j;
+  for (p = 0; p < nb; p++) {
+    for (k = 0; k < 4; k++) {
+      for (j = 0; j < UPDATEWIDTH; j++) {
+        sum[k][j] += a[k*stride+p] * b[p*UPDATEWIDTH+j];
+      }
+    }
+  }
+  for (k = 0; k < 4; k++) {
+    for (j = 0; j < UPDATEWIDTH; j++) {
+      c[k*stride+j] -= sum[k][j];
+    }
+  }
+}
+
+#endif
+
+void swapRows(double *a, int stride, int r1, int r2) {
+  double *p = a + (size_t)r1*stride, *q = a + (size_t)r2*stride, t;
+  int j;
+  for (j = 0; j < stride; j++) {
+    t = p[j];
+    p[j] = q[j];
+    q[j] = t;
+  }
+}
+
+/* The function tolerance yields the size below which a pivot counts as 0:
+ * the machine precision, relative to the largest coefficient and the size.
+ */
+
+double tolerance(double *a, size_t count, int n) {
+  double largest = 0;
+  size_t k;
+  for (k = 0; k < count; k++) {
+    if (fabs(a[k]) > largest) {
+      largest = fabs(a[k]);
+    }
+  }
+  return n * DBL_EPSILON * largest;
+}
+
+/* The function luFactor factorizes the n x n matrix a (row by row) in place as P*a = L*U,
+ * with L unit lower triangular (below the diagonal) and U upper triangular.
+ * Row i of the factors is row perm[i] of the original matrix.
+ * The result is 0 when the matrix is (numerically) singular.
+ */
+
+int luFactor(double *a, int n, int *perm) {
+  double tol = tolerance(a,(size_t)n*n,n);
+  double *packed = malloc(((size_t)n+1)*LUBLOCK*sizeof(double));
+  double *row, *pivotRow, *strip;
+  double l;
+  int k0, kend, nb, rowEnd, colEnd, k, i, j, p, t;
+  assert( packed != NULL );
+  for (i = 0; i < n; i++) {
+    perm[i] = i;
+  }
+  for (k0 = 0; k0 < n; k0 += LUBLOCK) {
+    kend = (k0 + LUBLOCK < n ? k0 + LUBLOCK : n);
+    /* factorize the panel: columns k0..kend-1 of rows k0..n-1 */
+    for (k = k0; k < kend; k++) {
+      p = k;
+      for (i = k+1; i < n; i++) {
+        if (fabs(a[(size_t)i*n+k]) > fabs(a[(size_t)p*n+k])) {
+          p = i;
+        }
+      }
+      if (fabs(a[(size_t)p*n+k]) <= tol) {
+        free(packed);
+        return 0;
+      }
+      if (p != k) {
+        swapRows(a,n,p,k);
+        t = perm[p];
+        perm[p] = perm[k];
+        perm[k] = t;
+      }
+      pivotRow = a + (size_t)k*n;
+      for (i = k+1; i < n; i++) {
+        row = a + (size_t)i*n;
+        l = row[k] /= pivotRow[k];
+        if (l != 0) {
+          rowUpdate(row+k+1,pivotRow+k+1,l,kend-k-1);
+        }
+      }
+    }
+    if (kend == n) {
+      break;
+    }
+    /* the rows of U right of the panel: solve with the unit lower triangle of the panel */
+    for (k = k0; k < kend; k++) {
+      for (i = k+1; i < kend; i++) {
+        l = a[(size_t)i*n+k];
+        if (l != 0) {
+          rowUpdate(a+(size_t)i*n+kend,a+(size_t)k*n+kend,l,n-kend);
+        }
+      }
+    }
+    /* update the rest of the matrix with the whole panel: pack the rows of U right of
+     * the panel in strips of UPDATEWIDTH columns, and update 4 rows at a time */
+    nb = kend - k0;
+    for (j = kend; j+UPDATEWIDTH <= n; j += UPDATEWIDTH) {
+      strip = packed + (size_t)(j-kend)/UPDATEWIDTH*nb*UPDATEWIDTH;
+      for (p = 0; p < nb; p++) {
+        memcpy(strip+p*UPDATEWIDTH,a+(size_t)(k0+p)*n+j,UPDATEWIDTH*sizeof(double));
+      }
+    }
+    rowEnd = kend + (n-kend)/4*4;
+    colEnd = kend + (n-kend)/UPDATEWIDTH*UPDATEWIDTH;
+    for (i = kend; i < rowEnd; i += 4) {
+      row = a + (size_t)i*n;
+      for (j = kend; j < colEnd; j += UPDATEWIDTH) {
+        blockUpdate(row+j,row+k0,packed+(size_t)(j-kend)/UPDATEWIDTH*nb*UPDATEWIDTH,nb,n);
+      }
+    }
+    for (i = kend; i < n; i++) { /* the rows and columns that do not fill a block */
+      row = a + (size_t)i*n;
+      j = (i < rowEnd ? colEnd : kend);
+      for (p = k0; p < kend && j < n; p++) {
+        rowUpdate(row+j,a+(size_t)p*n+j,row[p],n-j);
+      }
+    }
+  }
+  free(packed);
+  return 1;
+}
+
+/* The function luSolve solves a*x = b with the factorization of luFactor.
+ * The solution replaces b.
+ */
+
+void luSolve(double *a, int n, int *perm, double *b) {
+  double *y = malloc(n*sizeof(double));
+  double sum;
+  int i, j;
+  assert( y != NULL );
+  for (i = 0; i < n; i++) { /* L*y = P*b */
+    sum = b[perm[i]];
+    for (j = 0; j < i; j++) {
+      sum -= a[(size_t)i*n+j] * y[j];
+    }
+    y[i] = sum;
+  }
+  for (i = n-1; i >= 0; i--) { /* U*x = y */
+    sum = y[i];
+    for (j = i+1; j < n; j++) {
+      sum -= a[(size_t)i*n+j] * y[j];
+    }
+    y[i] = sum / a[(size_t)i*n+i];
+  }
+  memcpy(b,y,n*sizeof(double));
+  free(y);
+}
+
+/* The function echelonSolve reduces the augmented matrix m (rows x (cols+1), row by row)
+ * to row echelon form with partial pivoting; a column without pivot belongs to a free
+ * variable. It yields the result, the rank in *rank, and for a unique solution the
+ * solution in x.
+ */
+
+SystemResult echelonSolve(double *m, int rows, int cols, double *x, int *rank) {
+  int stride = cols + 1;
+  double tol = tolerance(m,(size_t)rows*stride,(rows > cols ? rows : cols));
+  double l, sum;
+  int r = 0, c, i, p, j;
+  for (c = 0; c < cols && r < rows; c++) {
+    p = r;
+    for (i = r+1; i < rows; i++) {
+      if (fabs(m[(size_t)i*stride+c]) > fabs(m[(size_t)p*stride+c])) {
+        p = i;
+      }
+    }
+    if (fabs(m[(size_t)p*stride+c]) <= tol) { /* no pivot: a free variable */
+      continue;
+    }
+    if (p != r) {
+      swapRows(m,stride,p,r);
+    }
+    for (i = r+1; i < rows; i++) {
+      l = m[(size_t)i*stride+c] / m[(size_t)r*stride+c];
+      if (l != 0) {
+        rowUpdate(m+(size_t)i*stride+c,m+(size_t)r*stride+c,l,stride-c);
+      }
+    }
+    r++;
+  }
+  *rank = r;
+  for (i = r; i < rows; i++) { /* a row 0 = b with b != 0 */
+    if (fabs(m[(size_t)i*stride+cols]) > tol) {
+      return NoSolution;
+    }
+  }
+  if (r < cols) {
+    return InfinitelyManySolutions;
+  }
+  for (i = r-1; i >= 0; i--) { /* back substitution; rank cols, so the pivot of row i is in column i */
+    sum = m[(size_t)i*stride+cols];
+    for (j = i+1; j < cols; j++) {
+      sum -= m[(size_t)i*stride+j] * x[j];
+    }
+    x[i] = sum / m[(size_t)i*stride+i];
+  }
+  return UniqueSolution;
+}
+
+/* The function solveLinearSystem solves the system. A square system is solved by LU
+ * factorization; when that fails, or when the system is not square, by echelonSolve.
+ */
+
+SystemResult solveLinearSystem(LinearSystem *s) {
+  int rows = s->rows, cols = s->cols, stride, k;
+  double *m;
+  int *perm;
+  SystemResult result;
+  free(s->solution);
+  s->solution = malloc((cols+1)*sizeof(double));
+  assert( s->solution != NULL );
+  if (rows == cols && cols > 0) {
+    m = calloc((size_t)rows*cols,sizeof(double));
+    perm = malloc(rows*sizeof(int));
+    assert( m != NULL && perm != NULL );
+    for (k = 0; k < s->entries; k++) {
+      m[(size_t)s->entryRow[k]*cols+s->entryCol[k]] += s->entryValue[k];
+    }
+    if (luFactor(m,cols,perm)) {
+      memcpy(s->solution,s->rhs,rows*sizeof(double));
+      luSolve(m,cols,perm,s->solution);
+      s->rank = cols;
+      free(m);
+      free(perm);
+      return UniqueSolution;
+    }
+    free(m);
+    free(perm);
+  }
+  stride = cols + 1;
+  m = calloc((size_t)rows*stride,sizeof(double));
+  assert( m != NULL );
+  for (k = 0; k < s->entries; k++) {
+    m[(size_t)s->entryRow[k]*stride+s->entryCol[k]] += s->entryValue[k];
+  }
+  for (k = 0; k < rows; k++) {
+    m[(size_t)k*stride+cols] = s->rhs[k];
+  }
+  result = echelonSolve(m,rows,cols,s->solution,&(s->rank));
+  free(m);
+  return result;
+}
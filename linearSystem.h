@@ -0,0 +1,49 @@
+/* linearSystem.h */
+
+#ifndef LINEARSYSTEM_H
+#define LINEARSYSTEM_H
+
+#define LUBLOCK 64 /* number of columns in a panel of the blocked LU factorization */
+#define UPDATEWIDTH 8 /* number of columns of a block in the update of the LU factorization */
+
+/* A system of linear equations over several variables. While the equations are added,
+ * the coefficients are kept as entries (row, column, value), because the number of
+ * columns is only known at the end; columnOf[id] is the column of the variable with
+ * that id, or -1, and variables[c] is the id of column c.
+ * After solveLinearSystem, rank is the rank of the matrix and solution[c] is the
+ * value of the variable of column c (when the solution is unique).
+ */
+
+typedef struct LinearSystem {
+  int rows;
+  int cols;
+  int *entryRow;
+  int *entryCol;
+  double *entryValue;
+  int entries;
+  int entriesCapacity;
+  double *rhs;
+  int rhsCapacity;
+  int *columnOf;
+  int columnOfCapacity;
+  int *variables;
+  int variablesCapacity;
+  double *solution;
+  int rank;
+} LinearSystem;
+
+typedef enum SystemResult {
+  UniqueSolution,
+  NoSolution,
+  InfinitelyManySolutions
+} SystemResult;
+
+void initLinearSystem(LinearSystem *s);
+void clearLinearSystem(LinearSystem *s);
+void freeLinearSystem(LinearSystem *s);
+int addLinearEquation(LinearSystem *s, Equation *eq);
+int luFactor(double *a, int n, int *perm);
+void luSolve(double *a, int n, int *perm, double *b);
+SystemResult solveLinearSystem(LinearSystem *s);
+
+#endif
@@ -1,15 +1,77 @@
 /* mainPref.c, Gerard Renardel, 10 December 2013
+ *
+ * Without arguments the program performs the dialogue of prefExpTrees.
+ * With the argument --batch it solves the equations on the lines of the standard input
+ * and writes the results to the standard output (see batchSolve.c); the number of
+ * threads (1 to MAXTHREADS) can follow, by default it is the number of processors.
+ * With the argument --system it solves systems of linear equations (see recognizeSystems).
+ * The argument --stats (or --stats=json), before the others, writes the time spent in
+ * each phase and the counters of stats.h to the standard error at the end; this needs
+ * a program compiled with -DSTATS.
  */
 
-#include <stdio.h>  /* printf */
-#include <stdlib.h> /* free */
+#include <stdio.h>  /* printf, fprintf */
+#include <stdlib.h> /* free, strtol */
+#include <string.h> /* strcmp */
+#include <unistd.h> /* sysconf, STDERR_FILENO */
 #include <assert.h> /* assert */
 #include "scanner.h"
 #include "recognizeExp.h"
 #include "infixExp.h"
+#include "batchSolve.h"
+#include "stats.h"
 
-int main(int argc, char *argv[]) {
-  prefExpTrees();
-  return 0;
+#define MAXTHREADS 1024
+
+/* The function threadCount yields the number of threads given by s, or 0 when s is not
+ * a number from 1 to MAXTHREADS.
+ */
+
+int threadCount(const char *s) {
+  char *end;
+  long n = strtol(s,&end,10);
+  if (end == s || *end != '\0' || n < 1 || n > MAXTHREADS) {
+    return 0;
+  }
+  return (int)n;
 }
 
+int main(int argc, char *argv[]) {
+  int stats = 0;  /* 1 for --stats, 2 for --stats=json */
+  int status = 0;
+  if (argc >= 2 && strncmp(argv[1],"--stats",7) == 0) {
+    stats = (strcmp(argv[1]+7,"=json") == 0 ? 2 : 1);
+    argc--;
+    argv++;
+#ifdef STATS
+    statsEnable();
+#endif
+  }
+  if (argc >= 2 && strcmp(argv[1],"--batch") == 0) {
+    int threads = (argc >= 3 ? threadCount(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN));
+    if (threads == 0) {
+      fprintf(stderr,"usage: mainPref [--stats] --batch [threads], with 1 <= threads <= %d\n",
+              MAXTHREADS);
+      return 1;
+    }
+    status = solveBatch(stdin,stdout,threads);
+  } else if (argc >= 2 && strcmp(argv[1],"--system") == 0) {
+    recognizeSystems();
+  } else {
+    prefExpTrees();
+  }
+#ifdef STATS
+  if (stats > 0) {
+    Sink err;
+    initSink(&err,STDERR_FILENO);
+    statsReport(&err,stats == 2);
+    flushSink(&err);
+    freeSink(&err);
+  }
+#else
+  if (stats > 0) {
+    fprintf(stderr,"--stats: the program is compiled without STATS\n");
+  }
+#endif
+  return status;
+}
@@ -0,0 +1,268 @@
+/* polySolve.c
+ *
+ * In this file the roots of a polynomial in one variable are computed. The polynomial
+ * is given by its coefficient vector: coefficients[k] is the coefficient of x^k.
+ * Degrees 1 to 4 are solved with the closed formulas (Cardano for degree 3, Ferrari
+ * for degree 4), followed by a Newton step to repair rounding errors.
+ * Higher degrees are solved numerically with the Aberth method, which improves
+ * approximations of all roots simultaneously.
+ * Roots are complex numbers in general: root k is re[k] + im[k]*i.
+ */
+
+#include <stdlib.h>  /* malloc, free, qsort */
+#include <string.h>  /* memcpy */
+#include <math.h>    /* sqrt, cbrt, acos, cos, fabs */
+#include <complex.h> /* complex arithmetic */
+#include <assert.h>  /* assert */
+#include "polySolve.h"
+
+#define PI 3.14159265358979323846
+
+/* The function polynomialDegree yields the degree of the polynomial with the given
+ * coefficients: the highest k < size with a coefficient that is not 0, or -1 when
+ * all coefficients are 0.
+ */
+
+int polynomialDegree(const double *coefficients, int size) {
+  int k = size - 1;
+  while (k >= 0 && coefficients[k] == 0) {
+    k--;
+  }
+  return k;
+}
+
+/* The function evalPolynomial computes p(z) and p'(z) with the Horner scheme.
+ */
+
+void evalPolynomial(const double *c, int n, double complex z, double complex *p, double complex *dp) {
+  double complex v = c[n], d = 0;
+  int k;
+  for (k = n-1; k >= 0; k--) {
+    d = d*z + v;
+    v = v*z + c[k];
+  }
+  *p = v;
+  *dp = d;
+}
+
+/* The function newtonStep improves a root with one Newton step, but only when that
+ * makes |p(z)| smaller (near multiple roots a step can make things worse).
+ */
+
+double complex newtonStep(const double *c, int n, double complex z) {
+  double complex p, dp, p1, dp1, z1;
+  evalPolynomial(c,n,z,&p,&dp);
+  if (p == 0 || dp == 0) {
+    return z;
+  }
+  z1 = z - p/dp;
+  evalPolynomial(c,n,z1,&p1,&dp1);
+  return (cabs(p1) < cabs(p) ? z1 : z);
+}
+
+/* The function quadraticRoots computes the roots of a*x^2 + b*x + c (a != 0).
+ * The root with the larger absolute value is computed first, and the other one from
+ * the product of the roots, which avoids cancellation.
+ */
+
+void quadraticRoots(double a, double b, double c, double complex *roots) {
+  double d = b*b - 4*a*c;
+  double q;
+  if (d >= 0) {
+    q = -0.5 * (b + (b >= 0 ? sqrt(d) : -sqrt(d)));
+    roots[0] = q / a;
+    roots[1] = (q != 0 ? c / q : 0);
+  } else {
+    roots[0] = (-b + I*sqrt(-d)) / (2*a);
+    roots[1] = conj(roots[0]);
+  }
+}
+
+/* The function cubicRoots computes the roots of x^3 + a*x^2 + b*x + c.
+ * With x = t - a/3 this becomes t^3 + p*t + q. When (q/2)^2 + (p/3)^3 > 0 there is one
+ * real root (Cardano); otherwise there are three, which are found with cosines.
+ */
+
+void cubicRoots(double a, double b, double c, double complex *roots) {
+  double p = b - a*a/3;
+  double q = 2*a*a*a/27 - a*b/3 + c;
+  double d = q*q/4 + p*p*p/27;
+  double shift = a/3;
+  int k;
+  if (d > 0) {
+    double u = cbrt(-q/2 + sqrt(d));
+    double v = cbrt(-q/2 - sqrt(d));
+    roots[0] = u + v - shift;
+    roots[1] = -(u+v)/2 - shift + I*(u-v)*sqrt(3)/2;
+    roots[2] = conj(roots[1]);
+  } else if (p == 0) {
+    roots[0] = roots[1] = roots[2] = -shift;
+  } else {
+    double r = 2*sqrt(-p/3);
+    double x = 3*q/(p*r);
+    double phi;
+    if (x > 1) {
+      x = 1;
+    } else if (x < -1) {
+      x = -1;
+    }
+    phi = acos(x)/3;
+    for (k = 0; k < 3; k++) {
+      roots[k] = r*cos(phi - 2*PI*k/3) - shift;
+    }
+  }
+}
+
+/* The function quarticRoots computes the roots of x^4 + a*x^3 + b*x^2 + c*x + d.
+ * With x = y - a/4 this becomes y^4 + p*y^2 + q*y + r. For q = 0 this is a quadratic
+ * equation in y^2. Otherwise (Ferrari) a positive root m of the resolvent cubic
+ * 8m^3 + 8p*m^2 + (2p^2 - 8r)*m - q^2 splits it into two quadratic factors
+ * y^2 + s*y + (p/2 + m - q/(2s)) and y^2 - s*y + (p/2 + m + q/(2s)), with s = sqrt(2m).
+ */
+
+void quarticRoots(double a, double b, double c, double d, double complex *roots) {
+  double p = b - 3*a*a/8;
+  double q = c - a*b/2 + a*a*a/8;
+  double r = d - a*c/4 + a*a*b/16 - 3*a*a*a*a/256;
+  double shift = a/4;
+  double complex z[3];
+  double m, s;
+  int k;
+  if (fabs(q) <= 1e-14 * (1 + fabs(p) + fabs(r))) {
+    quadraticRoots(1,p,r,z);
+    roots[0] = csqrt(z[0]);
+    roots[1] = -roots[0];
+    roots[2] = csqrt(z[1]);
+    roots[3] = -roots[2];
+  } else {
+    cubicRoots(p,(p*p-4*r)/4,-q*q/8,z);
+    m = 0;
+    for (k = 0; k < 3; k++) { /* the largest real root is positive */
+      if (fabs(cimag(z[k])) <= 1e-12 * (1 + cabs(z[k])) && creal(z[k]) > m) {
+        m = creal(z[k]);
+      }
+    }
+    s = sqrt(2*m);
+    quadraticRoots(1,s,p/2 + m - q/(2*s),roots);
+    quadraticRoots(1,-s,p/2 + m + q/(2*s),roots+2);
+  }
+  for (k = 0; k < 4; k++) {
+    roots[k] -= shift;
+  }
+}
+
+/* The function aberthRoots approximates all roots of the polynomial of degree n with
+ * the Aberth method. The starting points lie on a circle whose radius is the geometric
+ * mean of the absolute values of the roots; each step moves root k by
+ * w = (p/p') / (1 - (p/p') * sum_{j != k} 1/(z_k - z_j)).
+ */
+
+void aberthRoots(const double *c, int n, double complex *z) {
+  double radius = pow(fabs(c[0]/c[n]),1.0/n);
+  double complex p, dp, ratio, sum, w;
+  double largest;
+  int k, j, iteration;
+  if (radius == 0 || !isfinite(radius)) {
+    radius = 1;
+  }
+  for (k = 0; k < n; k++) {
+    z[k] = radius * cexp(I*(2*PI*k/n + 0.4));
+  }
+  for (iteration = 0; iteration < MAXITERATIONS; iteration++) {
+    largest = 0;
+    for (k = 0; k < n; k++) {
+      evalPolynomial(c,n,z[k],&p,&dp);
+      if (p == 0) {
+        continue;
+      }
+      ratio = p/dp;
+      sum = 0;
+      for (j = 0; j < n; j++) {
+        if (j != k) {
+          sum += 1/(z[k] - z[j]);
+        }
+      }
+      w = ratio / (1 - ratio*sum);
+      z[k] -= w;
+      if (cabs(w) > largest * (1 + cabs(z[k]))) {
+        largest = cabs(w) / (1 + cabs(z[k]));
+      }
+    }
+    if (largest < 1e-15) {
+      break;
+    }
+  }
+}
+
+/* The function compareRoots orders the roots: real roots first, in increasing order,
+ * then the complex roots by real part and imaginary part.
+ */
+
+int compareRoots(const void *x, const void *y) {
+  const double *a = x, *b = y;
+  int realA = (a[1] == 0), realB = (b[1] == 0);
+  if (realA != realB) {
+    return realB - realA;
+  }
+  if (a[0] != b[0]) {
+    return (a[0] < b[0] ? -1 : 1);
+  }
+  return (a[1] < b[1] ? -1 : (a[1] > b[1]));
+}
+
+/* The function solvePolynomial computes the roots of the polynomial with the given
+ * coefficients, of the given degree (coefficients[degree] != 0). Roots at 0 are split off
+ * first. A root whose imaginary part is negligible is made real.
+ * The result is the number of roots, i.e. the degree.
+ */
+
+int solvePolynomial(const double *coefficients, int degree, double *re, double *im) {
+  const double *c = coefficients;
+  double complex *z = malloc(degree*sizeof(double complex));
+  double *pairs = malloc(2*degree*sizeof(double));
+  int zeros = 0, n, k;
+  assert( z != NULL && pairs != NULL );
+  assert( degree >= 1 && c[degree] != 0 );
+  while (c[zeros] == 0) { /* x^zeros is a factor */
+    z[zeros] = 0;
+    zeros++;
+  }
+  c += zeros;
+  n = degree - zeros;
+  switch (n) {
+  case 0:
+    break;
+  case 1:
+    z[zeros] = -c[0]/c[1];
+    break;
+  case 2:
+    quadraticRoots(c[2],c[1],c[0],z+zeros);
+    break;
+  case 3:
+    cubicRoots(c[2]/c[3],c[1]/c[3],c[0]/c[3],z+zeros);
+    break;
+  case 4:
+    quarticRoots(c[3]/c[4],c[2]/c[4],c[1]/c[4],c[0]/c[4],z+zeros);
+    break;
+  default:
+    aberthRoots(c,n,z+zeros);
+  }
+  for (k = zeros; k < degree; k++) {
+    if (n >= 3) {
+      z[k] = newtonStep(c,n,z[k]);
+    }
+    pairs[2*k] = creal(z[k]);
+    pairs[2*k+1] = (fabs(cimag(z[k])) <= 1e-10 * (1 + cabs(z[k])) ? 0 : cimag(z[k]));
+  }
+  for (k = 0; k < zeros; k++) {
+    pairs[2*k] = pairs[2*k+1] = 0;
+  }
+  qsort(pairs,degree,2*sizeof(double),compareRoots);
+  for (k = 0; k < degree; k++) {
+    re[k] = pairs[2*k];
+    im[k] = pairs[2*k+1];
+  }
+  free(z);
+  free(pairs);
+  return degree;
+}
@@ -0,0 +1,11 @@
+/* polySolve.h */
+
+#ifndef POLYSOLVE_H
+#define POLYSOLVE_H
+
+#define MAXITERATIONS 500 /* maximal number of iterations of the Aberth method */
+
+int polynomialDegree(const double *coefficients, int size);
+int solvePolynomial(const double *coefficients, int degree, double *re, double *im);
+
+#endif
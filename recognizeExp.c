@@ -17,18 +17,16 @@
  * structure of the BNF grammar.
  */
 
-#include <stdio.h>  /* getchar, printf */
-#include <stdlib.h> /* NULL */
+#include <stdlib.h> /* NULL, realloc, free */
+#include <unistd.h> /* STDOUT_FILENO */
+#include <assert.h> /* assert */
 #include "scanner.h"
 #include "recognizeExp.h"
 #include <string.h>
 #include "infixExp.h"
-
-void solve(List *lp);
-
-void evalTerm(List *lp, double *nat, double *iden, int minus);
-
-void evalExpression(List *lp, double *nat, double *iden);
+#include "polySolve.h"
+#include "linearSystem.h"
+#include "stats.h"
 
 /* The functions acceptNumber, acceptIdentifier and acceptCharacter have as
  * (first) argument a pointer to an token list; moreover acceptCharacter has as
@@ -39,7 +37,7 @@ void evalExpression(List *lp, double *nat, double *iden);
  */
 
 int acceptNumber(List *lp) {
-	if (*lp != NULL && (*lp)->tt == Number) {
+	if (*lp != NULL && ((*lp)->tt == Number || (*lp)->tt == Real)) {
 		*lp = (*lp)->next;
 		return 1;
 	}
@@ -101,30 +99,6 @@ int acceptTerm(List *lp) {
 		return 1;
 	}
 	return 0;
-}
-// An equation needs to have the following: only one equal sign and two valid expressions.
-int acceptEquation(List *lp, List *lp1){
-//	if(!isDegree(lp1))
-//		return 0;
-	if(!acceptExpression(lp)) {
-//		printf("!acceptExpression 2\n");
-		return 0;
-	}
-//	printList(*lp);
-	if(!acceptCharacter(lp, '=')) {
-//		printf("!accept '=' \n");
-		return 0;
-	}
-	if(!acceptExpression(lp)) {
-//		printf("!acceptExpression 2\n");
-		return 0;
-	}
-	if(*lp != NULL) {
-//		printf("lp != empty");
-			return 0;
-	}
-
-	return 1;
 }
  /* <prefexp>   ::= <number> | <identifier> | '+' <prefexp> <prefexp> | '-' <prefexp> <prefexp> | '*' <prefexp> <prefexp> | '/' <prefexp> <prefexp> 
  * 
@@ -153,253 +127,376 @@ int acceptExpression(List *lp) {
   return 1;
 }
 
-int acceptVariables(List *lp){
-    int same = 1, numVar=0;
-    List tempList = NULL;
-    while ((*lp) != NULL){
-        if((*lp)->tt == Identifier){
-			++numVar;
-            // if we detect a new variable (t.identifier) then copy it by using the built in scanner (new TokenList)
-            // and compare it
-            if(numVar == 1){
-                // if tempList is empty we have found the first variable in the List
-//                printf("Found a variable\n");
-                tempList = tokenList((*lp)->t.identifier);
-            } else {
-                // found a new variable
-//                printf("Found a new variable\n");
-                if(strcmp(tempList->t.identifier, (*lp)->t.identifier) == 0){
-                    //they are the same
-                    same = 1;
-                } else {
-                    //they are not
-                    same = 0;
-                    break;
-                }
-            }
-
-        }
-        (*lp) = (*lp)->next;
+double almostZero(double n){
+    if (n> -0.0005 && n < 0.0005){
+        return 0;
     }
-    freeTokenList(tempList);
-	if(numVar > 0 ){return same;}
-	return 0;
+    return n;
 }
 
-// First try, does not use dynamic memory allocation and is not using the built tokenList() function to copy
-int checkVariables(List *lp){
-	int counter = 0;
-	//counter2 =0;
-	//int varTest = 0;
-	//int index =0;
-	char cpyString[10000], cpyCheck[10000];
-	//have to set the NULL pointer ourselves
-	memset(cpyString, '\0', sizeof(cpyString));
-	memset(cpyCheck, '\0', sizeof(cpyCheck));
-	while((*lp) != NULL){
-		
-		if((*lp)->tt == Identifier){
-			//copy string. When new variable is detected, check if the strings are different
-			// in future might need to check the length of the string because matchIdentifier 
-			// in scanner.c uses dynamic memory allocation
-			
-			//Have to make two copys in order to check. 
-			//first variable
-			if(counter == 0){
-				strcpy(cpyCheck, (*lp)->t.identifier);
-				strcpy(cpyString, cpyCheck);
-//				printf(" |found a new variable: %s |", cpyString);
-				counter++;
-			}
-			//other variables
-			if(counter > 0){
-				strcpy(cpyString, (*lp)->t.identifier);
-				//printf(" |found a new variable: %s |", cpyString);
-				//check if different
-				if((strcmp(cpyString, cpyCheck) != 0)){
-//					printf("this variable is different\n");
-					return 0;
-				} else {
-					//printf("this is the same variable as we had");
-				}
-			}
+/* The functions below analyze an equation in one pass over its token list: while the
+ * equation is recognized, the variables are collected, the degree is computed and
+ * the coefficients of the powers are accumulated for each side.
+ * The grammar is:
+ *
+ * <equation>   ::= <expression> '=' <expression>
+ *
+ * <expression> ::= [ '-' ] <term> { '+' <term> | '-' <term> }
+ *
+ * <term>       ::= <number> | [ <number> ] <identifier> [ '^' <natnum> ]
+ */
+
+void initEquation(Equation *eq) {
+	eq->valid = 0;
+	eq->variableCount = 0;
+	eq->variables = NULL;
+	eq->linear = NULL;
+	eq->variablesCapacity = 0;
+	eq->variableIndex = NULL;
+	eq->indexCapacity = 0;
+	eq->degree = 0;
+	eq->size = 0;
+	eq->capacity = 0;
+	eq->coefficients[0] = NULL;
+	eq->coefficients[1] = NULL;
+	eq->difference = NULL;
+	eq->re = NULL;
+	eq->im = NULL;
+	eq->rootsCapacity = 0;
+}
+
+void freeEquation(Equation *eq) {
+	free(eq->variables);
+	free(eq->linear);
+	free(eq->variableIndex);
+	free(eq->coefficients[0]);
+	free(eq->coefficients[1]);
+	free(eq->difference);
+	free(eq->re);
+	free(eq->im);
+	initEquation(eq);
+}
+
+// Adds the variable with the given id, unless it has been seen before in this equation.
+// variableIndex[id] is the position of the variable in variables, or -1.
+void addVariable(Equation *eq, int id) {
+	int k;
+	if (id >= eq->indexCapacity) {
+		k = eq->indexCapacity;
+		eq->indexCapacity = 2*id + 16;
+		eq->variableIndex = realloc(eq->variableIndex, eq->indexCapacity*sizeof(int));
+		assert(eq->variableIndex != NULL);
+		for (; k < eq->indexCapacity; k++) {
+			eq->variableIndex[k] = -1;
 		}
-		*lp = (*lp)->next;
 	}
-	return counter;
+	if (eq->variableIndex[id] >= 0) {
+		return;
+	}
+	if (eq->variableCount >= eq->variablesCapacity) {
+		eq->variablesCapacity = 2*eq->variablesCapacity + 4;
+		eq->variables = realloc(eq->variables, eq->variablesCapacity*sizeof(int));
+		eq->linear = realloc(eq->linear, eq->variablesCapacity*sizeof(double));
+		assert(eq->variables != NULL && eq->linear != NULL);
+	}
+	eq->variableIndex[id] = eq->variableCount;
+	eq->variables[eq->variableCount] = id;
+	eq->linear[eq->variableCount] = 0;
+	eq->variableCount++;
 }
 
-// This function is not needed since we check for this in acceptTerm
-int isDegree(List *lp){
-	while((*lp) != NULL){
-		if(((*lp)->t).symbol == '^'){
-			*lp = (*lp)->next;
-			if ( *lp == NULL || (*lp)->tt != Number || acceptCharacter(lp,'-')){
-				return 0;
-			}
+// Adds value to the coefficient of the given power on the given side (0 is left, 1 is right).
+// Powers above MAXDEGREE are not stored; eq->degree still tells the degree.
+void addCoefficient(Equation *eq, int side, int64_t power, double value) {
+	int k, s;
+	if (power > MAXDEGREE) {
+		return;
+	}
+	if (power >= eq->capacity) {
+		k = eq->capacity;
+		eq->capacity = 2*(int)power + 4;
+		for (s = 0; s < 2; s++) {
+			eq->coefficients[s] = realloc(eq->coefficients[s], eq->capacity*sizeof(double));
+			assert(eq->coefficients[s] != NULL);
+		}
+		for (; k < eq->capacity; k++) {
+			eq->coefficients[0][k] = eq->coefficients[1][k] = 0;
 		}
-		*lp = (*lp)->next;
 	}
-	return 1;
+	if (power >= eq->size) {
+		eq->size = power + 1;
+	}
+	eq->coefficients[side][power] += value;
 }
 
-int checkDegree(List *lp){
-//	We know that we have a correct equation with 1 variable
-//	What happens when we encounter x = 1 or x + x^0 = 1?
-	int highest = 1;
-	int counter = 0;
-	while((*lp) != NULL){
-		if (acceptIdentifier(lp)) {
-			if ((*lp) != NULL) {
-				if (acceptCharacter(lp, '^')){
-					// We know that ^ is always followed by a number (because of recognizeEq)
-					if (counter == 0) {
-						highest = ((*lp)->t).number;
-						*lp = (*lp)->next;
-					} else {
-						// found a new number/power/degree
-						if (((*lp)->t).number > highest) {
-							highest = ((*lp)->t).number;
-						}
-						*lp = (*lp)->next;
-					}
-				}
-//				No ^ so degree = 1
-				counter = 1;
+// The function acceptSymbol advances over the current token of a token source when it
+// is the symbol c, and yields whether it did.
+int acceptSymbol(TokenSource *s, char c) {
+	if (sourceSymbol(s, c)) {
+		sourceNext(s);
+		return 1;
+	}
+	return 0;
+}
 
+int analyzeTerm(TokenSource *s, Equation *eq, int side, int sign) {
+	double coefficient = 1;
+	int64_t power = 0;
+	int number = 0;
+	int id;
+	if (!sourceAtEnd(s) && (sourceType(s) == Number || sourceType(s) == Real)) {
+		coefficient = numberValue(sourceType(s), *sourceToken(s));
+		sourceNext(s);
+		number = 1;
+	}
+	if (!sourceAtEnd(s) && sourceType(s) == Identifier) {
+		id = sourceToken(s)->identifier.id;
+		addVariable(eq, id);
+		sourceNext(s);
+		power = 1;
+		if (acceptSymbol(s, '^')) {
+			// the degree has to be a natural number
+			if (sourceAtEnd(s) || sourceType(s) != Number) {
+				return 0;
 			}
-		} else{
-			if((*lp) != NULL) (*lp) = (*lp)->next;
+			power = sourceToken(s)->number;
+			sourceNext(s);
 		}
-
-	}	
-	printf("%d\n",highest);
-	return highest;	
+		if (power > eq->degree) {
+			eq->degree = power;
+		}
+		if (power == 1) {
+			eq->linear[eq->variableIndex[id]] += (side == 0 ? sign : -sign) * coefficient;
+		}
+	} else if (!number) {
+		return 0;
+	}
+	addCoefficient(eq, side, power, sign*coefficient);
+	return 1;
 }
 
-double almostZero(double n){
-    if (n> -0.0005 && n < 0.0005){
-        return 0;
-    }
-    return n;
+int analyzeExpression(TokenSource *s, Equation *eq, int side) {
+	int sign = (acceptSymbol(s, '-') ? -1 : 1);
+	if (!analyzeTerm(s, eq, side, sign)) {
+		return 0;
+	}
+	for (;;) {
+		if (acceptSymbol(s, '+')) {
+			sign = 1;
+		} else if (acceptSymbol(s, '-')) {
+			sign = -1;
+		} else {
+			return 1;
+		}
+		if (!analyzeTerm(s, eq, side, sign)) {
+			return 0;
+		}
+	}
 }
 
-//The function solve takes a tokenlist. It evaluates the left and right handside of the equation.
-// It stores the natural number value and the identifier value (the natnumber in front of the identifier).
-// It then calculates the solution of the equation based on these values.
+// The function clearEquation empties eq for the next analysis. The memory of eq is
+// reused: only the parts used by the previous equation are cleared.
+void clearEquation(Equation *eq) {
+	int k;
+	for (k = 0; k < eq->variableCount; k++) {
+		eq->variableIndex[eq->variables[k]] = -1;
+	}
+	for (k = 0; k < eq->size; k++) {
+		eq->coefficients[0][k] = eq->coefficients[1][k] = 0;
+	}
+	eq->variableCount = 0;
+	eq->degree = 0;
+	eq->size = 0;
+}
 
-void solve(List *lp) {
-	double leftNatNum=0, leftIden=0, rightNatNum=0, rightIden=0;
-	evalExpression(lp, &leftNatNum, &leftIden);
-//	printf("lefthandside finished. List = ");
-//	printList(*lp);
+// The function analyzeEquationSource fills eq with the analysis of the tokens of a
+// token source (see scanner.h); analyzeEquation does so for a token list, and
+// analyzeEquationFlat for a cursor in a token array, which the batch mode uses.
+int analyzeEquationSource(TokenSource s, Equation *eq) {
+	STATS_START(start);
+	clearEquation(eq);
+	eq->valid = analyzeExpression(&s, eq, 0) && acceptSymbol(&s, '=')
+	            && analyzeExpression(&s, eq, 1) && sourceAtEnd(&s);
+	STATS_STOP(PhaseAnalyze, start);
+	return eq->valid;
+}
 
-	evalExpression(lp, &rightNatNum, &rightIden);
-//	printf("righthandside finished. List = ");
-//	printList(*lp);
-//	printf("left: %.1fx + %.1f\nright: %.1fx + %.1f\n", leftIden,leftNatNum,rightIden,rightNatNum);
+int analyzeEquation(List tl, Equation *eq) {
+	return analyzeEquationSource(listSource(tl), eq);
+}
 
-    rightNatNum -= leftNatNum;
-    leftIden -= rightIden;
+int analyzeEquationFlat(TokenCursor c, Equation *eq) {
+	return analyzeEquationSource(cursorSource(c), eq);
+}
 
-    if(leftIden != 0){
-        rightNatNum /= leftIden;
-		printf("solution: %.3f", almostZero(rightNatNum));
-    } else {
-		printf("not solvable");
+// The function coefficient yields the coefficient of the given power after moving
+// everything to the left-hand side.
+double coefficient(Equation *eq, int power) {
+	if (power >= eq->size) {
+		return 0;
 	}
-    printf("\n");
-
-
+	return eq->coefficients[0][power] - eq->coefficients[1][power];
 }
-void evalExpression(List *lp, double *nat, double *iden){
-	while(!acceptCharacter(lp, '=') && *lp != NULL){
-//		printf("-EvalExpression-\n");
-		if(acceptCharacter(lp, '-')){
-			evalTerm(lp, nat, iden, -1);
-		} else if (acceptCharacter(lp, '+')){
-			evalTerm(lp, nat, iden, 1);
-		} else {
-//			A term does not have to start with + or -
-			evalTerm(lp,nat,iden,1);
-		}
+
+// The function solveEquation computes the roots of an analyzed equation in 1 variable,
+// as a polynomial equation p(x) = 0 where p is left - right. The result is the number
+// of roots (the degree of p), which are in eq->re and eq->im; it is 0 when p has no
+// roots (p is constant) and -1 when the degree is above MAXDEGREE.
+int solveEquation(Equation *eq) {
+	int k, n;
+	STATS_START(start);
+	if (eq->degree > MAXDEGREE) {
+		STATS_STOP(PhaseSolve, start);
+		return -1;
 	}
+	if (eq->size > eq->rootsCapacity) {
+		eq->rootsCapacity = eq->capacity;
+		eq->difference = realloc(eq->difference, eq->rootsCapacity*sizeof(double));
+		eq->re = realloc(eq->re, eq->rootsCapacity*sizeof(double));
+		eq->im = realloc(eq->im, eq->rootsCapacity*sizeof(double));
+		assert(eq->difference != NULL && eq->re != NULL && eq->im != NULL);
+	}
+	for (k = 0; k < eq->size; k++) {
+		eq->difference[k] = coefficient(eq, k);
+	}
+	n = polynomialDegree(eq->difference, eq->size);
+	n = (n <= 0 ? 0 : solvePolynomial(eq->difference, n, eq->re, eq->im));
+	STATS_STOP(PhaseSolve, start);
+	return n;
 }
 
-void evalTerm(List *lp, double *nat, double *iden, int minus){
-	int degree;
-	double natNum;
-	if(!valueNumber(lp, &natNum)){
-		natNum = 1;
+// The function solve takes an analyzed equation in 1 variable and prints its solutions:
+// one real solution for degree 1, and all (complex) roots for higher degrees.
+void solve(Sink *out, Equation *eq) {
+	int n = solveEquation(eq), k;
+	if (n < 0) {
+		sinkText(out, "degree too high to solve");
+	} else if (n == 0) {
+		sinkText(out, "not solvable");
+	} else if (n == 1) {
+		sinkText(out, "solution: ");
+		sinkFixed(out, almostZero(eq->re[0]), 3, 0);
 	} else {
-//		printf("value natNum = %f\n", natNum);
-	}
-	if(acceptIdentifier(lp)){
-//		printf("accept Identifier\n");
-		if(acceptCharacter(lp,'^')){
-			degree = ((*lp)->t).number;
-//			printf("degree= %d\n",degree);
-			if(*lp != NULL &&  (*lp)->next != NULL && (*lp)->t.symbol != '=') *lp = (*lp)->next;
-			if (degree == 0 ){
-				*nat += (minus*natNum);
+		sinkText(out, "solutions:");
+		for (k = 0; k < n; k++) {
+			if (eq->im[k] == 0) {
+				sinkChar(out, ' ');
+				sinkFixed(out, almostZero(eq->re[k]), 3, 0);
 			} else {
-				//degree = 1
-				*iden += (minus*natNum);
+				sinkChar(out, ' ');
+				sinkFixed(out, almostZero(eq->re[k]), 3, 0);
+				sinkFixed(out, eq->im[k], 3, 1);
+				sinkChar(out, 'i');
 			}
-		} else {
-//				degree = 1;
-			*iden += (minus*natNum);
 		}
-	} else {
-		// only a natNum without following identifier
-		*nat += (minus*natNum);
-		if(*lp != NULL && (*lp)->next != NULL && (*lp)->t.symbol != '=') *lp = (*lp)->next;
-
 	}
-
+	sinkChar(out, '\n');
 }
 
 void recognizeEquation(){
-	char *ar;
-	int degree;
-	List tl, tl1,tl2;//tl3;
-	ar = readInput();
-	printf("give an equation: ");
-	while (ar[0] != '!'){
-		tl = tokenList(ar);
-		printList(tl);
-		tl1 = tl;
-		tl2 = tl;
-		if(!acceptEquation(&tl1, &tl2)){
-			printf("this is not an equation\n");
+	LineView line;
+	List tl;
+	Equation eq;
+	Sink out;
+	initEquation(&eq);
+	initSink(&out, STDOUT_FILENO);
+	sinkText(&out, "give an equation: ");
+	flushPrompt(&out);
+	while (readInput(&line) && line.start[0] != '!'){
+		tl = tokenList(line);
+		printList(&out, tl);
+		if(!analyzeEquation(tl, &eq)){
+			sinkText(&out, "this is not an equation\n");
+			STATS_COUNT(CountRejected, 1);
+		} else if(eq.variableCount == 1){
+			sinkText(&out, "this is an equation in 1 variable of degree ");
+			sinkInt(&out, eq.degree);
+			sinkChar(&out, '\n');
+			if(eq.degree >= 1){
+				solve(&out, &eq);
+			}
 		} else {
-			printf("this is an equation");
-			tl1 = tl;
-			if(acceptVariables(&tl1)){
-				printf(" in 1 variable of degree ");
-				tl1 = tl;
-				degree = checkDegree(&tl1);
-                tl1 = tl;
-				if(degree == 1){
-					//solve this equation
-                    solve(&tl1);
-					freeTokenList(tl1);
-				}
-			} else {
-				printf(", but not in 1 variable\n");
+			sinkText(&out, "this is an equation, but not in 1 variable\n");
+			STATS_COUNT(CountRejected, 1);
+		}
+		resetTokens();
+		sinkText(&out, "\ngive an equation: ");
+		flushPrompt(&out);
+	}
+	freeEquation(&eq);
+	sinkText(&out, "good bye\n");
+	flushSink(&out);
+	freeSink(&out);
+}
+
+// The function printSystem solves a system of linear equations and prints the result:
+// the value of every variable, or why there is no unique solution.
+void printSystem(Sink *out, LinearSystem *s) {
+	SystemResult result = solveLinearSystem(s);
+	Slice name;
+	int c;
+	if (result == NoSolution) {
+		sinkText(out, "the system has no solution (rank ");
+		sinkInt(out, s->rank);
+		sinkText(out, ")\n");
+	} else if (result == InfinitelyManySolutions) {
+		sinkText(out, "the system has infinitely many solutions (rank ");
+		sinkInt(out, s->rank);
+		sinkText(out, ", ");
+		sinkInt(out, s->cols);
+		sinkText(out, " variables)\n");
+	} else {
+		sinkText(out, "solution:");
+		for (c = 0; c < s->cols; c++) {
+			name = identifierSlice(s->variables[c]);
+			sinkText(out, (c > 0 ? ", " : " "));
+			sinkBytes(out, name.start, name.length);
+			sinkText(out, " = ");
+			sinkFixed(out, almostZero(s->solution[c]), 3, 0);
+		}
+		sinkChar(out, '\n');
+	}
+}
+
+// The function recognizeSystems reads systems of linear equations: the equations up to
+// an empty line form one system, which is solved at that empty line (or at the end).
+void recognizeSystems(){
+	LineView line;
+	List tl;
+	Equation eq;
+	LinearSystem s;
+	Sink out;
+	initEquation(&eq);
+	initLinearSystem(&s);
+	initSink(&out, STDOUT_FILENO);
+	sinkText(&out, "give equations, and an empty line to solve them: ");
+	flushPrompt(&out);
+	while (readInput(&line) && line.start[0] != '!'){
+		tl = tokenList(line);
+		if (tl == NULL) {
+			if (s.rows > 0) {
+				printSystem(&out, &s);
+				clearLinearSystem(&s);
 			}
+		} else if(!analyzeEquation(tl, &eq)){
+			sinkText(&out, "this is not an equation, it is ignored\n");
+			STATS_COUNT(CountRejected, 1);
+		} else if(!addLinearEquation(&s, &eq)){
+			sinkText(&out, "this is not a linear equation, it is ignored\n");
+			STATS_COUNT(CountRejected, 1);
+		}
+		resetTokens();
+		if (s.rows == 0) {
+			sinkText(&out, "\ngive equations, and an empty line to solve them: ");
 		}
-		//check list for number of unique variable chars
-		// and check variable degree. The number after character ^
-		
-//		freeTokenList(tl1);
-//		freeTokenList(tl2);
-//		freeTokenList(tl3);
-		free(ar);
-		freeTokenList(tl);
-		printf("\ngive an equation: ");
-		ar = readInput();
+		flushPrompt(&out);
+	}
+	if (s.rows > 0) {
+		printSystem(&out, &s);
 	}
-	free(ar);
-	printf("good bye\n");
+	freeLinearSystem(&s);
+	freeEquation(&eq);
+	sinkText(&out, "good bye\n");
+	flushSink(&out);
+	freeSink(&out);
 }
@@ -3,19 +3,55 @@
 #ifndef RECOGNIZEEXP_H
 #define RECOGNIZEEXP_H
 
+#define MAXDEGREE 1000 /* coefficients of higher powers are not stored */
+
+/* The result of the analysis of an equation:
+ * whether it is valid, its variables (their ids, in order of appearance),
+ * its degree (the highest power of a variable), and for each side
+ * (0 is left, 1 is right) the coefficients: coefficients[side][k] is the sum of the
+ * coefficients of the terms with power k on that side, for k < size.
+ * linear[k] is the coefficient of the first power of variables[k], of left - right;
+ * with several variables these describe a linear equation.
+ * The arrays difference, re and im are used by solveEquation.
+ */
+
+typedef struct Equation {
+  int valid;
+  int variableCount;
+  int *variables;
+  double *linear;
+  int variablesCapacity;
+  int *variableIndex;   /* variableIndex[id]: position of id in variables, or -1 */
+  int indexCapacity;
+  int64_t degree;
+  int size;
+  int capacity;
+  double *coefficients[2];
+  double *difference;   /* difference[k]: coefficient of x^k of left - right */
+  double *re;           /* the roots: re[k] + im[k]*i */
+  double *im;
+  int rootsCapacity;
+} Equation;
+
 int acceptNumber(List *lp);
 int acceptIdentifier(List *lp);
 int acceptCharacter(List *lp, char c);
 int acceptTerm(List *lp);
-int acceptEquation(List *lp, List *lp1);
 int acceptExpression(List *lp);
-int countEquals(List *lp);
-int acceptVariables(List *lp);
-int checkVariables(List *lp);
-int isDegree(List *lp);
-int checkDegree(List *lp);
+int acceptSymbol(TokenSource *s, char c);
 
+void initEquation(Equation *eq);
+void freeEquation(Equation *eq);
+void clearEquation(Equation *eq);
+int analyzeEquationSource(TokenSource s, Equation *eq);
+int analyzeEquation(List tl, Equation *eq);
+int analyzeEquationFlat(TokenCursor c, Equation *eq);
+double coefficient(Equation *eq, int power);
+double almostZero(double n);
+int solveEquation(Equation *eq);
+void solve(Sink *out, Equation *eq);
 void recognizeEquation();
+void recognizeSystems();
 void recognizeExpressions();
 
 #endif
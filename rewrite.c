@@ -0,0 +1,430 @@
+/* rewrite.c
+ *
+ * In this file expression trees are simplified by rewriting them to a normal form:
+ *
+ * - operations on two constants are computed (constant folding);
+ * - a chain of + and - is flattened to a list of terms c*E. Terms with the same E are
+ *   combined (so E-E disappears), terms with coefficient 0 are dropped, and the terms
+ *   are sorted, with the constant last;
+ * - a chain of * and / is flattened to a constant and a list of factors E^k. Factors
+ *   with the same E are combined (so E/E disappears), and the factors are sorted.
+ *   E^k is written as E * ... * E, with the factors with k < 0 in one denominator.
+ *
+ * Because nodes are hash-consed (see newExpTreeNode), two subexpressions are equal
+ * exactly when they are the same node, and the sort order is that of the node ids.
+ * A chain is flattened once, at its root, so that a pass takes time about linear in the
+ * size of the tree (apart from sorting the terms). Rewriting a node can make new
+ * opportunities in its parents, so the rewriting is repeated until nothing changes (a
+ * fixpoint), at most REWRITEPASSES times and as long as at most REWRITEBUDGET nodes
+ * have been made; the budget is also checked within a pass. Coefficients are computed
+ * in double precision, and E/E is rewritten to 1 without checking that E is not 0.
+ */
+
+#include <stdlib.h> /* malloc, realloc, free, qsort */
+#include <stdint.h> /* int64_t */
+#include <math.h>   /* fabs, floor */
+#include <assert.h> /* assert */
+#include "scanner.h"
+#include "infixExp.h"
+#include "rewrite.h"
+
+#define EXACTINTEGER 9007199254740992.0 /* 2^53: below this a double is an exact integer */
+
+/* The functions isConstant and constantValue deal with number nodes.
+ */
+
+int isConstant(ExpTree tr) {
+  return (tr != NULL && (tr->tt == Number || tr->tt == Real));
+}
+
+double constantValue(ExpTree tr) {
+  return numberValue(tr->tt, tr->t);
+}
+
+/* The function numberNode yields a node for the value v: a Number when v is an integer,
+ * and a Real otherwise.
+ */
+
+ExpTree numberNode(double v) {
+  Token t;
+  if (v == floor(v) && fabs(v) < EXACTINTEGER) {
+    t.number = (int64_t)v;
+    return newExpTreeNode(Number, t, NULL, NULL);
+  }
+  t.real = v;
+  return newExpTreeNode(Real, t, NULL, NULL);
+}
+
+ExpTree symbolNode(char symbol, ExpTree left, ExpTree right) {
+  Token t;
+  t.symbol = symbol;
+  return newExpTreeNode(Symbol, t, left, right);
+}
+
+void addTerm(Terms *ts, ExpTree base, double value) {
+  if (ts->size >= ts->capacity) {
+    ts->capacity = 2*ts->capacity + 8;
+    ts->terms = realloc(ts->terms,ts->capacity*sizeof(Term));
+    assert( ts->terms != NULL );
+  }
+  ts->terms[ts->size].base = base;
+  ts->terms[ts->size].value = value;
+  ts->size++;
+}
+
+/* The function compareTerms orders terms by the id of their base, with the constant
+ * part (base NULL) last.
+ */
+
+int compareTerms(const void *x, const void *y) {
+  const Term *a = x, *b = y;
+  if (a->base == b->base) {
+    return 0;
+  }
+  if (a->base == NULL || b->base == NULL) {
+    return (a->base == NULL ? 1 : -1);
+  }
+  return (a->base->id < b->base->id ? -1 : 1);
+}
+
+/* The function combineTerms sorts the terms and adds the values of terms with the same
+ * base. Terms with value 0 are dropped, except a constant part.
+ */
+
+void combineTerms(Terms *ts) {
+  int k, n = 0;
+  qsort(ts->terms,ts->size,sizeof(Term),compareTerms);
+  for (k = 0; k < ts->size; k++) {
+    if (n > 0 && ts->terms[n-1].base == ts->terms[k].base) {
+      ts->terms[n-1].value += ts->terms[k].value;
+    } else {
+      ts->terms[n++] = ts->terms[k];
+    }
+  }
+  ts->size = 0;
+  for (k = 0; k < n; k++) {
+    if (ts->terms[k].value != 0 || ts->terms[k].base == NULL) {
+      ts->terms[ts->size++] = ts->terms[k];
+    }
+  }
+}
+
+/* The function scaled yields c*tr in normal form: tr for c = 1, tr/k when c = 1/k for an
+ * integer k other than 1 and -1, and c*tr otherwise.
+ */
+
+ExpTree scaled(double c, ExpTree tr) {
+  if (c == 1) {
+    return tr;
+  }
+  if (c != 0 && fabs(c) < 1 && 1/c == floor(1/c) && fabs(1/c) < EXACTINTEGER) {
+    return symbolNode('/', tr, numberNode(1/c));
+  }
+  return symbolNode('*', numberNode(c), tr);
+}
+
+/* The function splitTerm writes a rewritten node as c*E; E is NULL for a constant.
+ * A chain (...(E / c1) / ...) / ck of divisions by constants is followed down to E.
+ */
+
+void splitTerm(ExpTree tr, double *cp, ExpTree *ep) {
+  double divisor = 1;
+  while (tr->tt == Symbol && tr->t.symbol == '/' && isConstant(tr->right)
+         && constantValue(tr->right) != 0) {
+    divisor *= constantValue(tr->right);
+    tr = tr->left;
+  }
+  if (isConstant(tr)) {
+    *cp = constantValue(tr);
+    *ep = NULL;
+  } else if (tr->tt == Symbol && tr->t.symbol == '*' && isConstant(tr->left)) {
+    *cp = constantValue(tr->left);
+    *ep = tr->right;
+  } else {
+    *cp = 1;
+    *ep = tr;
+  }
+  *cp /= divisor;
+}
+
+/* The function chainKind yields '+' for a node + or -, '*' for a node * or /, and 0
+ * for any other node.
+ */
+
+char chainKind(ExpTree tr) {
+  if (tr == NULL || tr->tt != Symbol) {
+    return 0;
+  }
+  return (tr->t.symbol == '+' || tr->t.symbol == '-' ? '+' : '*');
+}
+
+/* A pass rewrites a chain of one kind only at its root, and not at every node of it,
+ * which would take time quadratic in the length of the chain. mark[id] is 1 for a node
+ * inside a chain: its only parent is of the same kind. The function isChainRoot tells
+ * whether a node is rewritten by itself: it is not inside a chain, or it is an
+ * operation on two constants, which is computed exactly (see foldConstants).
+ */
+
+int isChainRoot(ExpTree tr, const char *mark) {
+  return mark[tr->id] != 1 || (isConstant(tr->left) && isConstant(tr->right));
+}
+
+/* The function collectSum adds the terms of the sum tr to ts. The chain of + and - is
+ * walked with the stack s, down to the roots of other chains, for which the result of
+ * the pass in memo is taken; when that is a sum again, it is walked as well. The
+ * state of a frame is the sign of its node, times 2 for a node of a result.
+ */
+
+void collectSum(ExpTree tr, Terms *ts, TreeStack *s, ExpTree *memo, const char *mark) {
+  ExpTree root = tr, e;
+  double c;
+  int sg, result;
+  s->size = 0;
+  pushTree(s, tr, 1);
+  while (s->size > 0) {
+    s->size--;
+    tr = s->frames[s->size].tree;
+    sg = (s->frames[s->size].state < 0 ? -1 : 1);
+    result = (abs(s->frames[s->size].state) == 2);
+    if (!result) {
+      if (tr == root || (chainKind(tr) == '+' && !isChainRoot(tr, mark))) {
+        pushTree(s, tr->right, (tr->t.symbol == '-' ? -sg : sg));
+        pushTree(s, tr->left, sg);
+        continue;
+      }
+      tr = memo[tr->id];
+    }
+    if (chainKind(tr) == '+') {
+      pushTree(s, tr->right, 2*(tr->t.symbol == '-' ? -sg : sg));
+      pushTree(s, tr->left, 2*sg);
+      continue;
+    }
+    splitTerm(tr, &c, &e);
+    addTerm(ts, e, sg*c);
+  }
+}
+
+/* The function rewriteSum rewrites a sum: the terms in order, with - for a negative
+ * coefficient (except in front), and the constant last.
+ */
+
+ExpTree rewriteSum(ExpTree tr, Terms *ts, TreeStack *s, ExpTree *memo, const char *mark) {
+  ExpTree result = NULL, term;
+  double c;
+  int k;
+  ts->size = 0;
+  collectSum(tr, ts, s, memo, mark);
+  combineTerms(ts);
+  for (k = 0; k < ts->size; k++) {
+    c = ts->terms[k].value;
+    if (ts->terms[k].base == NULL) {
+      if (c == 0 && result != NULL) {
+        continue;
+      }
+      term = numberNode(result != NULL && c < 0 ? -c : c);
+    } else {
+      term = scaled(result != NULL && c < 0 ? -c : c, ts->terms[k].base);
+    }
+    result = (result == NULL ? term : symbolNode((c < 0 ? '-' : '+'), result, term));
+  }
+  return (result == NULL ? numberNode(0) : result);
+}
+
+/* The function collectProduct adds the factors of the product tr to ts; constant
+ * factors are multiplied into *cp (except a division by 0). The chain of * and / is
+ * walked as the chain of + and - in collectSum.
+ */
+
+void collectProduct(ExpTree tr, Terms *ts, double *cp, TreeStack *s, ExpTree *memo,
+                    const char *mark) {
+  ExpTree root = tr;
+  int sg, result;
+  s->size = 0;
+  pushTree(s, tr, 1);
+  while (s->size > 0) {
+    s->size--;
+    tr = s->frames[s->size].tree;
+    sg = (s->frames[s->size].state < 0 ? -1 : 1);
+    result = (abs(s->frames[s->size].state) == 2);
+    if (!result) {
+      if (tr == root || (chainKind(tr) == '*' && !isChainRoot(tr, mark))) {
+        pushTree(s, tr->right, (tr->t.symbol == '/' ? -sg : sg));
+        pushTree(s, tr->left, sg);
+        continue;
+      }
+      tr = memo[tr->id];
+    }
+    if (chainKind(tr) == '*') {
+      pushTree(s, tr->right, 2*(tr->t.symbol == '/' ? -sg : sg));
+      pushTree(s, tr->left, 2*sg);
+      continue;
+    }
+    if (isConstant(tr) && (sg > 0 || constantValue(tr) != 0)) {
+      *cp = (sg > 0 ? *cp * constantValue(tr) : *cp / constantValue(tr));
+      continue;
+    }
+    addTerm(ts, tr, sg);
+  }
+}
+
+/* The function power appends base^k (k > 0) to the product result (which may be NULL).
+ */
+
+ExpTree power(ExpTree result, ExpTree base, int k) {
+  for (; k > 0; k--) {
+    result = (result == NULL ? base : symbolNode('*', result, base));
+  }
+  return result;
+}
+
+/* The function rewriteProduct rewrites a product: the constant, times the factors with
+ * a positive power, divided by the product of the factors with a negative power.
+ */
+
+ExpTree rewriteProduct(ExpTree tr, Terms *ts, TreeStack *s, ExpTree *memo,
+                       const char *mark) {
+  ExpTree numerator = NULL, denominator = NULL;
+  double c = 1;
+  int k;
+  ts->size = 0;
+  collectProduct(tr, ts, &c, s, memo, mark);
+  if (c == 0) {
+    return numberNode(0);
+  }
+  combineTerms(ts);
+  for (k = 0; k < ts->size; k++) {
+    if (ts->terms[k].value > 0) {
+      numerator = power(numerator, ts->terms[k].base, (int)ts->terms[k].value);
+    } else {
+      denominator = power(denominator, ts->terms[k].base, (int)-ts->terms[k].value);
+    }
+  }
+  if (numerator == NULL) {
+    return (denominator == NULL ? numberNode(c) : symbolNode('/', numberNode(c), denominator));
+  }
+  if (denominator != NULL) {
+    numerator = symbolNode('/', numerator, denominator);
+  }
+  return scaled(c, numerator);
+}
+
+/* The function foldConstants computes an operation on two constants. Numbers give a
+ * Number when the result fits; a division by 0 is not computed (the result is NULL).
+ */
+
+ExpTree foldConstants(char symbol, ExpTree left, ExpTree right) {
+  Token t;
+  double l = constantValue(left), r = constantValue(right);
+  if (left->tt == Number && right->tt == Number) {
+    int64_t a = left->t.number, b = right->t.number;
+    switch (symbol) {
+    case '+':
+      if (!__builtin_add_overflow(a, b, &t.number)) {
+        return newExpTreeNode(Number, t, NULL, NULL);
+      }
+      break;
+    case '-':
+      if (!__builtin_sub_overflow(a, b, &t.number)) {
+        return newExpTreeNode(Number, t, NULL, NULL);
+      }
+      break;
+    case '*':
+      if (!__builtin_mul_overflow(a, b, &t.number)) {
+        return newExpTreeNode(Number, t, NULL, NULL);
+      }
+      break;
+    }
+  }
+  switch (symbol) {
+  case '+':
+    return numberNode(l + r);
+  case '-':
+    return numberNode(l - r);
+  case '*':
+    return numberNode(l * r);
+  default:
+    return (r == 0 ? NULL : numberNode(l / r));
+  }
+}
+
+/* The function rewritePass makes one bottom-up pass over the DAG tr, over its nodes in
+ * post-order; memo[id] holds the result for the node with that id, for every node
+ * that is not inside a chain (see isChainRoot). The nodes inside a chain are marked
+ * first. The result is NULL when more than REWRITEBUDGET nodes have been made since
+ * first, the number of nodes before the first pass.
+ */
+
+ExpTree rewritePass(ExpTree tr, Terms *ts, TreeStack *s, int first) {
+  ExpTree *memo = newMemo();
+  ExpTree *nodes, node, child, result;
+  char *mark = calloc(expTreeNodeCount()+1, 1);
+  int count, k, side;
+  assert( mark != NULL );
+  nodes = postOrder(tr, &count);
+  for (k = 0; k < count; k++) {
+    node = nodes[k];
+    for (side = 0; side < 2 && node->tt == Symbol; side++) {
+      child = (side == 0 ? node->left : node->right);
+      if (child->tt == Symbol) {
+        mark[child->id] = (mark[child->id] == 0 && chainKind(child) == chainKind(node) ? 1 : 2);
+      }
+    }
+  }
+  for (k = 0; k < count; k++) {
+    node = nodes[k];
+    if (node->tt != Symbol) {
+      memo[node->id] = node;
+      continue;
+    }
+    if (!isChainRoot(node, mark)) {
+      continue;
+    }
+    if (expTreeNodeCount() - first > REWRITEBUDGET) {
+      free(nodes);
+      free(mark);
+      return NULL;
+    }
+    result = NULL;
+    if (isConstant(node->left) && isConstant(node->right)) {
+      result = foldConstants(node->t.symbol, node->left, node->right);
+    }
+    if (result == NULL) {
+      if (chainKind(node) == '+') {
+        result = rewriteSum(node, ts, s, memo, mark);
+      } else {
+        result = rewriteProduct(node, ts, s, memo, mark);
+      }
+    }
+    memo[node->id] = result;
+  }
+  free(nodes);
+  free(mark);
+  return memo[tr->id];
+}
+
+/* The function rewriteExpTree rewrites tr until it does not change any more, or the
+ * number of passes or the number of new nodes exceeds its budget; a pass that exceeds
+ * the budget is given up, and the result of the pass before it is kept.
+ */
+
+ExpTree rewriteExpTree(ExpTree tr) {
+  Terms ts;
+  TreeStack s;
+  int first = expTreeNodeCount();
+  int pass;
+  ExpTree next;
+  ts.terms = NULL;
+  ts.size = 0;
+  ts.capacity = 0;
+  initTreeStack(&s);
+  for (pass = 0; pass < REWRITEPASSES; pass++) {
+    next = rewritePass(tr, &ts, &s, first);
+    if (next == NULL || next == tr) {
+      break;
+    }
+    tr = next;
+  }
+  free(ts.terms);
+  freeTreeStack(&s);
+  return tr;
+}
@@ -0,0 +1,28 @@
+/* rewrite.h */
+
+#ifndef REWRITE_H
+#define REWRITE_H
+
+#define REWRITEPASSES 32       /* maximal number of passes of rewriteExpTree */
+#define REWRITEBUDGET 1000000  /* maximal number of nodes made by rewriteExpTree */
+
+/* A term of a sum (a coefficient times base) or a factor of a product (base to the
+ * power value); base NULL stands for the constant part.
+ */
+
+typedef struct Term {
+  ExpTree base;
+  double value;
+} Term;
+
+typedef struct Terms {
+  Term *terms;
+  int size;
+  int capacity;
+} Terms;
+
+ExpTree numberNode(double v);
+ExpTree symbolNode(char symbol, ExpTree left, ExpTree right);
+ExpTree rewriteExpTree(ExpTree tr);
+
+#endif
@@ -6,49 +6,181 @@
  * A token is: a number, an identifier or a symbol.
  */
 
-#include <stdio.h>  /* getchar, printf */
+#include <stdio.h>  /* fprintf */
 #include <stdlib.h> /* NULL, malloc, free */
-#include <string.h> /* strcpy */
-#include <ctype.h>  /* isspace, isdigit, isalpha, isalnum */
+#include <unistd.h> /* STDIN_FILENO, STDOUT_FILENO */
+#include <string.h> /* strlen, memcpy, strerror */
+#include <stdint.h> /* int64_t, uint64_t, INT64_MAX */
+#include <float.h>  /* DBL_MAX */
+#include <math.h>   /* isinf */
 #include <assert.h> /* assert */
+#include "arena.h"
+#include "charClass.h"
+#include "intern.h"
+#include "lineReader.h"
 #include "scanner.h"
+#include "stats.h"
 
-/* The function readInput reads the input and yields a string containing this input. 
- * Initially, the length of s is MAXINPUT: it is doubled when necessary.
+/* The nodes of the token lists and the strings of the identifiers are not allocated
+ * one by one, but in the arena tokenArena. They are all freed at once by resetTokens.
  */
 
-char *readInput() { 
-  int strLen = MAXINPUT;
-  int c = getchar();
-  int i = 0;
-  char *s = malloc((strLen+1)*sizeof(char));
-  assert( s != NULL );
-  while ( c != '\n' ) {
-    s[i] = c;
-    i++;
-    if ( i >= strLen ) { /* s is not large enough, its length is doubled */
-      strLen = 2*strLen;
-      s = realloc(s,(strLen+1)*sizeof(char));
-      assert( s != NULL );
+static Arena tokenArena;
+
+/* The names of all identifiers are interned in the table identifiers, which lives as
+ * long as the program: an identifier that has been seen before is never stored again,
+ * and two identifiers are the same when their ids are the same.
+ */
+
+static InternTable identifiers;
+
+/* The function readInput makes line a view of the next line of the input, without its
+ * line end; the view is valid until the next call. No line is copied: the input is
+ * mapped in memory when it is a regular file, and read in large blocks otherwise, by
+ * the line reader stdinReader. At the end of the input the result is 0; when the input
+ * ends by a read error, that is reported on stderr.
+ */
+
+static LineReader stdinReader;
+static int stdinOpened = 0;
+
+int readInput(LineView *line) {
+  int found;
+  STATS_START(start);
+  if (!stdinOpened) {
+    mapLineReader(&stdinReader,STDIN_FILENO);
+    stdinOpened = 1;
+  }
+  found = readLine(&stdinReader,line);
+  if (!found && stdinReader.error != 0) {
+    fprintf(stderr,"the input could not be read: %s\n",strerror(stdinReader.error));
+    stdinReader.error = 0;
+  }
+  STATS_STOP(PhaseRead,start);
+  STATS_COUNT(CountLines,found);
+  return found;
+}
+
+/* A number literal is an integer, or a real number:
+ *
+ * <number>   ::= <digits> [ '.' <digits> ] [ ( 'e' | 'E' ) [ '+' | '-' ] <digits> ]
+ *
+ * An exponent part is only recognized when its digits are present: in 2e, 2ex and
+ * 2e+x the e starts an identifier.
+ * Integers have 64 bits; reals are correctly rounded. A literal that is out of
+ * range is reported and saturated to the largest integer or real.
+ */
+
+#define MAXEXP 100000 /* larger exponents all overflow (or underflow) anyway */
+
+static const double powersOf10[] = {
+  1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,
+  1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22
+};
+
+/* The function reportOverflow reports the literal ar[start..end) as out of range.
+ */
+
+void reportOverflow(char *ar, int start, int end) {
+  fprintf(stderr,"number %.*s is out of range and has been saturated\n",end-start,ar+start);
+}
+
+/* The function realValue computes the real with the digits ar[start..intEnd) before the
+ * decimal point, ar[fracStart..fracEnd) after it, and exponent exp10.
+ * When the digits form an integer below 2^53 and the (adapted) exponent is at most 22,
+ * both are exact doubles, so one multiplication or division rounds correctly
+ * (the fast path of Clinger). Otherwise strtod, which rounds correctly too, is used.
+ */
+
+double realValue(char *ar, int start, int intEnd, int fracStart, int fracEnd, int end, int exp10) {
+  char buf[64];
+  char *copy = buf;
+  double d;
+  int fracLength = fracEnd - fracStart;
+  if ((intEnd - start) + fracLength <= 19) {
+    uint64_t m = digitsValue(ar,start,intEnd);
+    int k;
+    for (k = 0; k < fracLength; k++) {
+      m = 10*m;
+    }
+    m += digitsValue(ar,fracStart,fracEnd);
+    exp10 -= fracLength;
+    if (m <= ((uint64_t)1 << 53) && -22 <= exp10 && exp10 <= 22) {
+      return (exp10 < 0 ? (double)m / powersOf10[-exp10] : (double)m * powersOf10[exp10]);
     }
-    c = getchar();
   }
-  s[i] = '\0';
-  return s;
+  if (end - start >= (int)sizeof(buf)) {
+    copy = malloc(end-start+1);
+    assert( copy != NULL );
+  }
+  memcpy(copy,ar+start,end-start);
+  copy[end-start] = '\0';
+  d = strtod(copy,NULL);
+  if (copy != buf) {
+    free(copy);
+  }
+  return d;
 }
 
 /* The functions matchNumber, matchCharacter and matchIdentifier do what their name indicates
- * and yield what has been read. Their parameters are the array from which to read and a pointer
- * to an index in the array. The value of the index is adapted during reading.
+ * and yield what has been read; matchNumber stores the value in *tp and yields its type.
+ * Their parameters are the array from which to read, a pointer to an index in the array
+ * and the length of the array. The value of the index is adapted during reading.
+ * The ends of numbers and identifiers are found by the run functions of charClass.c.
  */
 
-int matchNumber(char *ar, int *ip) {
-  int n = 0;
-  while (isdigit(ar[*ip])) {
-    n = 10*n + (ar[*ip] - '0');
-    (*ip)++;
+TokenType matchNumber(char *ar, int *ip, int length, Token *tp) {
+  int start = *ip;
+  int intEnd = skipDigits(ar,start,length);
+  int fracStart = intEnd, fracEnd = intEnd;
+  int end = intEnd;
+  int exp10 = 0, isReal = 0, k, first;
+  if (end+1 < length && ar[end] == '.' && isDigitChar(ar[end+1])) {
+    fracStart = end+1;
+    fracEnd = skipDigits(ar,fracStart,length);
+    end = fracEnd;
+    isReal = 1;
+  }
+  if (end < length && (ar[end] == 'e' || ar[end] == 'E')) {
+    k = end+1;
+    if (k < length && (ar[k] == '+' || ar[k] == '-')) {
+      k++;
+    }
+    if (k < length && isDigitChar(ar[k])) {
+      int expEnd = skipDigits(ar,k,length);
+      while (k < expEnd) {
+        if (exp10 < MAXEXP) {
+          exp10 = 10*exp10 + (ar[k] - '0');
+        }
+        k++;
+      }
+      if (ar[end+1] == '-') {
+        exp10 = -exp10;
+      }
+      end = expEnd;
+      isReal = 1;
+    }
+  }
+  *ip = end;
+  if (isReal) {
+    tp->real = realValue(ar,start,intEnd,fracStart,fracEnd,end,exp10);
+    if (isinf(tp->real)) {
+      reportOverflow(ar,start,end);
+      tp->real = DBL_MAX;
+    }
+    return Real;
+  }
+  first = start;
+  while (first < intEnd-1 && ar[first] == '0') { /* leading zeros do not count */
+    first++;
+  }
+  if (intEnd - first > 19 || (intEnd - first == 19 && digitsValue(ar,first,intEnd) > INT64_MAX)) {
+    reportOverflow(ar,start,end);
+    tp->number = INT64_MAX;
+  } else {
+    tp->number = (int64_t)digitsValue(ar,first,intEnd);
   }
-  return n;
+  return Number;
 }
 
 char matchCharacter(char *ar, int *ip) {
@@ -57,111 +189,201 @@ char matchCharacter(char *ar, int *ip) {
   return s;
 }
 
-/* In matchIdentifier the length of the string is adapted whenver necessary, as in readInput.
+/* The function matchIdentifier yields the slice of the identifier, after interning it
+ * in the table it. The slice points to the interned name, not into ar.
  */
 
-char *matchIdentifier(char *ar, int *ip) { 
-  int j = 0;
-  int strLen = MAXIDENT;
-  char *s = malloc((strLen+1)*sizeof(char));
-  assert( s != NULL );
-  while (isalnum(ar[*ip+j])) {
-    s[j] = ar[*ip+j];
-    j++;    
-    if ( j >= strLen ) { /* s is not large enough, its length is doubled */
-      strLen = 2*strLen;
-      s = realloc(s,(strLen+1)*sizeof(char));
-      assert( s != NULL );
-    }
-  }
-  s[j] = '\0'; 
+Slice matchIdentifier(char *ar, int *ip, int length, InternTable *it) { 
+  Slice s;
+  int j = skipAlnum(ar,*ip,length) - *ip;
+  s.id = intern(it,ar+*ip,j);
+  s.start = internedName(it,s.id);
+  s.length = j;
   *ip = *ip + j;
   return s;
 }
 
+/* The function matchToken reads the token that starts at ar[*ip] and stores its type
+ * and value in *ttp and *tp. Identifiers are interned in the table it.
+ */
+
+void matchToken(char *ar, int *ip, int length, InternTable *it, TokenType *ttp, Token *tp) { /* precondition: !isSpaceChar(a[*ip]) */
+  if (isDigitChar(ar[*ip])) {   /* we see a digit, so a number starts here */
+    *ttp = matchNumber(ar,ip,length,tp);
+    return;
+  }
+  if (isLetterChar(ar[*ip])) { /* we see a letter, so an identifier starts here */
+    *ttp = Identifier;    
+    tp->identifier = matchIdentifier(ar,ip,length,it);
+    return;
+  }  /* no space, no number, no identifier: we call it a symbol */
+  *ttp = Symbol; 
+  tp->symbol = matchCharacter(ar,ip);
+}
+
 /* The function newNode makes a new node for the token list and fills it with the token that
  * has been read.
  */
 
-List newNode(char *ar, int *ip) { /* precondition: !isspace(a[*ip]) */
-  List node = malloc(sizeof(struct ListNode));
-  assert(node!=NULL);
+List newNode(char *ar, int *ip, int length, Arena *a, InternTable *it) { /* precondition: !isSpaceChar(a[*ip]) */
+  List node = arenaAlloc(a,sizeof(struct ListNode));
+  STATS_COUNT(CountTokens,1);
+  STATS_COUNT(CountTokenBytes,sizeof(struct ListNode));
   node->next = NULL;
-  if (isdigit(ar[*ip])) {   /* we see a digit, so a number starts here */
-    node->tt = Number;    
-    (node->t).number = matchNumber(ar,ip);
-    return node;
-  }
-  if (isalpha(ar[*ip])) { /* we see a letter, so an identifier starts here */
-    node->tt = Identifier;    
-    (node->t).identifier = matchIdentifier(ar,ip);
-    return node;
-  }  /* no space, no number, no identifier: we call it a symbol */
-  node->tt = Symbol; 
-  (node->t).symbol = matchCharacter(ar,ip);
+  matchToken(ar,ip,length,it,&(node->tt),&(node->t));
   return node;
 }
 
-/* The function tokenList reads an array and puts the tokens that are read in a list. 
+/* The function tokenListArena reads the first length characters of an array and puts
+ * the tokens that are read in a list, of which the nodes are allocated in the arena a.
+ * Identifiers are interned in the table it. The character ar[length] must not be a
+ * letter or a digit (it is e.g. '\0', or the line end in a line view).
  * The result is a pointer to the beginning of the list.
  */
 
-List tokenList(char *ar) {
+List tokenListArena(char *ar, int length, Arena *a, InternTable *it) {
   List lastNode = NULL;
   List node = NULL;
   List tl = NULL;
-  int i = 0;
-  int length = strlen(ar);
+  int i = skipSpaces(ar,0,length);   /* spaces are skipped */
+  STATS_START(start);
   while (i < length) {
-    if (isspace(ar[i])) {   /* spaces are skipped */
-      i++; 
-    } else {
-      node = newNode(ar,&i);
-      if (lastNode == NULL) { /* there is no list yet */
-        tl = node;
-      } else {            /* there is already a list; add node at the end */
-        (lastNode)->next = node;
-      }
-      lastNode = node;
+    node = newNode(ar,&i,length,a,it);
+    if (lastNode == NULL) { /* there is no list yet */
+      tl = node;
+    } else {            /* there is already a list; add node at the end */
+      (lastNode)->next = node;
     }
+    lastNode = node;
+    i = skipSpaces(ar,i,length);
   }
+  STATS_STOP(PhaseScan,start);
   return tl;
 }
 
-/* The function printList prints the tokens in a token list, separated by spaces.
+/* The function tokenList does the same in the arena of the scanner, with the intern
+ * table of the scanner, for a line view. The list remains valid until the next call
+ * of resetTokens.
  */
 
-void printList(List li) {
+List tokenList(LineView line) {
+  return tokenListArena(line.start,line.length,&tokenArena,&identifiers);
+}
+
+/* The function resetTokens frees all token lists made by tokenList in one step.
+ */
+
+void resetTokens() {
+  resetArena(&tokenArena);
+}
+
+/* The functions initTokenArray, tokenArrayTable, tokenArray and freeTokenArray deal
+ * with the flat representation of a token list: all tokens in one contiguous array.
+ * tokenArrayTable reads the first length characters of ar, like tokenListArena, and
+ * interns the identifiers in the table it; tokenArray reads a string, with the intern
+ * table of the scanner. Both overwrite the contents of ta, so its memory is reused
+ * line after line.
+ */
+
+void initTokenArray(TokenArray *ta) {
+  ta->tokens = NULL;
+  ta->size = 0;
+  ta->capacity = 0;
+}
+
+void tokenArrayTable(char *ar, int length, TokenArray *ta, InternTable *it) {
+  int i = 0;
+  STATS_START(start);
+  ta->size = 0;
+  i = skipSpaces(ar,i,length);   /* spaces are skipped */
+  while (i < length) {
+    if (ta->size >= ta->capacity) { /* the array is full, its capacity is doubled */
+      ta->capacity = (ta->capacity == 0 ? MAXINPUT : 2*ta->capacity);
+      ta->tokens = realloc(ta->tokens,ta->capacity*sizeof(FlatToken));
+      assert( ta->tokens != NULL );
+    }
+    matchToken(ar,&i,length,it,&(ta->tokens[ta->size].tt),&(ta->tokens[ta->size].t));
+    ta->size++;
+    i = skipSpaces(ar,i,length);
+  }
+  STATS_COUNT(CountTokens,ta->size);
+  STATS_COUNT(CountTokenBytes,ta->size*sizeof(FlatToken));
+  STATS_STOP(PhaseScan,start);
+}
+
+void tokenArray(char *ar, TokenArray *ta) {
+  tokenArrayTable(ar,strlen(ar),ta,&identifiers);
+}
+
+void freeTokenArray(TokenArray *ta) {
+  free(ta->tokens);
+  initTokenArray(ta);
+}
+
+/* The function tokenCursor yields a cursor that points to the first token of ta.
+ */
+
+TokenCursor tokenCursor(TokenArray *ta) {
+  TokenCursor c;
+  c.pos = ta->tokens;
+  c.end = ta->tokens + ta->size;
+  return c;
+}
+
+/* The function identifierId yields the id of the identifier name (interning it when it
+ * has not been seen yet), identifierCount the number of distinct identifiers so far,
+ * and identifierSlice the slice of the identifier with the given id.
+ */
+
+int identifierId(char *name) {
+  return intern(&identifiers,name,strlen(name));
+}
+
+int identifierCount() {
+  return identifiers.size;
+}
+
+Slice identifierSlice(int id) {
+  Slice s;
+  s.id = id;
+  s.start = internedName(&identifiers,id);
+  s.length = internedLength(&identifiers,id);
+  return s;
+}
+
+/* The function numberValue yields the value of a number or real token as a double.
+ */
+
+double numberValue(TokenType tt, Token t) {
+  return (tt == Real ? t.real : (double)t.number);
+}
+
+/* The function printList writes the tokens in a token list to the sink s, separated by
+ * spaces.
+ */
+
+void printList(Sink *s, List li) {
+  STATS_START(start);
   while (li != NULL) {
     switch (li->tt) {
     case Number: 
-      printf("%d ",(li->t).number);
+      sinkInt(s,(li->t).number);
+      break;
+    case Real: 
+      sinkGeneral(s,(li->t).real);
       break;
     case Identifier: 
-      printf("%s ",(li->t).identifier);
+      sinkBytes(s,(li->t).identifier.start,(li->t).identifier.length);
       break;
     case Symbol: 
-      printf("%c ",(li->t).symbol);
+      sinkChar(s,(li->t).symbol);
       break;
     }
+    sinkChar(s,' ');
     li = li->next;
   }
-  printf("\n");
-}
-
-/* The function freeTokenList frees the memory of the nodes of the list, and of the strings 
- * in the nodes.
- */
-
-void freeTokenList(List li) {
-  if (li == NULL) {
-    return;
-  }
-  if (li->tt == Identifier) {
-    free((li->t).identifier);
-  }
-  freeTokenList(li->next);
-  free(li);
+  sinkChar(s,'\n');
+  STATS_STOP(PhasePrint,start);
 }
 
 /* The next function definition is not in the lecture notes. It can be used 
@@ -169,19 +391,21 @@ void freeTokenList(List li) {
  */
 
 void scanExpressions() {
-  char *ar;
+  LineView line;
   List li;  
-  printf("give an expression: ");
-  ar = readInput();
-  while (ar[0] != '!') {
-    li = tokenList(ar); 
-    printList(li);
-    free(ar);
-    freeTokenList(li);
-    printf("\ngive an expression: ");
-    ar = readInput();
+  Sink out;
+  initSink(&out, STDOUT_FILENO);
+  sinkText(&out, "give an expression: ");
+  flushPrompt(&out);
+  while (readInput(&line) && line.start[0] != '!') {
+    li = tokenList(line); 
+    printList(&out, li);
+    resetTokens();
+    sinkText(&out, "\ngive an expression: ");
+    flushPrompt(&out);
   }
-  free(ar);
-  printf("good bye\n");
+  sinkText(&out, "good bye\n");
+  flushSink(&out);
+  freeSink(&out);
 }
 
@@ -3,28 +3,46 @@
 #ifndef SCANNER_H
 #define SCANNER_H
 
-#define MAXINPUT 100  /* maximal length of the input */
-#define MAXIDENT 10   /* maximal length of an identifier */
+#include <stdint.h> /* int64_t */
+
+#include "arena.h"
+#include "intern.h"
+#include "sink.h"
+#include "lineReader.h"
+
+#define MAXINPUT 100  /* initial number of tokens in a token array */
 
 /* Some type definitions:
- * tokenType with three values, to indicate the three types of tokens, viz. 
- * number, identifier and symbol;
+ * tokenType with four values, to indicate the types of tokens, viz. 
+ * number (an integer), real (a number with a decimal point or an exponent),
+ * identifier and symbol;
+ * the type slice for identifiers: the id of the identifier in the intern table of
+ * the scanner, and the start and the length of its (interned) name;
  * the union type token in which these types are unified;
  * the type list for lists with nodes that contain tokens.
  */
 
 typedef enum TokenType { 
   Number,
+  Real,
   Identifier,
   Symbol
 } TokenType;
 
+typedef struct Slice {
+  char *start;
+  int length;
+  int id;
+} Slice;
+
 typedef union Token {
-  int number;
-  char *identifier;
+  int64_t number;
+  double real;
+  Slice identifier;
   char symbol;
 } Token;
 
+
 typedef struct ListNode *List;
   
 typedef struct ListNode {
@@ -33,15 +51,93 @@ typedef struct ListNode {
   List next;
 } ListNode;
 
+/* The flat alternative for the token list: the tokens of a line in one array, and
+ * a cursor that points to the current token in such an array. The cursor is at the
+ * end of the tokens when pos == end.
+ */
+
+typedef struct FlatToken {
+  TokenType tt;
+  Token t;
+} FlatToken;
+
+typedef struct TokenArray {
+  FlatToken *tokens;
+  int size;
+  int capacity;
+} TokenArray;
+
+typedef struct TokenCursor {
+  FlatToken *pos;
+  FlatToken *end;
+} TokenCursor;
+
+/* A token source is a token list, or a cursor in a token array when pos is not NULL.
+ * The parser expressionNode and the analysis of equations read their tokens from a
+ * source, so that they are written once for both representations. The functions
+ * below tell whether the source is at its end, and give the current token and advance
+ * over it; they are inline, because they are called for every token.
+ */
+
+typedef struct TokenSource {
+  List list;
+  FlatToken *pos;
+  FlatToken *end;
+} TokenSource;
+
+static inline TokenSource listSource(List l) {
+  TokenSource s = { l, NULL, NULL };
+  return s;
+}
+
+static inline TokenSource cursorSource(TokenCursor c) {
+  TokenSource s = { NULL, c.pos, c.end };
+  return s;
+}
+
+static inline int sourceAtEnd(const TokenSource *s) {
+  return (s->pos != NULL ? s->pos == s->end : s->list == NULL);
+}
+
+static inline TokenType sourceType(const TokenSource *s) {
+  return (s->pos != NULL ? s->pos->tt : s->list->tt);
+}
+
+static inline Token *sourceToken(const TokenSource *s) {
+  return (s->pos != NULL ? &s->pos->t : &s->list->t);
+}
+
+static inline void sourceNext(TokenSource *s) {
+  if (s->pos != NULL) {
+    s->pos++;
+  } else {
+    s->list = s->list->next;
+  }
+}
+
+static inline int sourceSymbol(const TokenSource *s, char c) {
+  return !sourceAtEnd(s) && sourceType(s) == Symbol && sourceToken(s)->symbol == c;
+}
+
 /* Now the declaration of the functions that are defined in scanner.c
  * and are to be used outside it, e.g. in recognizeExp.c en in evalExp.c
  */
 
-char *readInput();
-List tokenList(char *array);
+int readInput(LineView *line);
+List tokenListArena(char *array, int length, Arena *a, InternTable *it);
+List tokenList(LineView line);
+void resetTokens();
+void initTokenArray(TokenArray *ta);
+void tokenArrayTable(char *array, int length, TokenArray *ta, InternTable *it);
+void tokenArray(char *array, TokenArray *ta);
+void freeTokenArray(TokenArray *ta);
+TokenCursor tokenCursor(TokenArray *ta);
 int valueNumber(List *lp, double *wp);
-void printList(List l);
-void freeTokenList(List l);
+int identifierId(char *name);
+int identifierCount();
+Slice identifierSlice(int id);
+double numberValue(TokenType tt, Token t);
+void printList(Sink *s, List l);
 void scanExpressions();
 
 #endif
@@ -0,0 +1,289 @@
+/* sink.c
+ *
+ * In this file the output sinks of sink.h are defined. Text is appended to the buffer
+ * of a sink with memcpy, and numbers are formatted here, without stdio: a sink is only
+ * written with write(2) when it is flushed. Numbers are formatted as printf would with
+ * "%" PRId64, "%.Nf" (sinkFixed) and "%g" (sinkGeneral). The decimal digits of a double
+ * are obtained by rounding it, times a power of ten, to an integer; the error of that
+ * multiplication (or division) is computed exactly with fma, so that the rounding is
+ * that of the exact value, with ties to even, as in printf. Only numbers for which
+ * this integer would not be exact (at least 2^52, or beyond the exact powers of ten)
+ * are formatted by snprintf.
+ */
+
+#include <stdio.h>  /* snprintf */
+#include <stdlib.h> /* realloc, free */
+#include <string.h> /* memcpy, strlen */
+#include <math.h>   /* fma, floor, fmod, log10, isnan, isinf, signbit */
+#include <unistd.h> /* write, isatty */
+#include <errno.h>  /* errno, EINTR */
+#include <assert.h> /* assert */
+#include "sink.h"
+#include "stats.h"
+
+#define EXACTSCALED 4503599627370496.0 /* 2^52: below this every double is exact in halves */
+
+static const double powersOfTen[23] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* The function initSink makes an empty sink to the file descriptor fd (or to memory,
+ * for fd -1), and freeSink frees its buffer (without flushing it).
+ */
+
+void initSink(Sink *s, int fd) {
+  s->buffer = NULL;
+  s->length = 0;
+  s->capacity = 0;
+  s->fd = fd;
+  s->interactive = (fd >= 0 && isatty(fd));
+}
+
+void freeSink(Sink *s) {
+  free(s->buffer);
+  s->buffer = NULL;
+  s->length = 0;
+  s->capacity = 0;
+}
+
+/* The function flushSink writes the buffer of a sink with a file descriptor, and empties
+ * it; flushPrompt does so only for a terminal, so that a prompt is seen before the
+ * input is read.
+ */
+
+void flushSink(Sink *s) {
+  size_t done = 0;
+  ssize_t n;
+  if (s->fd < 0) {
+    return;
+  }
+  STATS_START(start);
+  while (done < s->length) {
+    n = write(s->fd,s->buffer+done,s->length-done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break; /* the output is lost, as with a failing fwrite */
+    }
+    done += n;
+  }
+  STATS_STOP(PhaseWrite,start);
+  s->length = 0;
+}
+
+void flushPrompt(Sink *s) {
+  if (s->interactive) {
+    flushSink(s);
+  }
+}
+
+/* The function reserve makes room for n more bytes: a sink with a file descriptor is
+ * flushed when it would exceed SINKBUFFER, the buffer grows when needed.
+ */
+
+void reserve(Sink *s, size_t n) {
+  if (s->fd >= 0 && s->length + n > SINKBUFFER) {
+    flushSink(s);
+  }
+  if (s->length + n > s->capacity) {
+    s->capacity = 2*s->capacity + n + 16;
+    s->buffer = realloc(s->buffer,s->capacity);
+    assert( s->buffer != NULL );
+  }
+}
+
+/* The function sinkContents yields the text in a memory sink as a string, which stays
+ * valid until the next output to the sink.
+ */
+
+char *sinkContents(Sink *s) {
+  reserve(s,1);
+  s->buffer[s->length] = '\0';
+  return s->buffer;
+}
+
+/* The functions sinkBytes, sinkChar and sinkText append n bytes, a character and a
+ * string.
+ */
+
+void sinkBytes(Sink *s, const char *p, size_t n) {
+  reserve(s,n);
+  memcpy(s->buffer+s->length,p,n);
+  s->length += n;
+}
+
+void sinkChar(Sink *s, char c) {
+  if (s->length >= s->capacity || (s->fd >= 0 && s->length >= SINKBUFFER)) {
+    reserve(s,1);
+  }
+  s->buffer[s->length++] = c;
+}
+
+void sinkText(Sink *s, const char *text) {
+  sinkBytes(s,text,strlen(text));
+}
+
+/* The function sinkUnsigned appends the decimal digits of u, at least width of them.
+ */
+
+void sinkUnsigned(Sink *s, uint64_t u, int width) {
+  char digits[24];
+  int n = 0;
+  do {
+    digits[sizeof(digits) - ++n] = '0' + u % 10;
+    u /= 10;
+  } while (u > 0);
+  while (n < width) {
+    digits[sizeof(digits) - ++n] = '0';
+  }
+  sinkBytes(s,digits+sizeof(digits)-n,n);
+}
+
+void sinkInt(Sink *s, int64_t v) {
+  if (v < 0) {
+    sinkChar(s,'-');
+    sinkUnsigned(s,-(uint64_t)v,1);
+  } else {
+    sinkUnsigned(s,v,1);
+  }
+}
+
+/* The function roundScaled yields the integer nearest to a*10^k (a >= 0, |k| <= 22,
+ * and the result below 2^52), with ties to even. a*10^k is p + e exactly, where p is
+ * the rounded product or quotient and e its error.
+ */
+
+uint64_t roundScaled(double a, int k) {
+  double p, e, f, d;
+  if (k >= 0) {
+    p = a * powersOfTen[k];
+    e = fma(a,powersOfTen[k],-p);
+  } else {
+    d = powersOfTen[-k];
+    p = a / d;
+    e = -fma(p,d,-a) / d;
+  }
+  f = floor(p);
+  d = p - f; /* exact, and a multiple of the spacing of p, so only 0.5 is a tie */
+  if (d > 0.5 || (d == 0.5 && (e > 0 || (e == 0 && fmod(f,2) != 0)))) {
+    f += 1;
+  }
+  return (uint64_t)f;
+}
+
+/* The function sinkSpecial appends nan or inf, and yields 1, when v is one of these.
+ */
+
+int sinkSpecial(Sink *s, double v, int plus) {
+  if (!isnan(v) && !isinf(v)) {
+    return 0;
+  }
+  if (signbit(v)) {
+    sinkChar(s,'-');
+  } else if (plus) {
+    sinkChar(s,'+');
+  }
+  sinkText(s,(isnan(v) ? "nan" : "inf"));
+  return 1;
+}
+
+/* The function sinkFixed appends v with the given number of decimals, as "%.Nf" (or
+ * "%+.Nf" when plus is 1).
+ */
+
+void sinkFixed(Sink *s, double v, int decimals, int plus) {
+  char text[512];
+  uint64_t m, unit;
+  double a = fabs(v);
+  int k;
+  if (sinkSpecial(s,v,plus)) {
+    return;
+  }
+  if (decimals > 22 || a * powersOfTen[decimals] >= EXACTSCALED) {
+    snprintf(text,sizeof(text),(plus ? "%+.*f" : "%.*f"),decimals,v);
+    sinkText(s,text);
+    return;
+  }
+  m = roundScaled(a,decimals);
+  for (unit = 1, k = 0; k < decimals; k++) {
+    unit *= 10;
+  }
+  if (signbit(v)) {
+    sinkChar(s,'-');
+  } else if (plus) {
+    sinkChar(s,'+');
+  }
+  sinkUnsigned(s,m / unit,1);
+  if (decimals > 0) {
+    sinkChar(s,'.');
+    sinkUnsigned(s,m % unit,decimals);
+  }
+}
+
+/* The function sinkGeneral appends v as "%g": 6 significant digits without trailing
+ * zeros, in exponent notation when the exponent X is below -4 or at least 6. The digits
+ * are m = v*10^(5-X) rounded, with 100000 <= m < 1000000.
+ */
+
+void sinkGeneral(Sink *s, double v) {
+  char text[32], digits[6];
+  uint64_t m;
+  int x, k, last;
+  double a = fabs(v);
+  if (sinkSpecial(s,v,0)) {
+    return;
+  }
+  if (signbit(v)) {
+    sinkChar(s,'-');
+  }
+  if (a == 0) {
+    sinkChar(s,'0');
+    return;
+  }
+  x = (int)floor(log10(a));
+  for (;;) {
+    if (x - 5 > 22 || 5 - x > 22) {
+      snprintf(text,sizeof(text),"%g",a);
+      sinkText(s,text);
+      return;
+    }
+    m = roundScaled(a,5-x);
+    if (m >= 1000000) {
+      x++;
+    } else if (m < 100000) {
+      x--;
+    } else {
+      break;
+    }
+  }
+  for (k = 5; k >= 0; k--) {
+    digits[k] = '0' + m % 10;
+    m /= 10;
+  }
+  for (last = 5; last > 0 && digits[last] == '0'; last--) {
+  }
+  if (x < -4 || x >= 6) {
+    sinkChar(s,digits[0]);
+    if (last > 0) {
+      sinkChar(s,'.');
+      sinkBytes(s,digits+1,last);
+    }
+    sinkChar(s,'e');
+    sinkChar(s,(x < 0 ? '-' : '+'));
+    sinkUnsigned(s,(x < 0 ? -x : x),2);
+  } else if (x >= 0) {
+    sinkBytes(s,digits,x+1);
+    if (last > x) {
+      sinkChar(s,'.');
+      sinkBytes(s,digits+x+1,last-x);
+    }
+  } else {
+    sinkText(s,"0.");
+    for (k = 0; k < -x-1; k++) {
+      sinkChar(s,'0');
+    }
+    sinkBytes(s,digits,last+1);
+  }
+}
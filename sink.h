@@ -0,0 +1,37 @@
+/* sink.h */
+
+#ifndef SINK_H
+#define SINK_H
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* int64_t */
+
+#define SINKBUFFER (1 << 16) /* a sink to a file descriptor is flushed at this size */
+
+/* An output sink: text is appended to a growable buffer. A sink with a file descriptor
+ * writes the buffer to it when it is flushed (explicitly, or when it is full); a sink
+ * with fd -1 keeps all text in memory, as a string (see sinkContents).
+ * interactive is 1 when fd is a terminal; then flushPrompt flushes.
+ */
+
+typedef struct Sink {
+  char *buffer;
+  size_t length;
+  size_t capacity;
+  int fd;
+  int interactive;
+} Sink;
+
+void initSink(Sink *s, int fd);
+void freeSink(Sink *s);
+void flushSink(Sink *s);
+void flushPrompt(Sink *s);
+char *sinkContents(Sink *s);
+void sinkBytes(Sink *s, const char *p, size_t n);
+void sinkChar(Sink *s, char c);
+void sinkText(Sink *s, const char *text);
+void sinkInt(Sink *s, int64_t v);
+void sinkFixed(Sink *s, double v, int decimals, int plus);
+void sinkGeneral(Sink *s, double v);
+
+#endif
@@ -0,0 +1,680 @@
+/* sparsePoly.c
+ *
+ * In this file polynomials in several variables are represented as sorted arrays of
+ * terms (see sparsePoly.h), and added, multiplied, differentiated and evaluated in that
+ * form. An expression tree that is a polynomial (built from numbers, identifiers, +, -,
+ * * and division by a number) is converted to this form and back; this gives its
+ * expanded normal form. In a tree that is not a polynomial, the largest subtrees that
+ * are polynomials are converted, and the rest is left as it is. simplifyPolynomials
+ * only uses the normal form of a subtree when it has no more distinct nodes than the
+ * subtree, so that e.g. a power of x+1 written as a product is not expanded.
+ * The functions that combine polynomials yield 0 when the result would have more than
+ * POLYVARIABLES variables, a larger exponent than POLYEXPONENT, or more than POLYTERMS
+ * terms; conversion then fails, and the tree is handled as a tree.
+ */
+
+#include <stdlib.h> /* malloc, calloc, realloc, free, qsort */
+#include <string.h> /* memcpy */
+#include <assert.h> /* assert */
+#include "scanner.h"
+#include "infixExp.h"
+#include "rewrite.h"
+#include "sparsePoly.h"
+
+/* The functions variableShift and variableExponent give the place and the exponent of
+ * variable k in a monomial.
+ */
+
+int variableShift(int k) {
+  return 8*(POLYVARIABLES-1-k);
+}
+
+int variableExponent(uint64_t monomial, int k) {
+  return (int)((monomial >> variableShift(k)) & 0xFF);
+}
+
+/* The function initSparsePoly makes the polynomial 0 without variables, and
+ * freeSparsePoly frees the memory of a polynomial.
+ */
+
+void initSparsePoly(SparsePoly *p) {
+  p->variableCount = 0;
+  p->terms = NULL;
+  p->size = 0;
+  p->capacity = 0;
+}
+
+void freeSparsePoly(SparsePoly *p) {
+  free(p->terms);
+  initSparsePoly(p);
+}
+
+void appendPolyTerm(SparsePoly *p, uint64_t monomial, double coefficient) {
+  if (p->size >= p->capacity) {
+    p->capacity = 2*p->capacity + 8;
+    p->terms = realloc(p->terms,p->capacity*sizeof(PolyTerm));
+    assert( p->terms != NULL );
+  }
+  p->terms[p->size].monomial = monomial;
+  p->terms[p->size].coefficient = coefficient;
+  p->size++;
+}
+
+/* The function startPoly empties result and gives it the variables of p.
+ */
+
+void startPoly(SparsePoly *result, const SparsePoly *p) {
+  result->size = 0;
+  result->variableCount = p->variableCount;
+  memcpy(result->variables,p->variables,p->variableCount*sizeof(int));
+}
+
+int comparePolyTerms(const void *x, const void *y) {
+  const PolyTerm *a = x, *b = y;
+  return (a->monomial > b->monomial ? -1 : (a->monomial < b->monomial));
+}
+
+/* The function normalizePoly sorts the terms, adds the coefficients of equal monomials
+ * and drops the terms with coefficient 0.
+ */
+
+void normalizePoly(SparsePoly *p) {
+  int k, n = 0;
+  qsort(p->terms,p->size,sizeof(PolyTerm),comparePolyTerms);
+  for (k = 0; k < p->size; k++) {
+    if (n > 0 && p->terms[n-1].monomial == p->terms[k].monomial) {
+      p->terms[n-1].coefficient += p->terms[k].coefficient;
+    } else {
+      p->terms[n++] = p->terms[k];
+    }
+  }
+  p->size = 0;
+  for (k = 0; k < n; k++) {
+    if (p->terms[k].coefficient != 0) {
+      p->terms[p->size++] = p->terms[k];
+    }
+  }
+}
+
+/* The function remapVariables gives p the variables vars (count of them), which must
+ * include the variables of p. The order of the terms does not change, because the
+ * order of the variables that p has does not change.
+ */
+
+void remapVariables(SparsePoly *p, const int *vars, int count) {
+  int place[POLYVARIABLES];
+  uint64_t m;
+  int k, j, t;
+  for (k = 0, j = 0; k < p->variableCount; k++) {
+    while (vars[j] != p->variables[k]) {
+      j++;
+    }
+    place[k] = j;
+  }
+  for (t = 0; t < p->size; t++) {
+    m = 0;
+    for (k = 0; k < p->variableCount; k++) {
+      m |= (uint64_t)variableExponent(p->terms[t].monomial,k) << variableShift(place[k]);
+    }
+    p->terms[t].monomial = m;
+  }
+  memcpy(p->variables,vars,count*sizeof(int));
+  p->variableCount = count;
+}
+
+/* The function alignVariables gives a and b the same variables: the union of theirs.
+ * The result is 0 when there are more than POLYVARIABLES of them.
+ */
+
+int alignVariables(SparsePoly *a, SparsePoly *b) {
+  int vars[2*POLYVARIABLES];
+  int i = 0, j = 0, n = 0;
+  while (i < a->variableCount || j < b->variableCount) {
+    if (j == b->variableCount || (i < a->variableCount && a->variables[i] < b->variables[j])) {
+      vars[n++] = a->variables[i++];
+    } else if (i == a->variableCount || b->variables[j] < a->variables[i]) {
+      vars[n++] = b->variables[j++];
+    } else {
+      vars[n++] = a->variables[i++];
+      j++;
+    }
+  }
+  if (n > POLYVARIABLES) {
+    return 0;
+  }
+  if (n != a->variableCount) {
+    remapVariables(a,vars,n);
+  }
+  if (n != b->variableCount) {
+    remapVariables(b,vars,n);
+  }
+  return 1;
+}
+
+/* The function addSparsePolys computes a + sign*b by merging the sorted terms.
+ * result must differ from a and b.
+ */
+
+int addSparsePolys(SparsePoly *a, SparsePoly *b, double sign, SparsePoly *result) {
+  int i = 0, j = 0;
+  double c;
+  if (!alignVariables(a,b) || a->size + b->size > POLYTERMS) {
+    return 0;
+  }
+  startPoly(result,a);
+  while (i < a->size || j < b->size) {
+    if (j == b->size || (i < a->size && a->terms[i].monomial > b->terms[j].monomial)) {
+      appendPolyTerm(result,a->terms[i].monomial,a->terms[i].coefficient);
+      i++;
+    } else if (i == a->size || b->terms[j].monomial > a->terms[i].monomial) {
+      appendPolyTerm(result,b->terms[j].monomial,sign*b->terms[j].coefficient);
+      j++;
+    } else {
+      c = a->terms[i].coefficient + sign*b->terms[j].coefficient;
+      if (c != 0) {
+        appendPolyTerm(result,a->terms[i].monomial,c);
+      }
+      i++;
+      j++;
+    }
+  }
+  return 1;
+}
+
+/* The function multiplySparsePolys computes a*b. result must differ from a and b.
+ * The largest exponent of a variable in a*b is the sum of the largest ones in a and b,
+ * so it is checked beforehand that no exponent can overflow into the next variable.
+ */
+
+int multiplySparsePolys(SparsePoly *a, SparsePoly *b, SparsePoly *result) {
+  int largest[POLYVARIABLES] = {0};
+  int i, j, k, e;
+  if (!alignVariables(a,b) || (long)a->size * b->size > POLYTERMS) {
+    return 0;
+  }
+  for (i = 0; i < a->size; i++) {
+    for (k = 0; k < a->variableCount; k++) {
+      e = variableExponent(a->terms[i].monomial,k);
+      largest[k] = (e > largest[k] ? e : largest[k]);
+    }
+  }
+  for (k = 0; k < b->variableCount; k++) {
+    e = 0;
+    for (j = 0; j < b->size; j++) {
+      e = (variableExponent(b->terms[j].monomial,k) > e ? variableExponent(b->terms[j].monomial,k) : e);
+    }
+    if (a->size > 0 && largest[k] + e > POLYEXPONENT) {
+      return 0;
+    }
+  }
+  startPoly(result,a);
+  for (i = 0; i < a->size; i++) {
+    for (j = 0; j < b->size; j++) {
+      appendPolyTerm(result,a->terms[i].monomial + b->terms[j].monomial,
+                     a->terms[i].coefficient * b->terms[j].coefficient);
+    }
+  }
+  normalizePoly(result);
+  return 1;
+}
+
+/* The function differentiateSparsePoly computes the derivative of p to the identifier
+ * with the given id. Lowering one exponent in all terms keeps them in order.
+ */
+
+void differentiateSparsePoly(const SparsePoly *p, int id, SparsePoly *result) {
+  int k = 0, t, e;
+  startPoly(result,p);
+  while (k < p->variableCount && p->variables[k] != id) {
+    k++;
+  }
+  if (k == p->variableCount) { /* p does not depend on id */
+    return;
+  }
+  for (t = 0; t < p->size; t++) {
+    e = variableExponent(p->terms[t].monomial,k);
+    if (e > 0) {
+      appendPolyTerm(result,p->terms[t].monomial - ((uint64_t)1 << variableShift(k)),
+                     e * p->terms[t].coefficient);
+    }
+  }
+}
+
+/* The function horner evaluates the terms from..to-1 of p, which have the same
+ * exponents for the variables before k, as a polynomial in variable k whose
+ * coefficients are polynomials in the variables after k (Horner scheme).
+ */
+
+double horner(const SparsePoly *p, int from, int to, int k, const double *bindings) {
+  double x, value = 0;
+  int last, e, next, i;
+  if (k == p->variableCount) {
+    return p->terms[from].coefficient;
+  }
+  x = bindings[p->variables[k]];
+  last = variableExponent(p->terms[from].monomial,k);
+  for (i = from; i < to; i = next) {
+    e = variableExponent(p->terms[i].monomial,k);
+    for (; last > e; last--) {
+      value *= x;
+    }
+    next = i + 1;
+    while (next < to && variableExponent(p->terms[next].monomial,k) == e) {
+      next++;
+    }
+    value += horner(p,i,next,k+1,bindings);
+  }
+  for (; last > 0; last--) {
+    value *= x;
+  }
+  return value;
+}
+
+/* The function valueSparsePoly computes the value of p, where bindings[id] is the value
+ * of the identifier with that id.
+ */
+
+double valueSparsePoly(const SparsePoly *p, const double *bindings) {
+  return (p->size == 0 ? 0 : horner(p,0,p->size,0,bindings));
+}
+
+/* The function addPolyVariable adds the id of an identifier to vars (count of them, in
+ * increasing order), but no more than POLYVARIABLES; the result is 0 when there are more.
+ */
+
+int addPolyVariable(int id, int *vars, int *count) {
+  int k;
+  for (k = *count; k > 0 && vars[k-1] > id; k--) {
+  }
+  if (k > 0 && vars[k-1] == id) {
+    return 1;
+  }
+  if (*count == POLYVARIABLES) {
+    return 0;
+  }
+  memmove(vars+k+1,vars+k,(*count-k)*sizeof(int));
+  vars[k] = id;
+  (*count)++;
+  return 1;
+}
+
+/* The conversion of a tree with ids below nodes: its nodes in post-order (see postOrder)
+ * are order[0..count-1], and polys[id] is the polynomial of the node with that id, or
+ * NULL when the node is no polynomial. All polynomials have the variables of the whole
+ * tree. parents[id] counts the parents of the node that have not been converted yet, and kept[id] is set when one of them is no
+ * polynomial: the polynomial of a node is freed (or taken over by its parent) after its
+ * last parent, unless it is kept, so that a chain of n operations does not hold n
+ * polynomials. A sum takes over the polynomial of an operand (the larger one, when
+ * both can be taken over) and appends the terms of the other one; unsorted[id] is
+ * then set, and the terms are only sorted (by normalizePoly) when the polynomial is
+ * used otherwise, which keeps a long sum linear.
+ */
+
+typedef struct Conversion {
+  int nodes;
+  ExpTree *order;
+  int count;
+  SparsePoly **polys;
+  int *parents;
+  char *kept;
+  char *unsorted;
+  int *seen;
+  int seenCapacity;
+  int stamp;
+  TreeStack stack;
+  int variableCount;
+  int variables[POLYVARIABLES];
+} Conversion;
+
+/* The function sortedPoly yields the polynomial of tr, with its terms sorted.
+ */
+
+SparsePoly *sortedPoly(ExpTree tr, Conversion *cv) {
+  if (cv->unsorted[tr->id]) {
+    normalizePoly(cv->polys[tr->id]);
+    cv->unsorted[tr->id] = 0;
+  }
+  return cv->polys[tr->id];
+}
+
+/* The function reusable tells whether the polynomial of the child of a node may be
+ * taken over by the node: the node is its last parent, and none was no polynomial.
+ */
+
+int reusable(ExpTree child, ExpTree other, Conversion *cv) {
+  return (child != other && cv->parents[child->id] == 1 && !cv->kept[child->id]);
+}
+
+/* The function addInPlace converts the sum (sign 1) or difference (sign -1) tr of the
+ * polynomials of its children, by appending the terms of the child other to the
+ * polynomial of the child taken, which tr takes over. The result is NULL when the sum
+ * would have more than POLYTERMS terms.
+ */
+
+SparsePoly *addInPlace(ExpTree tr, ExpTree taken, ExpTree other, double sign, Conversion *cv) {
+  SparsePoly *p = cv->polys[taken->id], *q = cv->polys[other->id];
+  int k;
+  if (p->size + q->size > POLYTERMS) {
+    p = sortedPoly(taken,cv);
+    q = sortedPoly(other,cv);
+    if (p->size + q->size > POLYTERMS) {
+      return NULL;
+    }
+  }
+  for (k = 0; k < q->size; k++) {
+    appendPolyTerm(p,q->terms[k].monomial,sign*q->terms[k].coefficient);
+  }
+  cv->polys[taken->id] = NULL;
+  cv->unsorted[tr->id] = (q->size > 0 || cv->unsorted[taken->id]);
+  return p;
+}
+
+/* The function convertNode converts one node, after its children.
+ */
+
+SparsePoly *convertNode(ExpTree tr, Conversion *cv) {
+  SparsePoly *p, *left = NULL, *right = NULL;
+  int ok = 1, k;
+  double c;
+  if (tr->tt == Symbol) {
+    left = cv->polys[tr->left->id];
+    right = cv->polys[tr->right->id];
+    if (left == NULL || right == NULL) {
+      return NULL;
+    }
+    if ((tr->t).symbol == '+' && reusable(tr->right,tr->left,cv)
+        && (right->size > left->size || !reusable(tr->left,tr->right,cv))) {
+      return addInPlace(tr,tr->right,tr->left,1,cv);
+    }
+    if (((tr->t).symbol == '+' || (tr->t).symbol == '-') && reusable(tr->left,tr->right,cv)) {
+      return addInPlace(tr,tr->left,tr->right,((tr->t).symbol == '+' ? 1 : -1),cv);
+    }
+    left = sortedPoly(tr->left,cv);
+    right = sortedPoly(tr->right,cv);
+  }
+  p = malloc(sizeof(SparsePoly));
+  assert( p != NULL );
+  initSparsePoly(p);
+  p->variableCount = cv->variableCount;
+  memcpy(p->variables,cv->variables,cv->variableCount*sizeof(int));
+  switch (tr->tt) {
+  case Number:
+  case Real:
+    c = numberValue(tr->tt,tr->t);
+    if (c != 0) {
+      appendPolyTerm(p,0,c);
+    }
+    break;
+  case Identifier:
+    for (k = 0; cv->variables[k] != (tr->t).identifier.id; k++) {
+    }
+    appendPolyTerm(p,(uint64_t)1 << variableShift(k),1);
+    break;
+  case Symbol:
+    switch ((tr->t).symbol) {
+    case '+':
+      ok = addSparsePolys(left,right,1,p);
+      break;
+    case '-':
+      ok = addSparsePolys(left,right,-1,p);
+      break;
+    case '*':
+      ok = multiplySparsePolys(left,right,p);
+      break;
+    case '/': /* only by a number that is not 0 */
+      ok = (right->size == 1 && right->terms[0].monomial == 0);
+      for (k = 0; ok && k < left->size; k++) {
+        appendPolyTerm(p,left->terms[k].monomial,left->terms[k].coefficient / right->terms[0].coefficient);
+      }
+      break;
+    default:
+      ok = 0;
+    }
+    break;
+  }
+  if (!ok) {
+    freeSparsePoly(p);
+    free(p);
+    return NULL;
+  }
+  return p;
+}
+
+/* The function releaseChild is called for each child of a node after the node has been
+ * converted; it frees the polynomial of the child after its last parent, unless it is
+ * kept.
+ */
+
+void releaseChild(ExpTree child, ExpTree parent, Conversion *cv) {
+  int id = child->id;
+  cv->parents[id]--;
+  if (cv->polys[parent->id] == NULL) {
+    cv->kept[id] = 1;
+  }
+  if (cv->parents[id] == 0 && !cv->kept[id] && cv->polys[id] != NULL) {
+    freeSparsePoly(cv->polys[id]);
+    free(cv->polys[id]);
+    cv->polys[id] = NULL;
+  }
+}
+
+/* The functions startConversion and endConversion convert the nodes of tr and free
+ * the polynomials made for them. The result of startConversion is 0 when tr has too
+ * many variables.
+ */
+
+int startConversion(ExpTree tr, Conversion *cv) {
+  ExpTree node;
+  int k;
+  cv->order = postOrder(tr,&(cv->count));
+  cv->variableCount = 0;
+  for (k = 0; k < cv->count; k++) {
+    if (cv->order[k]->tt == Identifier
+        && !addPolyVariable((cv->order[k]->t).identifier.id,cv->variables,&(cv->variableCount))) {
+      free(cv->order);
+      return 0;
+    }
+  }
+  cv->nodes = expTreeNodeCount();
+  cv->polys = calloc(cv->nodes+1,sizeof(SparsePoly *));
+  cv->parents = calloc(cv->nodes+1,sizeof(int));
+  cv->kept = calloc(cv->nodes+1,1);
+  cv->unsorted = calloc(cv->nodes+1,1);
+  cv->seen = calloc(cv->nodes+1,sizeof(int));
+  assert( cv->polys != NULL && cv->parents != NULL && cv->kept != NULL );
+  assert( cv->unsorted != NULL && cv->seen != NULL );
+  cv->seenCapacity = cv->nodes+1;
+  cv->stamp = 0;
+  initTreeStack(&(cv->stack));
+  for (k = 0; k < cv->count; k++) {
+    node = cv->order[k];
+    if (node->tt == Symbol) {
+      cv->parents[node->left->id]++;
+      cv->parents[node->right->id]++;
+    }
+  }
+  for (k = 0; k < cv->count; k++) {
+    node = cv->order[k];
+    cv->polys[node->id] = convertNode(node,cv);
+    if (node->tt == Symbol) {
+      releaseChild(node->left,node,cv);
+      releaseChild(node->right,node,cv);
+    }
+  }
+  return 1;
+}
+
+void endConversion(Conversion *cv) {
+  int k;
+  for (k = 0; k <= cv->nodes; k++) {
+    if (cv->polys[k] != NULL) {
+      freeSparsePoly(cv->polys[k]);
+      free(cv->polys[k]);
+    }
+  }
+  free(cv->polys);
+  free(cv->parents);
+  free(cv->kept);
+  free(cv->unsorted);
+  free(cv->seen);
+  freeTreeStack(&(cv->stack));
+  free(cv->order);
+}
+
+/* The function sparsePolyFromExpTree converts tr to the polynomial p (which must have been
+ * initialized). The result is 0 when tr is not a polynomial.
+ */
+
+int sparsePolyFromExpTree(ExpTree tr, SparsePoly *p) {
+  Conversion cv;
+  SparsePoly *q;
+  if (!startConversion(tr,&cv)) {
+    return 0;
+  }
+  q = cv.polys[tr->id];
+  if (q != NULL) {
+    q = sortedPoly(tr,&cv);
+    startPoly(p,q);
+    if (p->capacity < q->size) {
+      p->capacity = q->size;
+      p->terms = realloc(p->terms,p->capacity*sizeof(PolyTerm));
+      assert( p->terms != NULL );
+    }
+    memcpy(p->terms,q->terms,q->size*sizeof(PolyTerm));
+    p->size = q->size;
+  }
+  endConversion(&cv);
+  return (q != NULL);
+}
+
+/* The function sparsePolyToExpTree converts p to an expression tree: the sum of the terms
+ * in order, each the coefficient times the variables, with - for a negative
+ * coefficient (except in front).
+ */
+
+ExpTree sparsePolyToExpTree(const SparsePoly *p) {
+  ExpTree result = NULL, monomial, term, leaf;
+  Token t;
+  double c;
+  int i, k, e;
+  for (i = 0; i < p->size; i++) {
+    monomial = NULL;
+    for (k = 0; k < p->variableCount; k++) {
+      e = variableExponent(p->terms[i].monomial,k);
+      if (e > 0) {
+        t.identifier = identifierSlice(p->variables[k]);
+        leaf = newExpTreeNode(Identifier,t,NULL,NULL);
+        for (; e > 0; e--) {
+          monomial = (monomial == NULL ? leaf : symbolNode('*',monomial,leaf));
+        }
+      }
+    }
+    c = p->terms[i].coefficient;
+    if (result != NULL && c < 0) {
+      c = -c;
+    }
+    if (monomial == NULL) {
+      term = numberNode(c);
+    } else if (c == 1) {
+      term = monomial;
+    } else {
+      term = symbolNode('*',numberNode(c),monomial);
+    }
+    result = (result == NULL ? term : symbolNode((p->terms[i].coefficient < 0 ? '-' : '+'),result,term));
+  }
+  return (result == NULL ? numberNode(0) : result);
+}
+
+/* The function treeSize yields the number of distinct nodes of tr, as postOrder counts
+ * them. The nodes that have been counted get a new stamp in cv->seen, so that, unlike
+ * in postOrder, no table for all nodes is cleared for every subtree: the time is that
+ * of the subtree. cv->seen grows with the nodes made after the conversion.
+ */
+
+int treeSize(ExpTree tr, Conversion *cv) {
+  int count = 0, n = expTreeNodeCount()+1;
+  if (n > cv->seenCapacity) {
+    cv->seen = realloc(cv->seen,(2*n + 16)*sizeof(int));
+    assert( cv->seen != NULL );
+    memset(cv->seen+cv->seenCapacity,0,(2*n + 16 - cv->seenCapacity)*sizeof(int));
+    cv->seenCapacity = 2*n + 16;
+  }
+  cv->stamp++;
+  pushTree(&(cv->stack),tr,0);
+  while (cv->stack.size > 0) {
+    tr = cv->stack.frames[--cv->stack.size].tree;
+    if (cv->seen[tr->id] != cv->stamp) {
+      cv->seen[tr->id] = cv->stamp;
+      count++;
+      if (tr->tt == Symbol) {
+        pushTree(&(cv->stack),tr->right,0);
+        pushTree(&(cv->stack),tr->left,0);
+      }
+    }
+  }
+  return count;
+}
+
+/* The function replacePolynomials rebuilds tr with every largest subtree that is a
+ * polynomial replaced by its normal form; unless expand is set, only when the normal
+ * form has no more distinct nodes than the subtree. First the nodes that are needed are
+ * marked, parents before children: the root, and the children of a needed node that is
+ * no polynomial. Then the needed nodes are rebuilt, children before parents; memo[id]
+ * holds the result for the node with that id.
+ */
+
+ExpTree replacePolynomials(ExpTree tr, Conversion *cv, ExpTree *memo, int expand) {
+  char *needed = calloc(cv->nodes+1,1);
+  ExpTree node;
+  int k;
+  assert( needed != NULL );
+  needed[tr->id] = 1;
+  for (k = cv->count-1; k >= 0; k--) {
+    node = cv->order[k];
+    if (needed[node->id] && cv->polys[node->id] == NULL) {
+      needed[node->left->id] = 1;
+      needed[node->right->id] = 1;
+    }
+  }
+  for (k = 0; k < cv->count; k++) {
+    node = cv->order[k];
+    if (!needed[node->id]) {
+      continue;
+    }
+    if (cv->polys[node->id] != NULL) {
+      memo[node->id] = sparsePolyToExpTree(sortedPoly(node,cv));
+      if (!expand && treeSize(memo[node->id],cv) > treeSize(node,cv)) {
+        memo[node->id] = node;
+      }
+    } else {
+      memo[node->id] = newExpTreeNode(node->tt,node->t,memo[node->left->id],memo[node->right->id]);
+    }
+  }
+  free(needed);
+  return memo[tr->id];
+}
+
+/* The function simplifyPolynomials writes the polynomial parts of tr in normal form
+ * where that does not make them larger, and expandPolynomials writes all of them in
+ * normal form. A tree with more than POLYVARIABLES variables is not changed.
+ */
+
+ExpTree simplifyPolynomials(ExpTree tr) {
+  Conversion cv;
+  if (!startConversion(tr,&cv)) {
+    return tr;
+  }
+  tr = replacePolynomials(tr,&cv,newMemo(),0);
+  endConversion(&cv);
+  return tr;
+}
+
+ExpTree expandPolynomials(ExpTree tr) {
+  Conversion cv;
+  if (!startConversion(tr,&cv)) {
+    return tr;
+  }
+  tr = replacePolynomials(tr,&cv,newMemo(),1);
+  endConversion(&cv);
+  return tr;
+}
@@ -0,0 +1,44 @@
+/* sparsePoly.h */
+
+#ifndef SPARSEPOLY_H
+#define SPARSEPOLY_H
+
+#include <stdint.h> /* uint64_t */
+
+#define POLYVARIABLES 8    /* maximal number of variables of a polynomial */
+#define POLYEXPONENT 255   /* maximal exponent of a variable in a monomial */
+#define POLYTERMS 65536    /* maximal number of terms of a polynomial */
+
+/* A sparse polynomial in at most POLYVARIABLES variables: variables[k] is the id of the
+ * identifier of variable k (in increasing order). A monomial is packed in a uint64_t,
+ * with the exponent of variable k in the byte at bit 8*(POLYVARIABLES-1-k), so that
+ * multiplying monomials is adding them, and the order of the numbers is the
+ * lexicographic order of the exponents. The terms are sorted by decreasing monomial,
+ * and no coefficient is 0.
+ */
+
+typedef struct PolyTerm {
+  uint64_t monomial;
+  double coefficient;
+} PolyTerm;
+
+typedef struct SparsePoly {
+  int variableCount;
+  int variables[POLYVARIABLES];
+  PolyTerm *terms;
+  int size;
+  int capacity;
+} SparsePoly;
+
+void initSparsePoly(SparsePoly *p);
+void freeSparsePoly(SparsePoly *p);
+int addSparsePolys(SparsePoly *a, SparsePoly *b, double sign, SparsePoly *result);
+int multiplySparsePolys(SparsePoly *a, SparsePoly *b, SparsePoly *result);
+void differentiateSparsePoly(const SparsePoly *p, int id, SparsePoly *result);
+double valueSparsePoly(const SparsePoly *p, const double *bindings);
+int sparsePolyFromExpTree(ExpTree tr, SparsePoly *p);
+ExpTree sparsePolyToExpTree(const SparsePoly *p);
+ExpTree simplifyPolynomials(ExpTree tr);
+ExpTree expandPolynomials(ExpTree tr);
+
+#endif
@@ -0,0 +1,153 @@
+/* stats.c
+ *
+ * In this file the instrumentation of stats.h is defined; without STATS it is empty.
+ * Times are taken with clock_gettime(CLOCK_MONOTONIC), which is read without a system
+ * call, and kept in nanoseconds. Every thread adds to statistics of its own (thread
+ * local), so that the counters need no locks or atomic operations; statsMerge adds
+ * them to the totals, under a lock. Nothing is measured until statsEnable is called,
+ * i.e. when the program is run with --stats.
+ */
+
+#ifdef STATS
+
+#include <stdlib.h>  /* free */
+#include <stdint.h>  /* uint64_t */
+#include <string.h>  /* memset */
+#include <time.h>    /* clock_gettime */
+#include <pthread.h>
+#include "scanner.h"
+#include "infixExp.h"
+#include "stats.h"
+
+typedef struct Stats {
+  uint64_t time[PHASES];   /* nanoseconds */
+  uint64_t calls[PHASES];
+  uint64_t count[COUNTERS];
+} Stats;
+
+static int enabled = 0;
+static __thread Stats local;
+static __thread uint64_t accounted; /* nanoseconds given to phases by this thread */
+static Stats total;
+static pthread_mutex_t totalLock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *phaseNames[PHASES] = {
+  "readInput", "tokenList", "expressionNode", "simplify", "differentiate",
+  "analyzeEquation", "solveEquation", "print", "write"
+};
+
+static const char *counterNames[COUNTERS] = {
+  "tokens", "tokenBytes", "nodes", "nodeBytes", "nodesShared",
+  "simplifyCalls", "sizeBeforeSimplify", "sizeAfterSimplify", "lines", "rejected"
+};
+
+void statsEnable() {
+  enabled = 1;
+}
+
+/* The function statsClock yields the time in nanoseconds, less the time that has been
+ * given to phases by the calling thread, or 0 when the statistics are not enabled;
+ * statsTime adds the time since start to a phase. So a phase that runs inside another
+ * one (write, when print fills the buffer of a sink) is not counted twice: the times
+ * of the phases are exclusive, and per thread they add up to at most the running time.
+ */
+
+uint64_t statsClock() {
+  struct timespec ts;
+  if (!enabled) {
+    return 0;
+  }
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return (uint64_t)ts.tv_sec*1000000000u + ts.tv_nsec - accounted;
+}
+
+void statsTime(StatsPhase p, uint64_t start) {
+  uint64_t time;
+  if (enabled) {
+    time = statsClock() - start;
+    local.time[p] += time;
+    local.calls[p]++;
+    accounted += time;
+  }
+}
+
+void statsCount(StatsCounter c, uint64_t n) {
+  local.count[c] += n;
+}
+
+/* The function statsMerge adds the statistics of the calling thread to the totals,
+ * and clears them.
+ */
+
+void statsMerge() {
+  int k;
+  pthread_mutex_lock(&totalLock);
+  for (k = 0; k < PHASES; k++) {
+    total.time[k] += local.time[k];
+    total.calls[k] += local.calls[k];
+  }
+  for (k = 0; k < COUNTERS; k++) {
+    total.count[k] += local.count[k];
+  }
+  pthread_mutex_unlock(&totalLock);
+  memset(&local,0,sizeof(Stats));
+}
+
+/* The function statsTreeSize yields the number of distinct nodes of a tree; it is only
+ * called when the statistics are enabled.
+ */
+
+int statsTreeSize(ExpTree tr) {
+  int count;
+  if (!enabled || tr == NULL) {
+    return 0;
+  }
+  free(postOrder(tr,&count));
+  return count;
+}
+
+/* The function statsReport merges the statistics of the calling thread, and writes the
+ * totals to out: as a table, or as one JSON object when json is 1.
+ */
+
+void statsReport(Sink *out, int json) {
+  int k;
+  statsMerge();
+  if (json) {
+    sinkText(out,"{\"phases\": {");
+    for (k = 0; k < PHASES; k++) {
+      sinkText(out,(k > 0 ? ", \"" : "\""));
+      sinkText(out,phaseNames[k]);
+      sinkText(out,"\": {\"calls\": ");
+      sinkInt(out,total.calls[k]);
+      sinkText(out,", \"ns\": ");
+      sinkInt(out,total.time[k]);
+      sinkChar(out,'}');
+    }
+    sinkText(out,"}, \"counters\": {");
+    for (k = 0; k < COUNTERS; k++) {
+      sinkText(out,(k > 0 ? ", \"" : "\""));
+      sinkText(out,counterNames[k]);
+      sinkText(out,"\": ");
+      sinkInt(out,total.count[k]);
+    }
+    sinkText(out,"}}\n");
+    return;
+  }
+  for (k = 0; k < PHASES; k++) {
+    sinkText(out,phaseNames[k]);
+    sinkText(out,": ");
+    sinkInt(out,total.calls[k]);
+    sinkText(out," calls, ");
+    sinkFixed(out,total.time[k]/1e6,3,0);
+    sinkText(out," ms\n");
+  }
+  for (k = 0; k < COUNTERS; k++) {
+    sinkText(out,counterNames[k]);
+    sinkText(out,": ");
+    sinkInt(out,total.count[k]);
+    sinkChar(out,'\n');
+  }
+}
+
+#endif
@@ -0,0 +1,73 @@
+/* stats.h */
+
+#ifndef STATS_H
+#define STATS_H
+
+/* Instrumentation of the phases of the program, compiled in only when STATS is
+ * defined (e.g. gcc -DSTATS). Otherwise every macro below expands to nothing, and
+ * its arguments are not evaluated.
+ *
+ * STATS_START(v) declares the variable v with the current time, STATS_STOP(p,v)
+ * adds the time since v to phase p, less the time of the phases stopped in between
+ * (a phase may run inside another one); STATS_COUNT(c,n) adds n to counter c.
+ * The statistics are kept per thread: a thread adds its statistics to the totals
+ * with STATS_MERGE(), before it ends.
+ */
+
+typedef enum StatsPhase {
+  PhaseRead,           /* readInput, readChunk (batch mode) */
+  PhaseScan,           /* tokenList, tokenListArena, tokenArray */
+  PhaseParse,          /* expressionNode */
+  PhaseSimplify,       /* simplify */
+  PhaseDifferentiate,  /* differentiate */
+  PhaseAnalyze,        /* analyzeEquation, analyzeEquationFlat */
+  PhaseSolve,          /* solveEquation */
+  PhasePrint,          /* printList, printExpTreeInfix */
+  PhaseWrite,          /* writing output to a file */
+  PHASES
+} StatsPhase;
+
+typedef enum StatsCounter {
+  CountTokens,         /* tokens in token lists and token arrays */
+  CountTokenBytes,
+  CountNodes,          /* new nodes of expression trees */
+  CountNodeBytes,
+  CountNodesShared,    /* nodes that were asked for again, and found (hash-consing) */
+  CountSimplified,     /* calls of simplify */
+  CountSizeBefore,     /* total number of distinct nodes of the trees given to simplify */
+  CountSizeAfter,      /* total number of distinct nodes of the trees it yields */
+  CountLines,          /* lines of input */
+  CountRejected,       /* lines that are not an expression or an equation of the kind asked */
+  COUNTERS
+} StatsCounter;
+
+#ifdef STATS
+
+#include <stdint.h> /* uint64_t */
+
+struct ExpTreeNode;
+struct Sink;
+
+void statsEnable();
+uint64_t statsClock();
+void statsTime(StatsPhase p, uint64_t start);
+void statsCount(StatsCounter c, uint64_t n);
+void statsMerge();
+int statsTreeSize(struct ExpTreeNode *tr);
+void statsReport(struct Sink *out, int json);
+
+#define STATS_START(v) uint64_t v = statsClock()
+#define STATS_STOP(p,v) statsTime((p),(v))
+#define STATS_COUNT(c,n) statsCount((c),(n))
+#define STATS_MERGE() statsMerge()
+
+#else
+
+#define STATS_START(v)
+#define STATS_STOP(p,v)
+#define STATS_COUNT(c,n)
+#define STATS_MERGE()
+
+#endif
+
+#endif
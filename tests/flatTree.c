@@ -0,0 +1,151 @@
+/* tests/flatTree.c
+ *
+ * Test of the flat trees of flatTree.c on random expression trees in x and y, with
+ * shared subtrees:
+ *
+ *   round trip     flatToExpTree(flatFromExpTree(tr)) is tr itself (the nodes are
+ *                  hash-consed), and the flat tree has one node per distinct node;
+ *   value          valueFlatTree equals valueExpTree on the tree with numbers for x, y;
+ *   derivative     differentiateFlatTree to x has the value of differentiate, within
+ *                  1e-9 of the largest value on the way: differentiate may expand a
+ *                  polynomial, and its terms can cancel in another order;
+ *   folding        foldFlatTree keeps the value and does not add nodes.
+ */
+
+#include <stdio.h>  /* printf */
+#include <stdlib.h> /* malloc, free, rand */
+#include <math.h>   /* fabs */
+#include "scanner.h"
+#include "infixExp.h"
+#include "flatTree.h"
+
+#define TREES 3000
+#define MAXDEPTH 12
+#define POOL 32
+
+static int ids[2];
+static double bindings[2];
+static ExpTree pool[POOL], numericPool[POOL];
+static int poolSize;
+
+/* The function randomTree makes a random tree of at most the given depth, and the same
+ * tree with the values of x and y in *numeric. A division is only by a constant that is
+ * not 0, so that valueExpTree accepts the numeric tree.
+ */
+
+ExpTree randomTree(int depth, ExpTree *numeric) {
+  static const char ops[] = "+-*/";
+  ExpTree l, r, nl, nr, tr;
+  Token t;
+  int k;
+  if (depth == 0 || rand() % 5 == 0) {
+    switch (rand() % 4) {
+    case 0:
+    case 1:
+      k = rand() % 2;
+      t.identifier = identifierSlice(ids[k]);
+      tr = newExpTreeNode(Identifier,t,NULL,NULL);
+      t.real = bindings[k];
+      *numeric = newExpTreeNode(Real,t,NULL,NULL);
+      return tr;
+    case 2:
+      t.number = rand() % 4;
+      return *numeric = newExpTreeNode(Number,t,NULL,NULL);
+    default:
+      t.real = 0.5 + (double)rand()/RAND_MAX;
+      return *numeric = newExpTreeNode(Real,t,NULL,NULL);
+    }
+  }
+  if (poolSize > 0 && rand() % 5 == 0) {
+    k = rand() % poolSize;
+    *numeric = numericPool[k];
+    return pool[k];
+  }
+  t.symbol = ops[rand() % 4];
+  l = randomTree(depth-1,&nl);
+  if (t.symbol == '/') {
+    t.real = 0.5 + (double)rand()/RAND_MAX;
+    r = nr = newExpTreeNode(Real,t,NULL,NULL);
+    t.symbol = '/';
+  } else {
+    r = randomTree(depth-1,&nr);
+  }
+  tr = newExpTreeNode(Symbol,t,l,r);
+  *numeric = newExpTreeNode(Symbol,t,nl,nr);
+  if (poolSize < POOL) {
+    pool[poolSize] = tr;
+    numericPool[poolSize++] = *numeric;
+  }
+  return tr;
+}
+
+int nearlyEqual(double a, double b, double scale) {
+  return fabs(a - b) <= 1e-9 * (1 + fabs(a) + fabs(b) + scale);
+}
+
+/* The function largest yields the largest absolute value of values[0..n-1].
+ */
+
+double largest(const double *values, int n) {
+  double m = 0;
+  int k;
+  for (k = 0; k < n; k++) {
+    if (fabs(values[k]) > m) {
+      m = fabs(values[k]);
+    }
+  }
+  return m;
+}
+
+int main() {
+  FlatTree ft, dft, fold, check;
+  ExpTree tr, numeric;
+  double *values, *work;
+  double bindingsById[16], value, derivative, expected;
+  int n, count, roundTrip = 0, valueErrors = 0, derivativeErrors = 0, foldErrors = 0;
+  initFlatTree(&ft);
+  initFlatTree(&dft);
+  initFlatTree(&fold);
+  initFlatTree(&check);
+  ids[0] = identifierId("x");
+  ids[1] = identifierId("y");
+  srand(1);
+  for (n = 0; n < TREES; n++) {
+    resetExpTrees();
+    poolSize = 0;
+    bindings[0] = -2 + 4.0*rand()/RAND_MAX;
+    bindings[1] = -2 + 4.0*rand()/RAND_MAX;
+    bindingsById[ids[0]] = bindings[0];
+    bindingsById[ids[1]] = bindings[1];
+    tr = randomTree(1 + rand() % MAXDEPTH,&numeric);
+    flatFromExpTree(tr,&ft);
+    free(postOrder(tr,&count));
+    roundTrip += (flatToExpTree(&ft) != tr || ft.size != count);
+    values = malloc(ft.size*sizeof(double));
+    value = valueFlatTree(&ft,bindingsById,values);
+    valueErrors += (value != valueExpTree(numeric));
+    free(values);
+    differentiateFlatTree(&ft,ids[0],&dft);
+    flatFromExpTree(differentiate(tr),&check);
+    values = malloc(dft.size*sizeof(double));
+    work = malloc(check.size*sizeof(double));
+    derivative = valueFlatTree(&dft,bindingsById,values);
+    expected = valueFlatTree(&check,bindingsById,work);
+    derivativeErrors += !nearlyEqual(derivative,expected,
+                                     largest(values,dft.size) + largest(work,check.size));
+    free(values);
+    free(work);
+    foldFlatTree(&ft,&fold);
+    values = malloc(ft.size*sizeof(double));
+    foldErrors += (fold.size > ft.size || !nearlyEqual(valueFlatTree(&fold,bindingsById,values),value,0));
+    free(values);
+  }
+  resetExpTrees();
+  freeFlatTree(&ft);
+  freeFlatTree(&dft);
+  freeFlatTree(&fold);
+  freeFlatTree(&check);
+  printf("%d trees: %d round trips, %d values, %d derivatives and %d foldings differ\n",
+         TREES,roundTrip,valueErrors,derivativeErrors,foldErrors);
+  return (roundTrip > 0 || valueErrors > 0 || derivativeErrors > 0 || foldErrors > 0);
+}
@@ -0,0 +1,152 @@
+/* tests/jit.c
+ *
+ * Differential test of the compiled evaluation. Random expression trees over VARIABLES
+ * identifiers are compiled with compileJit and evaluated with evalJit (native code on
+ * x86-64) and with evalExpCode (the bytecode); both must give exactly the value that
+ * valueExpTree gives for the same tree with every identifier replaced by its value.
+ * The trees have shared subtrees (temporaries) and long right spines, so that the stack
+ * also gets deeper than the JITREGISTERS entries that are kept in registers.
+ */
+
+#include <stdio.h>  /* printf */
+#include <stdlib.h> /* malloc, free, rand */
+#include <math.h>   /* fabs, isnan */
+#include "scanner.h"
+#include "infixExp.h"
+#include "expCode.h"
+#include "expJit.h"
+
+#define TREES 3000
+#define MAXDEPTH 24
+#define VARIABLES 8
+#define POOL 64
+
+static char names[VARIABLES][3];
+static double bindings[VARIABLES];
+
+/* A random tree, the same tree with numbers for the identifiers, and its value.
+ */
+
+typedef struct TwinTree {
+  ExpTree tree;
+  ExpTree numeric;
+  double value;
+} TwinTree;
+
+static TwinTree pool[POOL];
+static int poolSize;
+
+double randomReal() {
+  double r = 0.25 + 1.75*rand()/RAND_MAX;
+  return (rand() % 2 ? r : -r);
+}
+
+TwinTree randomLeaf() {
+  TwinTree tw;
+  Token t;
+  int k;
+  switch (rand() % 3) {
+  case 0:
+    k = rand() % VARIABLES;
+    t.identifier.start = names[k];
+    t.identifier.length = 2;
+    t.identifier.id = k;
+    tw.tree = newExpTreeNode(Identifier,t,NULL,NULL);
+    t.real = bindings[k];
+    tw.numeric = newExpTreeNode(Real,t,NULL,NULL);
+    tw.value = bindings[k];
+    break;
+  case 1:
+    t.number = 1 + rand() % 9;
+    tw.tree = tw.numeric = newExpTreeNode(Number,t,NULL,NULL);
+    tw.value = (double)t.number;
+    break;
+  default:
+    t.real = randomReal();
+    tw.tree = tw.numeric = newExpTreeNode(Real,t,NULL,NULL);
+    tw.value = t.real;
+    break;
+  }
+  return tw;
+}
+
+/* The function randomTwin makes a random tree of at most the given depth. A division
+ * by a value near 0 becomes a multiplication, because valueExpTree does not allow it.
+ */
+
+TwinTree randomTwin(int depth) {
+  static const char ops[] = "+-*/";
+  TwinTree l, r, tw;
+  Token t;
+  if (depth == 0 || rand() % 5 == 0) {
+    return randomLeaf();
+  }
+  if (poolSize > 0 && rand() % 6 == 0) {
+    return pool[rand() % poolSize];
+  }
+  l = (rand() % 3 == 0 ? randomLeaf() : randomTwin(depth-1));
+  r = randomTwin(depth-1);
+  t.symbol = ops[rand() % 4];
+  if (t.symbol == '/' && !(fabs(r.value) > 1e-3)) {
+    t.symbol = '*';
+  }
+  tw.tree = newExpTreeNode(Symbol,t,l.tree,r.tree);
+  tw.numeric = newExpTreeNode(Symbol,t,l.numeric,r.numeric);
+  switch (t.symbol) {
+  case '+':
+    tw.value = l.value + r.value;
+    break;
+  case '-':
+    tw.value = l.value - r.value;
+    break;
+  case '*':
+    tw.value = l.value * r.value;
+    break;
+  default:
+    tw.value = l.value / r.value;
+    break;
+  }
+  if (poolSize < POOL) {
+    pool[poolSize++] = tw;
+  }
+  return tw;
+}
+
+int sameValue(double a, double b) {
+  return a == b || (isnan(a) && isnan(b));
+}
+
+int main() {
+  JitCode j;
+  TwinTree tw;
+  double *work, expected;
+  int n, k, native = 0, deep = 0, shared = 0, jitErrors = 0, codeErrors = 0;
+  for (k = 0; k < VARIABLES; k++) {
+    names[k][0] = 'a' + k;
+    names[k][1] = '0' + k;
+  }
+  initJit(&j);
+  srand(1);
+  for (n = 0; n < TREES; n++) {
+    resetExpTrees();
+    poolSize = 0;
+    for (k = 0; k < VARIABLES; k++) {
+      bindings[k] = randomReal();
+    }
+    tw = randomTwin(1 + rand() % MAXDEPTH);
+    expected = valueExpTree(tw.numeric);
+    native += compileJit(tw.tree,&j);
+    deep += (j.code.depth > JITREGISTERS);
+    shared += (j.code.temps > 0);
+    work = malloc(evalWorkSize(&(j.code))*sizeof(double));
+    jitErrors += !sameValue(evalJit(&j,bindings,work),expected);
+    codeErrors += !sameValue(evalExpCode(&(j.code),bindings,work),expected);
+    free(work);
+  }
+  freeJit(&j);
+  resetExpTrees();
+  printf("%d trees (%d native, %d with temporaries, %d deeper than %d): "
+         "%d differ with evalJit, %d with evalExpCode\n",
+         TREES,native,shared,deep,JITREGISTERS,jitErrors,codeErrors);
+  return (jitErrors > 0 || codeErrors > 0);
+}
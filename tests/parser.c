@@ -0,0 +1,155 @@
+/* tests/parser.c
+ *
+ * Differential test of the parser expressionNode. A recursive descent parser after the
+ * grammar of infixExp.c, with backtracking over an operator that is not followed by a
+ * factor, recognizes the longest initial segment of random token lists that is an
+ * expression. Both parsers must agree on whether there is one, on the rest of the list,
+ * and on the tree, which is the same node because the nodes are hash-consed. The same
+ * line is also scanned into a token array and parsed by expressionNodeFlat, which must
+ * give the same tree and stop at the same token.
+ */
+
+#include <stdio.h>  /* printf */
+#include <stdlib.h> /* rand */
+#include <string.h> /* strlen, memcpy */
+#include "scanner.h"
+#include "infixExp.h"
+
+#define LISTS 200000
+#define MAXTOKENS 30
+
+int referenceExpression(List *lp, ExpTree *tree);
+
+int isSymbol(List l, char c) {
+  return l != NULL && l->tt == Symbol && (l->t).symbol == c;
+}
+
+/* The functions referenceFactor, referenceTerm and referenceExpression recognize a
+ * factor, term or expression at the start of *lp. When there is one, they yield 1, its
+ * tree in *tree, and advance *lp over it; otherwise they yield 0 and leave *lp.
+ */
+
+int referenceFactor(List *lp, ExpTree *tree) {
+  List l = *lp;
+  if (l != NULL && (l->tt == Number || l->tt == Real || l->tt == Identifier)) {
+    *tree = newExpTreeNode(l->tt,l->t,NULL,NULL);
+    *lp = l->next;
+    return 1;
+  }
+  if (isSymbol(l,'(')) {
+    l = l->next;
+    if (referenceExpression(&l,tree) && isSymbol(l,')')) {
+      *lp = l->next;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int referenceTerm(List *lp, ExpTree *tree) {
+  ExpTree right;
+  Token t;
+  List l;
+  if (!referenceFactor(lp,tree)) {
+    return 0;
+  }
+  for (;;) {
+    l = *lp;
+    if (!isSymbol(l,'*') && !isSymbol(l,'/')) {
+      return 1;
+    }
+    t.symbol = (l->t).symbol;
+    l = l->next;
+    if (!referenceFactor(&l,&right)) {
+      return 1;
+    }
+    *tree = newExpTreeNode(Symbol,t,*tree,right);
+    *lp = l;
+  }
+}
+
+int referenceExpression(List *lp, ExpTree *tree) {
+  ExpTree right;
+  Token t;
+  List l;
+  if (!referenceTerm(lp,tree)) {
+    return 0;
+  }
+  for (;;) {
+    l = *lp;
+    if (!isSymbol(l,'+') && !isSymbol(l,'-')) {
+      return 1;
+    }
+    t.symbol = (l->t).symbol;
+    l = l->next;
+    if (!referenceTerm(&l,&right)) {
+      return 1;
+    }
+    *tree = newExpTreeNode(Symbol,t,*tree,right);
+    *lp = l;
+  }
+}
+
+/* The function randomLine fills ar with at most MAXTOKENS random tokens, separated by
+ * spaces, and yields its length. Operands and parentheses are more frequent than the
+ * other tokens, so that longer expressions occur.
+ */
+
+int randomLine(char *ar) {
+  static const char *tokens[] = { "a", "b", "7", "2.5", "(", "(", ")", ")",
+                                  "+", "-", "*", "/", "a", "b", "=", "," };
+  int n = rand() % (MAXTOKENS+1), length = 0, k, size;
+  for (k = 0; k < n; k++) {
+    const char *t = tokens[rand() % 16];
+    size = strlen(t);
+    memcpy(ar+length,t,size);
+    length += size;
+    ar[length++] = ' ';
+  }
+  return length;
+}
+
+int main() {
+  char ar[4*MAXTOKENS];
+  Arena a;
+  InternTable it;
+  TokenArray ta;
+  TokenCursor c;
+  List tl, l1, l2, l;
+  ExpTree t1, t2, t3;
+  int n, length, v1, v2, v3, valid = 0, errors = 0, flatErrors = 0;
+  initArena(&a);
+  initInternTable(&it);
+  initTokenArray(&ta);
+  srand(1);
+  for (n = 0; n < LISTS; n++) {
+    resetArena(&a);
+    resetExpTrees();
+    length = randomLine(ar);
+    tl = tokenListArena(ar,length,&a,&it);
+    l1 = l2 = tl;
+    t1 = t2 = t3 = NULL;
+    v1 = expressionNode(&l1,&t1);
+    v2 = referenceExpression(&l2,&t2);
+    if (v1 != v2 || l1 != l2 || (v1 && t1 != t2)) {
+      errors++;
+    }
+    tokenArrayTable(ar,length,&ta,&it);
+    c = tokenCursor(&ta);
+    v3 = expressionNodeFlat(&c,&t3);
+    for (l = tl; l != l1; l = l->next) { /* the tokens that expressionNode took */
+      c.pos--;
+    }
+    if (v3 != v1 || c.pos != ta.tokens || (v3 && t3 != t1)) {
+      flatErrors++;
+    }
+    valid += v2;
+  }
+  resetExpTrees();
+  releaseArena(&a);
+  freeInternTable(&it);
+  freeTokenArray(&ta);
+  printf("%d token lists (%d with an expression): %d differ, %d differ with the token array\n",
+         LISTS,valid,errors,flatErrors);
+  return (errors > 0 || flatErrors > 0);
+}
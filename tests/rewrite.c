@@ -0,0 +1,253 @@
+/* tests/rewrite.c
+ *
+ * Test of the rewriting to a normal form of rewrite.c:
+ *
+ *   cases      fixed expressions, for constant folding, the collection of like terms and
+ *              like factors, and the cancellation of E-E and E/E, with their results;
+ *   random     random trees in x, y and z with shared subtrees: the result keeps the
+ *              value (within 1e-9 of the largest value on the way, since the terms are
+ *              added in another order), and rewriting it again gives the same node, so
+ *              a fixpoint has been reached;
+ *   chains     sums and products of 10^5 distinct terms, each twice: the like terms
+ *              are combined, which takes time linear in the length of the chain.
+ */
+
+#include <stdio.h>  /* printf, sprintf */
+#include <stdlib.h> /* malloc, free, rand */
+#include <string.h> /* strlen, memcmp */
+#include <math.h>   /* fabs */
+#include "scanner.h"
+#include "infixExp.h"
+#include "rewrite.h"
+
+#define TREES 3000
+#define MAXDEPTH 10
+#define POOL 32
+#define CHAIN 100000
+
+static const char *cases[][2] = {
+  { "2 * 3 + 4 * 5", "26" },
+  { "(2 + 3) * x - 4 / 8", "((5 * x) - 0.5)" },
+  { "x + y + x - y", "(2 * x)" },
+  { "x * y - y * x + 1", "1" },
+  { "3 * x / 3", "x" },
+  { "(x + 1) / (1 + x)", "1" },
+  { "x * y / (y * x) + z", "(z + 1)" },
+  { "x * x * y / x", "(x * y)" },
+  { "(x - x) * y + z / z", "1" },
+  { "2 * x + 3 * x - 5 * x", "0" }
+};
+
+static int ids[3];
+static Token variables[3];
+static double bindings[64];
+static ExpTree pool[POOL];
+static int poolSize;
+
+/* The function parse makes the tree of an expression in a string.
+ */
+
+ExpTree parse(const char *text) {
+  char line[256];
+  LineView view;
+  List tl;
+  ExpTree tr = NULL;
+  view.length = strlen(text);
+  memcpy(line,text,view.length+1);
+  view.start = line;
+  tl = tokenList(view);
+  expressionNode(&tl,&tr);
+  return tr;
+}
+
+/* The function randomTree makes a random tree of at most the given depth. A division
+ * is only by a constant that is not 0.
+ */
+
+ExpTree randomTree(int depth) {
+  static const char ops[] = "+-*/";
+  ExpTree l, r, tr;
+  char c;
+  if (depth == 0 || rand() % 5 == 0) {
+    switch (rand() % 3) {
+    case 0:
+      return numberNode(rand() % 4);
+    case 1:
+      return numberNode(0.5 + (double)(rand() % 8)/4);
+    default:
+      return newExpTreeNode(Identifier,variables[rand() % 3],NULL,NULL);
+    }
+  }
+  if (poolSize > 0 && rand() % 5 == 0) {
+    return pool[rand() % poolSize];
+  }
+  c = ops[rand() % 4];
+  l = randomTree(depth-1);
+  r = (c == '/' ? numberNode(0.5 + (double)(rand() % 8)/4) : randomTree(depth-1));
+  tr = symbolNode(c,l,r);
+  if (poolSize < POOL) {
+    pool[poolSize++] = tr;
+  }
+  return tr;
+}
+
+/* The function value yields the value of a tree with the identifiers bound by id, and
+ * in *largest the largest absolute value on the way.
+ */
+
+double value(ExpTree tr, double *largest) {
+  ExpTree *nodes;
+  double *values, v = 0;
+  int count, k;
+  nodes = postOrder(tr,&count);
+  values = malloc((expTreeNodeCount()+1)*sizeof(double));
+  *largest = 0;
+  for (k = 0; k < count; k++) {
+    tr = nodes[k];
+    switch (tr->tt) {
+    case Number:
+    case Real:
+      v = numberValue(tr->tt,tr->t);
+      break;
+    case Identifier:
+      v = bindings[(tr->t).identifier.id];
+      break;
+    default:
+      switch ((tr->t).symbol) {
+      case '+':
+        v = values[tr->left->id] + values[tr->right->id];
+        break;
+      case '-':
+        v = values[tr->left->id] - values[tr->right->id];
+        break;
+      case '*':
+        v = values[tr->left->id] * values[tr->right->id];
+        break;
+      default:
+        v = values[tr->left->id] / values[tr->right->id];
+        break;
+      }
+    }
+    values[tr->id] = v;
+    if (fabs(v) > *largest) {
+      *largest = fabs(v);
+    }
+  }
+  free(nodes);
+  free(values);
+  return v;
+}
+
+/* The function chainOf makes the chain of 2*n operations symbol over the distinct
+ * identifiers x0 .. x(n-1), each of them twice: x0 op x1 op ... op x(n-1) op x0 op ...
+ */
+
+ExpTree chainOf(char symbol, int n) {
+  char name[16];
+  ExpTree tr = NULL, leaf;
+  Token t;
+  int k;
+  for (k = 0; k < 2*n; k++) {
+    sprintf(name,"x%d",k % n);
+    t.identifier = identifierSlice(identifierId(name));
+    leaf = newExpTreeNode(Identifier,t,NULL,NULL);
+    tr = (tr == NULL ? leaf : symbolNode(symbol,tr,leaf));
+  }
+  return tr;
+}
+
+/* The function chainOperands yields the operands of the left-deep chain tr of the
+ * operations symbol and minus, from left to right, and their number in *n.
+ */
+
+ExpTree *chainOperands(ExpTree tr, char symbol, char minus, int *n) {
+  ExpTree *operands;
+  ExpTree t;
+  int k = 1;
+  for (t = tr; t->tt == Symbol && ((t->t).symbol == symbol || (t->t).symbol == minus); t = t->left) {
+    k++;
+  }
+  operands = malloc(k*sizeof(ExpTree));
+  *n = k;
+  for (t = tr; k > 1; t = t->left) {
+    operands[--k] = t->right;
+  }
+  operands[0] = t;
+  return operands;
+}
+
+/* The function checkSum checks that the sum tr has n terms 2 * E, and checkProduct
+ * that the product tr has 2*n factors, in pairs of the same E.
+ */
+
+int checkSum(ExpTree tr, int n) {
+  ExpTree *terms;
+  int count, k, ok;
+  terms = chainOperands(tr,'+','-',&count);
+  ok = (count == n);
+  for (k = 0; k < count && ok; k++) {
+    ok = (terms[k]->tt == Symbol && (terms[k]->t).symbol == '*'
+          && terms[k]->left->tt == Number && (terms[k]->left->t).number == 2);
+  }
+  free(terms);
+  return ok;
+}
+
+int checkProduct(ExpTree tr, int n) {
+  ExpTree *factors;
+  int count, k, ok;
+  factors = chainOperands(tr,'*','/',&count);
+  ok = (count == 2*n);
+  for (k = 0; k+1 < count && ok; k += 2) {
+    ok = (factors[k] == factors[k+1] && factors[k]->tt == Identifier);
+  }
+  free(factors);
+  return ok;
+}
+
+int main() {
+  Sink out;
+  ExpTree tr, result;
+  double v, w, scale, scale2;
+  int n, k, caseErrors = 0, valueErrors = 0, fixpointErrors = 0, chainErrors = 0;
+  initSink(&out,-1);
+  for (k = 0; k < (int)(sizeof(cases)/sizeof(cases[0])); k++) {
+    resetExpTrees();
+    out.length = 0;
+    printExpTreeInfix(&out,rewriteExpTree(parse(cases[k][0])));
+    if (out.length != strlen(cases[k][1]) || memcmp(out.buffer,cases[k][1],out.length) != 0) {
+      printf("%s: %.*s instead of %s\n",cases[k][0],(int)out.length,out.buffer,cases[k][1]);
+      caseErrors++;
+    }
+  }
+  ids[0] = identifierId("x");
+  ids[1] = identifierId("y");
+  ids[2] = identifierId("z");
+  for (k = 0; k < 3; k++) {
+    variables[k].identifier = identifierSlice(ids[k]);
+  }
+  srand(1);
+  for (n = 0; n < TREES; n++) {
+    resetExpTrees();
+    poolSize = 0;
+    for (k = 0; k < 3; k++) {
+      bindings[ids[k]] = -2 + 4.0*rand()/RAND_MAX;
+    }
+    tr = randomTree(1 + rand() % MAXDEPTH);
+    result = rewriteExpTree(tr);
+    v = value(tr,&scale);
+    w = value(result,&scale2);
+    valueErrors += !(fabs(v - w) <= 1e-9 * (1 + fabs(v) + scale + scale2));
+    fixpointErrors += (rewriteExpTree(result) != result);
+  }
+  resetExpTrees();
+  chainErrors += !checkSum(rewriteExpTree(chainOf('+',CHAIN)),CHAIN);
+  resetExpTrees();
+  chainErrors += !checkProduct(rewriteExpTree(chainOf('*',CHAIN)),CHAIN);
+  resetExpTrees();
+  resetTokens();
+  freeSink(&out);
+  printf("%d cases differ; %d random trees: %d values differ, %d are no fixpoint; "
+         "%d chains differ\n",caseErrors,TREES,valueErrors,fixpointErrors,chainErrors);
+  return (caseErrors > 0 || valueErrors > 0 || fixpointErrors > 0 || chainErrors > 0);
+}
@@ -0,0 +1,236 @@
+/* tests/scanner.c
+ *
+ * Differential test of the scanner. A reference scanner with the functions of ctype.h
+ * (in the "C" locale), as the scanner was before charClass.c, scans random lines; the
+ * tokens must be the same as those of tokenArrayTable and tokenListArena with each
+ * implementation of the run functions: scalar, SSE2 and AVX2 (when the processor has
+ * it). The run functions are also compared with the scalar ones at every position.
+ * Literals that are out of range are saturated by both; the reports of the scanner on
+ * the standard error are suppressed.
+ */
+
+#include <stdio.h>  /* printf */
+#include <stdlib.h> /* malloc, free, strtod */
+#include <string.h> /* memcmp */
+#include <ctype.h>  /* isspace, isdigit, isalpha, isalnum */
+#include <stdint.h> /* int64_t, INT64_MAX */
+#include <float.h>  /* DBL_MAX */
+#include <math.h>   /* isinf */
+#include "scanner.h"
+#include "charClass.h"
+
+#define LINES 20000
+#define MAXLINE 300
+
+static const char *pathNames[] = { "auto", "scalar", "SSE2", "AVX2" };
+
+/* The function referenceToken reads the token at ar[*ip] as the ctype scanner did,
+ * after the grammar of number literals of scanner.c.
+ */
+
+void referenceToken(const char *ar, int *ip, int length, FlatToken *ft, int *nameStart) {
+  int i = *ip, start = i, isReal = 0, k, first;
+  char buf[MAXLINE+1];
+  if (isdigit((unsigned char)ar[i])) {
+    while (i < length && isdigit((unsigned char)ar[i])) {
+      i++;
+    }
+    if (i+1 < length && ar[i] == '.' && isdigit((unsigned char)ar[i+1])) {
+      i++;
+      while (i < length && isdigit((unsigned char)ar[i])) {
+        i++;
+      }
+      isReal = 1;
+    }
+    if (i < length && (ar[i] == 'e' || ar[i] == 'E')) {
+      k = i+1;
+      if (k < length && (ar[k] == '+' || ar[k] == '-')) {
+        k++;
+      }
+      if (k < length && isdigit((unsigned char)ar[k])) {
+        while (k < length && isdigit((unsigned char)ar[k])) {
+          k++;
+        }
+        i = k;
+        isReal = 1;
+      }
+    }
+    memcpy(buf,ar+start,i-start);
+    buf[i-start] = '\0';
+    if (isReal) {
+      ft->tt = Real;
+      ft->t.real = strtod(buf,NULL);
+      if (isinf(ft->t.real)) {
+        ft->t.real = DBL_MAX;
+      }
+    } else {
+      ft->tt = Number;
+      ft->t.number = 0;
+      for (first = 0; buf[first] != '\0'; first++) {
+        if (ft->t.number > (INT64_MAX - (buf[first] - '0')) / 10) {
+          ft->t.number = INT64_MAX;
+          break;
+        }
+        ft->t.number = 10*ft->t.number + (buf[first] - '0');
+      }
+    }
+  } else if (isalpha((unsigned char)ar[i])) {
+    while (i < length && isalnum((unsigned char)ar[i])) {
+      i++;
+    }
+    ft->tt = Identifier;
+    ft->t.identifier.length = i - start;
+    *nameStart = start;
+  } else {
+    ft->tt = Symbol;
+    ft->t.symbol = ar[i];
+    i++;
+  }
+  *ip = i;
+}
+
+/* The function randomLine fills ar with a random line of the given length, made to
+ * hit the boundaries of the classes: runs of every class, longer than a vector, and
+ * the characters of number literals.
+ */
+
+void randomLine(char *ar, int length) {
+  static const char spaces[] = " \t\n\v\f\r";
+  static const char symbols[] = "+-*/^=().eE,;\x80\xe9\xff@[`{";
+  int i = 0, run, k, cls;
+  while (i < length) {
+    cls = rand() % 5;
+    run = 1 + rand() % (rand() % 4 == 0 ? 40 : 4);
+    for (k = 0; k < run && i < length; k++) {
+      switch (cls) {
+      case 0:
+        ar[i++] = spaces[rand() % 6];
+        break;
+      case 1:
+        ar[i++] = '0' + rand() % 10;
+        break;
+      case 2:
+        ar[i++] = (rand() % 2 ? 'a' : 'A') + rand() % 26;
+        break;
+      case 3:
+        ar[i++] = (rand() % 3 == 0 ? '0' + rand() % 10 : 'a' + rand() % 26);
+        break;
+      default:
+        ar[i++] = symbols[rand() % (sizeof(symbols)-1)];
+        break;
+      }
+    }
+    if (cls == 1 && rand() % 3 == 0 && i + 4 < length) { /* a fraction or an exponent */
+      ar[i++] = (rand() % 2 ? '.' : 'e');
+      if (rand() % 2) {
+        ar[i++] = (rand() % 2 ? '+' : '-');
+      }
+      ar[i++] = '0' + rand() % 10;
+    }
+  }
+}
+
+int sameToken(FlatToken *a, FlatToken *b, const char *ar, int nameStart) {
+  if (a->tt != b->tt) {
+    return 0;
+  }
+  switch (a->tt) {
+  case Number:
+    return a->t.number == b->t.number;
+  case Real:
+    return memcmp(&a->t.real,&b->t.real,sizeof(double)) == 0;
+  case Identifier:
+    return a->t.identifier.length == b->t.identifier.length
+           && memcmp(a->t.identifier.start,ar+nameStart,a->t.identifier.length) == 0;
+  case Symbol:
+    return a->t.symbol == b->t.symbol;
+  }
+  return 0;
+}
+
+/* The function checkLine compares the scanner with the reference scanner on one line,
+ * and yields the number of differences.
+ */
+
+int checkLine(char *ar, int length, TokenArray *ta, InternTable *it, Arena *a) {
+  FlatToken ref;
+  List l = tokenListArena(ar,length,a,it);
+  int i = 0, n = 0, nameStart = 0;
+  tokenArrayTable(ar,length,ta,it);
+  while (i < length && isspace((unsigned char)ar[i])) {
+    i++;
+  }
+  while (i < length) {
+    referenceToken(ar,&i,length,&ref,&nameStart);
+    if (n >= ta->size || !sameToken(&ta->tokens[n],&ref,ar,nameStart)) {
+      return 1;
+    }
+    if (l == NULL || l->tt != ref.tt || !sameToken((FlatToken *)&(l->tt),&ref,ar,nameStart)) {
+      return 1;
+    }
+    l = l->next;
+    n++;
+    while (i < length && isspace((unsigned char)ar[i])) {
+      i++;
+    }
+  }
+  return (n != ta->size || l != NULL);
+}
+
+/* The function checkRuns compares the run functions with the scalar ones (the class
+ * table) at every position of a line, and yields the number of differences.
+ */
+
+int checkRuns(char *ar, int length) {
+  int i, j, errors = 0;
+  for (i = 0; i <= length; i++) {
+    for (j = i; j < length && isSpaceChar(ar[j]); j++) {
+    }
+    errors += (skipSpaces(ar,i,length) != j);
+    for (j = i; j < length && isDigitChar(ar[j]); j++) {
+    }
+    errors += (skipDigits(ar,i,length) != j);
+    for (j = i; j < length && isAlnumChar(ar[j]); j++) {
+    }
+    errors += (skipAlnum(ar,i,length) != j);
+  }
+  return errors;
+}
+
+int main() {
+  TokenArray ta;
+  InternTable it;
+  Arena a;
+  char *ar;
+  int path, chosen, line, length, lineErrors, runErrors, failed = 0;
+  initTokenArray(&ta);
+  initInternTable(&it);
+  initArena(&a);
+  freopen("/dev/null","w",stderr);
+  for (path = ScanScalar; path <= ScanAVX2; path++) {
+    chosen = selectScanPath(path);
+    if (chosen != path) {
+      printf("%-6s not supported by this processor, skipped\n",pathNames[path]);
+      continue;
+    }
+    srand(1);
+    lineErrors = runErrors = 0;
+    for (line = 0; line < LINES; line++) {
+      length = rand() % MAXLINE;
+      ar = malloc(length+1); /* exactly the line, so that reading after it is noticed by tools */
+      randomLine(ar,length);
+      lineErrors += checkLine(ar,length,&ta,&it,&a);
+      runErrors += checkRuns(ar,length);
+      resetArena(&a);
+      free(ar);
+    }
+    printf("%-6s %d lines: %d lines differ, %d run lengths differ\n",
+           pathNames[path],LINES,lineErrors,runErrors);
+    failed |= (lineErrors > 0 || runErrors > 0);
+  }
+  selectScanPath(ScanAuto);
+  freeTokenArray(&ta);
+  freeInternTable(&it);
+  releaseArena(&a);
+  return failed;
+}
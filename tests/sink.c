@@ -0,0 +1,118 @@
+/* tests/sink.c
+ *
+ * Differential test of the number formatting of sink.c against snprintf: sinkFixed
+ * with 0..30 decimals must give the text of "%.Nf" and "%+.Nf", and sinkGeneral that
+ * of "%g", for
+ *
+ *   special   values that are hard to round: ties at every scale (0.5, 2.5, 0.125,
+ *             1.5e-3, ...), numbers just off a tie (2.675, 1.005), ±0, inf, nan,
+ *             subnormals, the extremes of the doubles, and the numbers around the
+ *             switch-over to snprintf (2^52 scaled by the decimals, and the exponents
+ *             beyond 10^22) and around the switch-over of %g to exponent notation;
+ *   random    doubles with random bits, and random numbers of a random magnitude,
+ *             each with a random number of decimals.
+ */
+
+#include <stdio.h>  /* printf, snprintf */
+#include <stdlib.h> /* rand */
+#include <string.h> /* memcpy, strlen, memcmp */
+#include <stdint.h> /* uint64_t */
+#include <float.h>  /* DBL_MAX, DBL_MIN, DBL_TRUE_MIN */
+#include <math.h>   /* INFINITY, NAN, ldexp, nextafter, pow */
+#include "sink.h"
+
+#define RANDOM 100000
+#define MAXDECIMALS 30
+
+static const double special[] = {
+  0.5, 1.5, 2.5, 3.5, 0.25, 0.75, 0.125, 0.375, 0.625, 1.0625, 2.675, 1.005, 0.045,
+  1.5e-3, 2.5e-5, 0.1, 0.2, 0.3, 1e-7, 123456.5, 999999.5, 9999995, 99999.95, 999999,
+  1000000, 100000, 0.0001, 0.00009999995, 0.000099999949, 1e-5, 123456789012.5,
+  4503599627370495.5, 4503599627370496.0, 4503599627370497.0, 9007199254740993.0,
+  1e15, 1e16, 1e22, 1e23, 1e-22, 1e-23, 1e-17, 1e-18, 1e-300, 1e300, 0, 1, 7, 42,
+  DBL_MAX, DBL_MIN, DBL_TRUE_MIN, 2.2250738585072009e-308, 4.9406564584124654e-322
+};
+
+static int errors, cases;
+
+/* The function check compares the text of a sink with that of snprintf.
+ */
+
+void check(Sink *s, const char *expected, const char *what, double v) {
+  cases++;
+  if (s->length != strlen(expected) || memcmp(s->buffer,expected,s->length) != 0) {
+    if (errors < 20) {
+      printf("%s of %.17g: %.*s instead of %s\n",what,v,(int)s->length,s->buffer,expected);
+    }
+    errors++;
+  }
+}
+
+/* The function checkValue checks sinkFixed with the numbers of decimals from..to, with
+ * and without plus, and sinkGeneral, on v and -v.
+ */
+
+void checkValue(Sink *s, double v, int from, int to) {
+  char text[512];
+  int sign, d;
+  for (sign = 0; sign < 2; sign++, v = -v) {
+    for (d = from; d <= to; d++) {
+      s->length = 0;
+      sinkFixed(s,v,d,0);
+      snprintf(text,sizeof(text),"%.*f",d,v);
+      check(s,text,"%.Nf",v);
+      s->length = 0;
+      sinkFixed(s,v,d,1);
+      snprintf(text,sizeof(text),"%+.*f",d,v);
+      check(s,text,"%+.Nf",v);
+    }
+    s->length = 0;
+    sinkGeneral(s,v);
+    snprintf(text,sizeof(text),"%g",v);
+    check(s,text,"%g",v);
+  }
+}
+
+/* The function randomBits yields a double with 64 random bits.
+ */
+
+double randomBits() {
+  uint64_t bits = 0;
+  double v;
+  int k;
+  for (k = 0; k < 4; k++) {
+    bits = (bits << 16) | (rand() & 0xFFFF);
+  }
+  memcpy(&v,&bits,sizeof(v));
+  return v;
+}
+
+int main() {
+  Sink s;
+  double v;
+  int k, d;
+  initSink(&s,-1);
+  for (k = 0; k < (int)(sizeof(special)/sizeof(special[0])); k++) {
+    checkValue(&s,special[k],0,MAXDECIMALS);
+    checkValue(&s,nextafter(special[k],0),0,MAXDECIMALS);
+    checkValue(&s,nextafter(special[k],INFINITY),0,MAXDECIMALS);
+  }
+  checkValue(&s,INFINITY,0,MAXDECIMALS);
+  checkValue(&s,NAN,0,MAXDECIMALS);
+  for (d = 0; d <= 22; d++) { /* the switch-over of sinkFixed to snprintf */
+    v = ldexp(1,52) / pow(10,d);
+    checkValue(&s,v,d,d);
+    checkValue(&s,nextafter(v,0),d,d);
+    checkValue(&s,nextafter(v,INFINITY),d,d);
+  }
+  srand(1);
+  for (k = 0; k < RANDOM; k++) {
+    d = rand() % (MAXDECIMALS+1);
+    checkValue(&s,randomBits(),d,d);
+    d = rand() % (MAXDECIMALS+1);
+    checkValue(&s,(double)rand()/RAND_MAX * pow(10,rand() % 40 - 20),d,d);
+  }
+  freeSink(&s);
+  printf("%d numbers formatted: %d differ from snprintf\n",cases,errors);
+  return (errors > 0);
+}
@@ -0,0 +1,302 @@
+/* tests/sparsePoly.c
+ *
+ * Test of the polynomials of sparsePoly.c:
+ *
+ *   conversion      random polynomial trees in x, y and z with shared subtrees are
+ *                   converted; the terms are sorted without a coefficient 0, and the
+ *                   value is that of the tree;
+ *   derivative      the derivative to x has the value of the derivative of the tree,
+ *                   computed along with its value;
+ *   round trip      the tree of the polynomial converts back to the same terms;
+ *   simplification  random trees that are polynomials only in parts (with divisions by
+ *                   identifiers) keep their value in simplifyPolynomials and
+ *                   expandPolynomials, and a power of x+1 written as a product is only
+ *                   expanded by expandPolynomials;
+ *   chains          left-deep and right-deep sums of CHAIN distinct monomials x^a*y^b
+ *                   convert to CHAIN terms, in time linear in the length of the chain.
+ */
+
+#include <stdio.h>  /* printf */
+#include <stdlib.h> /* malloc, free, rand */
+#include <string.h> /* strlen, memcpy */
+#include <math.h>   /* fabs */
+#include "scanner.h"
+#include "infixExp.h"
+#include "rewrite.h"
+#include "sparsePoly.h"
+
+#define TREES 3000
+#define MAXDEPTH 8
+#define POOL 32
+#define CHAIN 60000
+
+static int ids[3];
+static Token variables[3];
+static double bindings[64];
+static ExpTree pool[POOL];
+static int poolSize;
+
+/* The function parse makes the tree of an expression in a string.
+ */
+
+ExpTree parse(const char *text) {
+  char line[256];
+  LineView view;
+  List tl;
+  ExpTree tr = NULL;
+  view.length = strlen(text);
+  memcpy(line,text,view.length+1);
+  view.start = line;
+  tl = tokenList(view);
+  expressionNode(&tl,&tr);
+  return tr;
+}
+
+ExpTree variableNode(int k) {
+  return newExpTreeNode(Identifier,variables[k],NULL,NULL);
+}
+
+/* The function randomTree makes a random tree of at most the given depth. Unless
+ * divisions is set, it is a polynomial: a division is only by a number that is not 0;
+ * otherwise a division may also be by an identifier.
+ */
+
+ExpTree randomTree(int depth, int divisions) {
+  static const char ops[] = "+-*/";
+  ExpTree l, r, tr;
+  char c;
+  if (depth == 0 || rand() % 5 == 0) {
+    switch (rand() % 3) {
+    case 0:
+      return numberNode(rand() % 4);
+    case 1:
+      return numberNode(0.5 + (double)(rand() % 8)/4);
+    default:
+      return variableNode(rand() % 3);
+    }
+  }
+  if (poolSize > 0 && rand() % 5 == 0) {
+    return pool[rand() % poolSize];
+  }
+  c = ops[rand() % 4];
+  l = randomTree(depth-1,divisions);
+  if (c != '/') {
+    r = randomTree(depth-1,divisions);
+  } else if (divisions && rand() % 2 == 0) {
+    r = variableNode(rand() % 3);
+  } else {
+    r = numberNode(0.5 + (double)(rand() % 8)/4);
+  }
+  tr = symbolNode(c,l,r);
+  if (poolSize < POOL) {
+    pool[poolSize++] = tr;
+  }
+  return tr;
+}
+
+/* The function value yields the value of a tree with the identifiers bound by id, in
+ * *derivative its derivative to x, and in *largest the largest absolute value on the way.
+ */
+
+double value(ExpTree tr, double *derivative, double *largest) {
+  ExpTree *nodes;
+  double *values, *slopes, v = 0, d = 0, l, r, dl, dr;
+  int count, k;
+  nodes = postOrder(tr,&count);
+  values = malloc((expTreeNodeCount()+1)*sizeof(double));
+  slopes = malloc((expTreeNodeCount()+1)*sizeof(double));
+  *largest = 0;
+  for (k = 0; k < count; k++) {
+    tr = nodes[k];
+    switch (tr->tt) {
+    case Number:
+    case Real:
+      v = numberValue(tr->tt,tr->t);
+      d = 0;
+      break;
+    case Identifier:
+      v = bindings[(tr->t).identifier.id];
+      d = ((tr->t).identifier.id == ids[0]);
+      break;
+    default:
+      l = values[tr->left->id];
+      r = values[tr->right->id];
+      dl = slopes[tr->left->id];
+      dr = slopes[tr->right->id];
+      switch ((tr->t).symbol) {
+      case '+':
+        v = l + r;
+        d = dl + dr;
+        break;
+      case '-':
+        v = l - r;
+        d = dl - dr;
+        break;
+      case '*':
+        v = l * r;
+        d = dl*r + l*dr;
+        break;
+      default:
+        v = l / r;
+        d = (dl - v*dr) / r;
+        break;
+      }
+    }
+    values[tr->id] = v;
+    slopes[tr->id] = d;
+    if (fabs(v) > *largest) {
+      *largest = fabs(v);
+    }
+    if (fabs(d) > *largest) {
+      *largest = fabs(d);
+    }
+  }
+  free(nodes);
+  free(values);
+  free(slopes);
+  *derivative = d;
+  return v;
+}
+
+/* The function nearlyEqual compares values that may differ by rounding, relative to the
+ * largest value scale on the way to them.
+ */
+
+int nearlyEqual(double v, double w, double scale) {
+  return (fabs(v - w) <= 1e-9 * (1 + fabs(v) + fabs(w) + scale));
+}
+
+/* The function wellFormed checks that the terms of p are sorted by decreasing monomial
+ * and that no coefficient is 0. The function sameTerms checks that p and q have the
+ * same terms; q may lack variables of p that occur in none of them.
+ */
+
+int wellFormed(const SparsePoly *p) {
+  int k;
+  for (k = 0; k < p->size; k++) {
+    if (p->terms[k].coefficient == 0 || (k > 0 && p->terms[k-1].monomial <= p->terms[k].monomial)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+int exponent(const SparsePoly *p, uint64_t monomial, int id) {
+  int k;
+  for (k = 0; k < p->variableCount; k++) {
+    if (p->variables[k] == id) {
+      return (int)((monomial >> 8*(POLYVARIABLES-1-k)) & 0xFF);
+    }
+  }
+  return 0;
+}
+
+int sameTerms(const SparsePoly *p, const SparsePoly *q) {
+  int k, j;
+  if (p->size != q->size) {
+    return 0;
+  }
+  for (k = 0; k < p->size; k++) {
+    if (p->terms[k].coefficient != q->terms[k].coefficient) {
+      return 0;
+    }
+    for (j = 0; j < 3; j++) {
+      if (exponent(p,p->terms[k].monomial,ids[j]) != exponent(q,q->terms[k].monomial,ids[j])) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+/* The function monomialChain makes the chain of the sums of n distinct monomials
+ * x^a*y^b, left-deep or right-deep; the powers are products of the same identifier.
+ */
+
+ExpTree monomialChain(int n, int rightDeep) {
+  ExpTree xPowers[251], yPowers[251];
+  ExpTree tr = NULL, term;
+  int k;
+  xPowers[1] = variableNode(0);
+  yPowers[1] = variableNode(1);
+  for (k = 2; k <= 250; k++) {
+    xPowers[k] = symbolNode('*',xPowers[k-1],xPowers[1]);
+    yPowers[k] = symbolNode('*',yPowers[k-1],yPowers[1]);
+  }
+  for (k = 0; k < n; k++) {
+    term = xPowers[1 + k % 250];
+    if (k >= 250) {
+      term = symbolNode('*',term,yPowers[k / 250]);
+    }
+    if (tr == NULL) {
+      tr = term;
+    } else {
+      tr = (rightDeep ? symbolNode('+',term,tr) : symbolNode('+',tr,term));
+    }
+  }
+  return tr;
+}
+
+int main() {
+  SparsePoly p, q, dp;
+  ExpTree tr, power;
+  double v, d, w, scale;
+  int n, k, convertErrors = 0, valueErrors = 0, derivativeErrors = 0, roundTripErrors = 0;
+  int simplifyErrors = 0, chainErrors = 0;
+  ids[0] = identifierId("x");
+  ids[1] = identifierId("y");
+  ids[2] = identifierId("z");
+  for (k = 0; k < 3; k++) {
+    variables[k].identifier = identifierSlice(ids[k]);
+  }
+  initSparsePoly(&p);
+  initSparsePoly(&q);
+  initSparsePoly(&dp);
+  srand(1);
+  for (n = 0; n < TREES; n++) {
+    resetExpTrees();
+    poolSize = 0;
+    for (k = 0; k < 3; k++) {
+      bindings[ids[k]] = -2 + 4.0*rand()/RAND_MAX;
+    }
+    tr = randomTree(1 + rand() % MAXDEPTH,0);
+    v = value(tr,&d,&scale);
+    if (!sparsePolyFromExpTree(tr,&p) || !wellFormed(&p)) {
+      convertErrors++;
+      continue;
+    }
+    valueErrors += !nearlyEqual(v,valueSparsePoly(&p,bindings),scale);
+    differentiateSparsePoly(&p,ids[0],&dp);
+    derivativeErrors += !(wellFormed(&dp) && nearlyEqual(d,valueSparsePoly(&dp,bindings),scale));
+    roundTripErrors += !(sparsePolyFromExpTree(sparsePolyToExpTree(&p),&q) && sameTerms(&p,&q));
+  }
+  for (n = 0; n < TREES; n++) {
+    resetExpTrees();
+    poolSize = 0;
+    for (k = 0; k < 3; k++) {
+      bindings[ids[k]] = (rand() % 2 ? 1 : -1) * (0.5 + 1.5*rand()/RAND_MAX);
+    }
+    tr = randomTree(1 + rand() % MAXDEPTH,1);
+    v = value(tr,&d,&scale);
+    simplifyErrors += !nearlyEqual(v,value(simplifyPolynomials(tr),&d,&w),scale + w);
+    simplifyErrors += !nearlyEqual(v,value(expandPolynomials(tr),&d,&w),scale + w);
+  }
+  resetExpTrees();
+  power = parse("(x + 1) * (x + 1) * (x + 1) * (x + 1) * (x + 1) * (x + 1)");
+  simplifyErrors += (simplifyPolynomials(power) != power);
+  simplifyErrors += !(sparsePolyFromExpTree(expandPolynomials(power),&p) && p.size == 7);
+  for (k = 0; k < 2; k++) {
+    resetExpTrees();
+    chainErrors += !(sparsePolyFromExpTree(monomialChain(CHAIN,k),&p) && p.size == CHAIN && wellFormed(&p));
+  }
+  freeSparsePoly(&p);
+  freeSparsePoly(&q);
+  freeSparsePoly(&dp);
+  resetExpTrees();
+  resetTokens();
+  printf("%d random polynomials: %d not converted, %d values differ, %d derivatives differ, "
+         "%d round trips differ\n",TREES,convertErrors,valueErrors,derivativeErrors,roundTripErrors);
+  printf("%d random trees: %d simplifications differ; %d chains differ\n",TREES,simplifyErrors,chainErrors);
+  return (convertErrors > 0 || valueErrors > 0 || derivativeErrors > 0 || roundTripErrors > 0
+          || simplifyErrors > 0 || chainErrors > 0);
+}